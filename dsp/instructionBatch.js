@@ -0,0 +1,210 @@
+// Packs an Elementary instruction batch into the binary form decoded natively
+// by mh::instructions::unpack, see native/InstructionBatch.h for the layout.
+// Compared with JSON.stringify this skips number formatting and parsing, and
+// node types and property keys are sent once per batch then referenced.
+
+const MAGIC = 0xEB;
+const VERSION = 1;
+
+const Tag = {
+  undefined: 0,
+  false: 1,
+  true: 2,
+  int32: 3,
+  uint32: 4,
+  float64: 5,
+  string: 6,
+  stringRef: 7,
+  array: 8,
+  float32Array: 9,
+  object: 10,
+};
+
+const MAX_DEPTH = 64;
+
+class Writer {
+  constructor() {
+    this.bytes = new Uint8Array(4096);
+    this.view = new DataView(this.bytes.buffer);
+    this.length = 0;
+    this.strings = new Map();
+  }
+
+  reserve(n) {
+    if (this.length + n <= this.bytes.length)
+      return;
+
+    let size = this.bytes.length * 2;
+    while (size < this.length + n)
+      size *= 2;
+
+    const next = new Uint8Array(size);
+    next.set(this.bytes.subarray(0, this.length));
+    this.bytes = next;
+    this.view = new DataView(next.buffer);
+  }
+
+  u8(v) {
+    this.reserve(1);
+    this.bytes[this.length++] = v;
+  }
+
+  varuint(v) {
+    while (v >= 0x80) {
+      this.u8((v % 0x80) | 0x80);
+      v = Math.floor(v / 0x80);
+    }
+    this.u8(v);
+  }
+
+  int32(v) {
+    this.reserve(4);
+    this.view.setInt32(this.length, v, true);
+    this.length += 4;
+  }
+
+  uint32(v) {
+    this.reserve(4);
+    this.view.setUint32(this.length, v, true);
+    this.length += 4;
+  }
+
+  float32(v) {
+    this.reserve(4);
+    this.view.setFloat32(this.length, v, true);
+    this.length += 4;
+  }
+
+  float64(v) {
+    this.reserve(8);
+    this.view.setFloat64(this.length, v, true);
+    this.length += 8;
+  }
+
+  string(s) {
+    const index = this.strings.get(s);
+
+    if (index !== undefined) {
+      this.u8(Tag.stringRef);
+      this.varuint(index);
+      return;
+    }
+
+    this.strings.set(s, this.strings.size);
+    this.u8(Tag.string);
+
+    // UTF-8, by hand since the embedded engine has no TextEncoder
+    this.varuint(utf8Length(s));
+    this.reserve(s.length * 3);
+
+    // codePointAt joins surrogate pairs and leaves lone surrogates as they are,
+    // the same as utf8Length counts them
+    for (let i = 0; i < s.length; ++i) {
+      const c = s.codePointAt(i);
+      if (c >= 0x10000) ++i;
+
+      if (c < 0x80) {
+        this.bytes[this.length++] = c;
+      } else if (c < 0x800) {
+        this.bytes[this.length++] = 0xC0 | (c >> 6);
+        this.bytes[this.length++] = 0x80 | (c & 0x3F);
+      } else if (c < 0x10000) {
+        this.bytes[this.length++] = 0xE0 | (c >> 12);
+        this.bytes[this.length++] = 0x80 | ((c >> 6) & 0x3F);
+        this.bytes[this.length++] = 0x80 | (c & 0x3F);
+      } else {
+        this.bytes[this.length++] = 0xF0 | (c >> 18);
+        this.bytes[this.length++] = 0x80 | ((c >> 12) & 0x3F);
+        this.bytes[this.length++] = 0x80 | ((c >> 6) & 0x3F);
+        this.bytes[this.length++] = 0x80 | (c & 0x3F);
+      }
+    }
+  }
+
+  number(v) {
+    if (Number.isInteger(v) && v >= -0x80000000 && v < 0x80000000) {
+      this.u8(Tag.int32);
+      this.int32(v);
+    } else if (Number.isInteger(v) && v >= 0 && v < 0x100000000) {
+      this.u8(Tag.uint32);
+      this.uint32(v);
+    } else {
+      this.u8(Tag.float64);
+      this.float64(v);
+    }
+  }
+
+  value(v, depth) {
+    if (depth > MAX_DEPTH)
+      throw new Error('Instruction batch values nested too deeply');
+
+    if (v === undefined || v === null || typeof v === 'function') {
+      this.u8(Tag.undefined);
+    } else if (typeof v === 'boolean') {
+      this.u8(v ? Tag.true : Tag.false);
+    } else if (typeof v === 'number') {
+      this.number(v);
+    } else if (typeof v === 'string') {
+      this.string(v);
+    } else if (v instanceof Float32Array) {
+      this.u8(Tag.float32Array);
+      this.varuint(v.length);
+      for (let i = 0; i < v.length; ++i)
+        this.float32(v[i]);
+    } else if (Array.isArray(v) || ArrayBuffer.isView(v)) {
+      this.u8(Tag.array);
+      this.varuint(v.length);
+      for (let i = 0; i < v.length; ++i)
+        this.value(v[i], depth + 1);
+    } else {
+      // Like JSON, members that are undefined or functions are left out
+      const keys = Object.keys(v).filter((k) => v[k] !== undefined && typeof v[k] !== 'function');
+      this.u8(Tag.object);
+      this.varuint(keys.length);
+      for (const k of keys) {
+        this.string(k);
+        this.value(v[k], depth + 1);
+      }
+    }
+  }
+
+  // Each byte as the code point one above it, see InstructionBatch.h
+  toMessage() {
+    const codes = new Uint16Array(this.length);
+    for (let i = 0; i < this.length; ++i)
+      codes[i] = this.bytes[i] + 1;
+
+    let message = '';
+    for (let i = 0; i < codes.length; i += 8192)
+      message += String.fromCharCode.apply(null, codes.subarray(i, i + 8192));
+    return message;
+  }
+}
+
+function utf8Length(s) {
+  let n = 0;
+  for (let i = 0; i < s.length; ++i) {
+    const c = s.codePointAt(i);
+    if (c < 0x80) n += 1;
+    else if (c < 0x800) n += 2;
+    else if (c < 0x10000) n += 3;
+    else { n += 4; ++i; }
+  }
+  return n;
+}
+
+export default function packInstructionBatch(batch) {
+  const w = new Writer();
+  w.u8(MAGIC);
+  w.u8(VERSION);
+  w.varuint(batch.length);
+
+  for (const [opcode, ...args] of batch) {
+    w.u8(opcode);
+    w.varuint(args.length);
+    for (const arg of args)
+      w.value(arg, 0);
+  }
+
+  return w.toMessage();
+}
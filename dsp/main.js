@@ -1,13 +1,17 @@
 import {Renderer, el} from '@elemaudio/core';
 import {RefMap} from './RefMap';
 import synth from "./synth.js";
+import packInstructionBatch from "./instructionBatch.js";
 
 
 // First, we initialize a custom Renderer instance that marshals our instruction
 // batches through the __postNativeMessage__ function to direct the underlying native
-// engine.
+// engine. Batches are packed into a compact binary form (see ./instructionBatch.js);
+// set globalThis.__jsonInstructionBatches__ = true to send readable JSON instead.
 let core = new Renderer((batch) => {
-    __postNativeMessage__(JSON.stringify(batch));
+    __postNativeMessage__(globalThis.__jsonInstructionBatches__ === true
+        ? JSON.stringify(batch)
+        : packInstructionBatch(batch));
 });
 
 // Next, a RefMap for coordinating our refs
@@ -38,6 +42,8 @@ globalThis.__receiveStateChange__ = (serializedState) => {
 
         console.log(stats);
     } else {
+        // Parameters read through `param()` (see ./param.js) are already applied
+        // natively; only refs derived from other state need updating here.
         console.log('Updating refs');
         // refs update for synth voice will go here
     }
@@ -57,8 +63,8 @@ globalThis.__receiveStateChange__ = (serializedState) => {
 // TODO:
 // Define another global function to perform the parsing in one place
 //
-globalThis.__receiveMIDI__ = (data) => {
-    console.log('QUICKJS::rcv raw MIDI message', JSON.parse(data));
+globalThis.__receiveChord__ = (data) => {
+    console.log('QUICKJS::rcv chord', JSON.parse(data));
 }
 
 // MindfulHarmony ////////////////////////////////////////////////
@@ -67,6 +73,18 @@ globalThis.__receiveTableContent__ = (data) =>
     console.log('QUICKJS::rcv table content:', JSON.parse(data));
 }
 
+// MindfulHarmony ////////////////////////////////////////////////
+globalThis.__receiveLibraryContent__ = (data) =>
+{
+    console.log('QUICKJS::rcv library content:', JSON.parse(data));
+}
+
+globalThis.__receiveFileProgress__ = (data) =>
+{
+    const progress = JSON.parse(data);
+    if (progress.done) console.log('QUICKJS::MIDI file', progress.operation, progress.ok ? 'ok' : progress.error);
+}
+
 
 //---------------------------------------------------------------------
 ////SRVB specific detail///////////////////////////////////////////////
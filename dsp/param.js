@@ -0,0 +1,17 @@
+import invariant from 'invariant';
+import {createNode} from '@elemaudio/core';
+
+
+// A signal carrying the current value of a host parameter. The native side
+// writes automation straight into the runtime every block, with optional
+// one-pole smoothing, so value changes never round-trip through JS. Only
+// changing the paramId or smoothing time needs a re-render.
+export default function param(paramId, smoothMs = 20) {
+  invariant(typeof paramId === 'string', 'Expected a paramId string');
+
+  return createNode('mh::param', {
+    key: `param:${paramId}`,
+    paramId,
+    smoothMs,
+  }, []);
+}
@@ -0,0 +1,393 @@
+#include "ChordDetector.h"
+
+#include <bit>
+#include <iterator>
+
+namespace mh
+{
+    namespace
+    {
+        using Quality = ChordDetector::Quality;
+
+        struct QualityInfo
+        {
+            const char* suffix;
+            uint8_t numTones;
+            uint8_t intervals[4]; // chord tones above the root, in inversion order
+        };
+
+        constexpr QualityInfo qualityInfo[] = {
+            {"", 0, {}},               // none
+            {"", 3, {0, 4, 7}},        // major
+            {"m", 3, {0, 3, 7}},       // minor
+            {"dim", 3, {0, 3, 6}},     // diminished
+            {"aug", 3, {0, 4, 8}},     // augmented
+            {"sus2", 3, {0, 2, 7}},    // sus2
+            {"sus4", 3, {0, 5, 7}},    // sus4
+            {"5", 2, {0, 7}},          // power
+            {"6", 4, {0, 4, 7, 9}},    // major6
+            {"m6", 4, {0, 3, 7, 9}},   // minor6
+            {"7", 4, {0, 4, 7, 10}},   // dominant7
+            {"maj7", 4, {0, 4, 7, 11}},// major7
+            {"m7", 4, {0, 3, 7, 10}},  // minor7
+            {"m7b5", 4, {0, 3, 6, 10}},// halfDiminished7
+            {"dim7", 4, {0, 3, 6, 9}}, // diminished7
+            {"mMaj7", 4, {0, 3, 7, 11}}// minorMajor7
+        };
+        static_assert(std::size(qualityInfo) == static_cast<size_t>(Quality::numQualities));
+
+        constexpr const char* pitchClassNames[] = {"C", "C#", "D", "Eb", "E", "F", "F#", "G", "Ab", "A", "Bb", "B"};
+
+        // Extensions beyond this many tones are too far from any template to name
+        constexpr int maxExtraTones = 2;
+
+        // Every best-scoring reading of a pitch class set. Sets like C6 / Am7 or the
+        // symmetric dim7 have several, and the bass picks between them at lookup.
+        struct TableEntry
+        {
+            uint8_t numCandidates = 0;
+            uint8_t root[4] {};
+            Quality quality[4] {};
+        };
+
+        uint16_t templateMask(const QualityInfo& info, int root) noexcept
+        {
+            uint16_t mask = 0;
+            for (int i = 0; i < info.numTones; ++i)
+                mask |= static_cast<uint16_t>(1u << ((root + info.intervals[i]) % 12));
+            return mask;
+        }
+
+        const std::array<TableEntry, 4096>& chordTable()
+        {
+            static const auto table = []
+            {
+                std::array<TableEntry, 4096> t {};
+
+                for (int set = 1; set < 4096; ++set)
+                {
+                    auto& entry = t[static_cast<size_t>(set)];
+                    int bestScore = 0;
+
+                    for (int root = 0; root < 12; ++root)
+                    {
+                        if ((set & (1 << root)) == 0)
+                            continue;
+
+                        for (auto q = 1; q < static_cast<int>(Quality::numQualities); ++q)
+                        {
+                            const auto& info = qualityInfo[q];
+                            const auto mask = templateMask(info, root);
+
+                            if ((set & mask) != mask)
+                                continue;
+
+                            const auto extras = std::popcount(static_cast<unsigned>(set & ~mask));
+                            if (extras > maxExtraTones)
+                                continue;
+
+                            // Whole templates count for more than the extensions cost,
+                            // so C E G D reads as C with an added tone, not as nothing
+                            const auto score = 10 * info.numTones - 6 * extras;
+
+                            if (score > bestScore)
+                            {
+                                bestScore = score;
+                                entry.numCandidates = 0;
+                            }
+
+                            if (score == bestScore && entry.numCandidates < 4)
+                            {
+                                entry.root[entry.numCandidates] = static_cast<uint8_t>(root);
+                                entry.quality[entry.numCandidates] = static_cast<Quality>(q);
+                                ++entry.numCandidates;
+                            }
+                        }
+                    }
+                }
+
+                return t;
+            }();
+
+            return table;
+        }
+    } // namespace
+
+    //==============================================================================
+    bool ChordDetector::Chord::sameHarmonyAs(const Chord& other) const noexcept
+    {
+        if (quality != other.quality)
+            return false;
+
+        if (!isChord())
+            return true;
+
+        return root == other.root && bass % 12 == other.bass % 12;
+    }
+
+    std::string ChordDetector::Chord::getName() const
+    {
+        if (!isChord())
+            return {};
+
+        std::string name = pitchClassNames[root % 12];
+        name += getQualitySuffix(quality);
+
+        if (bass % 12 != root)
+        {
+            name += "/";
+            name += pitchClassNames[bass % 12];
+        }
+
+        return name;
+    }
+
+    std::vector<uint8_t> ChordDetector::Chord::getNotes() const
+    {
+        std::vector<uint8_t> result;
+
+        for (size_t word = 0; word < notes.size(); ++word)
+            for (auto bits = notes[word]; bits != 0; bits &= bits - 1)
+                result.push_back(static_cast<uint8_t>(word * 64 + std::countr_zero(bits)));
+
+        return result;
+    }
+
+    //==============================================================================
+    ChordDetector::ChordDetector()
+    {
+        // Build the table here rather than on the first note in the audio thread
+        chordTable();
+    }
+
+    void ChordDetector::prepare(const double sampleRate, const double settleMs, const double releaseMs)
+    {
+        settleSamples = static_cast<int64_t>(sampleRate * settleMs * 0.001);
+        releaseSamples = static_cast<int64_t>(sampleRate * releaseMs * 0.001);
+    }
+
+    void ChordDetector::reset()
+    {
+        noteCounts.fill(0);
+        held = {};
+        sustained = {};
+        sustainPedals = 0;
+        published = {};
+        pending = {};
+        hasPending = false;
+    }
+
+    const char* ChordDetector::getQualitySuffix(const Quality quality) noexcept
+    {
+        return quality < Quality::numQualities ? qualityInfo[static_cast<size_t>(quality)].suffix : "";
+    }
+
+    bool ChordDetector::parseSymbol(std::string_view symbol, uint16_t& pitchClasses, int& bass) noexcept
+    {
+        const auto readNote = [](std::string_view& s) -> int
+        {
+            constexpr int naturals[] = {9, 11, 0, 2, 4, 5, 7}; // A to G
+
+            if (s.empty() || s[0] < 'A' || s[0] > 'G')
+                return -1;
+
+            auto pc = naturals[s[0] - 'A'];
+            s.remove_prefix(1);
+
+            for (; !s.empty() && (s[0] == '#' || s[0] == 'b'); s.remove_prefix(1))
+                pc += s[0] == '#' ? 1 : -1;
+
+            return (pc + 12) % 12;
+        };
+
+        const auto root = readNote(symbol);
+
+        if (root < 0)
+            return false;
+
+        bass = -1;
+        if (const auto slash = symbol.find('/'); slash != std::string_view::npos)
+        {
+            auto bassName = symbol.substr(slash + 1);
+            bass = readNote(bassName);
+            symbol = symbol.substr(0, slash);
+
+            if (bass < 0 || !bassName.empty())
+                return false;
+        }
+
+        for (auto q = 1; q < static_cast<int>(Quality::numQualities); ++q)
+        {
+            if (symbol == qualityInfo[q].suffix)
+            {
+                pitchClasses = templateMask(qualityInfo[q], root);
+
+                if (bass >= 0)
+                    pitchClasses |= static_cast<uint16_t>(1u << bass);
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    ChordDetector::Chord ChordDetector::identify(const std::array<uint64_t, 2>& notes) noexcept
+    {
+        Chord chord;
+        chord.notes = notes;
+
+        for (size_t word = 0; word < notes.size(); ++word)
+        {
+            for (auto bits = notes[word]; bits != 0; bits &= bits - 1)
+            {
+                const auto note = static_cast<int>(word * 64) + std::countr_zero(bits);
+
+                if (chord.pitchClasses == 0)
+                    chord.bass = static_cast<uint8_t>(note);
+
+                chord.pitchClasses |= static_cast<uint16_t>(1u << (note % 12));
+            }
+        }
+
+        const auto& entry = chordTable()[chord.pitchClasses];
+
+        if (entry.numCandidates == 0)
+            return chord;
+
+        // Prefer the reading rooted on the bass, which settles C6 vs Am7 and dim7
+        size_t pick = 0;
+        for (size_t i = 0; i < entry.numCandidates; ++i)
+        {
+            if (entry.root[i] == chord.bass % 12)
+            {
+                pick = i;
+                break;
+            }
+        }
+
+        chord.root = entry.root[pick];
+        chord.quality = entry.quality[pick];
+
+        const auto& info = qualityInfo[static_cast<size_t>(chord.quality)];
+        const auto bassInterval = (chord.bass % 12 - chord.root + 12) % 12;
+        chord.inversion = otherBass;
+
+        for (uint8_t i = 0; i < info.numTones; ++i)
+        {
+            if (info.intervals[i] == bassInterval)
+            {
+                chord.inversion = i;
+                break;
+            }
+        }
+
+        return chord;
+    }
+
+    //==============================================================================
+    std::array<uint64_t, 2> ChordDetector::sounding() const noexcept
+    {
+        return {held[0] | sustained[0], held[1] | sustained[1]};
+    }
+
+    bool ChordDetector::applyMessage(const choc::midi::ShortMessage& message) noexcept
+    {
+        const auto status = message.data[0];
+        const auto type = status & 0xF0;
+        const auto channel = status & 0x0F;
+        const auto note = message.data[1] & 0x7F;
+        const auto word = static_cast<size_t>(note >> 6);
+        const auto bit = uint64_t(1) << (note & 63);
+
+        if (type == 0x90 && message.data[2] > 0)
+        {
+            ++noteCounts[note];
+            held[word] |= bit;
+            sustained[word] &= ~bit;
+            return true;
+        }
+
+        if (type == 0x80 || type == 0x90)
+        {
+            if (noteCounts[note] == 0)
+                return false;
+
+            if (--noteCounts[note] == 0)
+            {
+                held[word] &= ~bit;
+
+                if (sustainPedals != 0)
+                    sustained[word] |= bit;
+            }
+
+            return true;
+        }
+
+        if (type == 0xB0)
+        {
+            const auto controller = message.data[1];
+
+            if (controller == 64)
+            {
+                if (message.data[2] >= 64)
+                {
+                    sustainPedals |= static_cast<uint16_t>(1u << channel);
+                    return false;
+                }
+
+                sustainPedals &= static_cast<uint16_t>(~(1u << channel));
+
+                if (sustainPedals == 0 && (sustained[0] | sustained[1]) != 0)
+                {
+                    sustained = {};
+                    return true;
+                }
+
+                return false;
+            }
+
+            // All sound off / all notes off
+            if (controller == 120 || controller == 123)
+            {
+                noteCounts.fill(0);
+                held = {};
+                sustained = {};
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void ChordDetector::update(const int64_t now) noexcept
+    {
+        const auto notes = sounding();
+        auto candidate = identify(notes);
+
+        // Lifting part of the current chord is not a new chord, as long as nothing
+        // has been played that wasn't already sounding when it was published
+        const auto onlyReleased = (notes[0] & ~published.notes[0]) == 0 && (notes[1] & ~published.notes[1]) == 0;
+
+        if (published.isChord() && candidate.pitchClasses != 0 && onlyReleased)
+        {
+            hasPending = false;
+            return;
+        }
+
+        if (candidate.sameHarmonyAs(published))
+        {
+            hasPending = false;
+            return;
+        }
+
+        // A different candidate restarts the settle time
+        if (!hasPending || !candidate.sameHarmonyAs(pending))
+        {
+            pendingSince = now;
+            hasPending = true;
+        }
+
+        pending = candidate;
+    }
+} // namespace mh
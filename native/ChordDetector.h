@@ -0,0 +1,143 @@
+#ifndef CHORDDETECTOR_H
+#define CHORDDETECTOR_H
+
+#include <choc_MIDI.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mh
+{
+    //==============================================================================
+    // Real-time chord recognition for incoming MIDI. Held notes live in a 128 bit
+    // set and every note event is a lookup into a table over all 4096 pitch class
+    // sets, so the audio thread never allocates or searches.
+    //
+    // Only changes of harmony are reported, with two kinds of hysteresis for sloppy
+    // playing: a new chord has to be stable for `settleMs` before it is published,
+    // so spread onsets and passing notes don't fire events, and lifting some notes
+    // of the current chord keeps it until everything has been released for
+    // `releaseMs`.
+    class ChordDetector
+    {
+    public:
+        enum class Quality : uint8_t
+        {
+            none = 0,
+            major,
+            minor,
+            diminished,
+            augmented,
+            sus2,
+            sus4,
+            power,
+            major6,
+            minor6,
+            dominant7,
+            major7,
+            minor7,
+            halfDiminished7,
+            diminished7,
+            minorMajor7,
+            numQualities
+        };
+
+        static constexpr uint8_t noRoot = 0xFF;
+        static constexpr uint8_t otherBass = 0xFF; // inversion when the bass is not a chord tone
+
+        struct Chord
+        {
+            uint8_t root = noRoot;
+            Quality quality = Quality::none;
+            uint8_t inversion = 0;  // 0 root position, 1 first inversion, ...
+            uint8_t bass = 0;       // lowest sounding MIDI note
+            uint16_t pitchClasses = 0;
+            std::array<uint64_t, 2> notes {};
+            int64_t samplePosition = 0;
+
+            bool isChord() const noexcept { return quality != Quality::none; }
+            bool sameHarmonyAs(const Chord& other) const noexcept;
+
+            // Message thread helpers
+            std::string getName() const;
+            std::vector<uint8_t> getNotes() const;
+        };
+
+        ChordDetector();
+
+        void prepare(double sampleRate, double settleMs = 30.0, double releaseMs = 150.0);
+        void reset();
+
+        // Audio thread. `offset` is the event's sample offset inside the current block,
+        // and `emit(const Chord&)` is called for each published change.
+        template <typename EmitFn>
+        void handle(const choc::midi::ShortMessage& message, int offset, EmitFn&& emit)
+        {
+            if (!applyMessage(message))
+                return;
+
+            update(clock + offset);
+            publishIfSettled(clock + offset, emit);
+        }
+
+        // Audio thread, once per block after all events have been handled
+        template <typename EmitFn>
+        void endBlock(int numSamples, EmitFn&& emit)
+        {
+            clock += numSamples;
+            publishIfSettled(clock, emit);
+        }
+
+        // The chord for a set of sounding notes, without any hysteresis
+        static Chord identify(const std::array<uint64_t, 2>& notes) noexcept;
+
+        static const char* getQualitySuffix(Quality quality) noexcept;
+
+        // Reads a chord symbol such as "Am7", "F#m7b5" or "C/E", spelled with the
+        // suffixes getName uses. Sets `bass` to the slash note's pitch class, or
+        // -1 without one. Returns false if the symbol isn't understood.
+        static bool parseSymbol(std::string_view symbol, uint16_t& pitchClasses, int& bass) noexcept;
+
+    private:
+        bool applyMessage(const choc::midi::ShortMessage& message) noexcept;
+        void update(int64_t now) noexcept;
+
+        template <typename EmitFn>
+        void publishIfSettled(int64_t now, EmitFn& emit)
+        {
+            if (!hasPending)
+                return;
+
+            const auto wait = pending.isChord() ? settleSamples : releaseSamples;
+
+            if (now - pendingSince < wait)
+                return;
+
+            published = pending;
+            published.samplePosition = now;
+            hasPending = false;
+            emit(published);
+        }
+
+        std::array<uint64_t, 2> sounding() const noexcept;
+
+        std::array<uint8_t, 128> noteCounts {};
+        std::array<uint64_t, 2> held {};
+        std::array<uint64_t, 2> sustained {};
+        uint16_t sustainPedals = 0; // one bit per channel
+
+        Chord published;
+        Chord pending;
+        bool hasPending = false;
+        int64_t pendingSince = 0;
+
+        int64_t clock = 0;
+        int64_t settleSamples = 1323;
+        int64_t releaseSamples = 6615;
+    };
+} // namespace mh
+
+#endif //CHORDDETECTOR_H
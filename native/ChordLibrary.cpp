@@ -0,0 +1,382 @@
+#include "ChordLibrary.h"
+
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+
+namespace mh
+{
+    namespace chordlib
+    {
+        PackedChord pack(const std::vector<uint8_t>& midiNotes)
+        {
+            PackedChord chord;
+
+            if (midiNotes.empty())
+                return chord;
+
+            chord.bass = *std::min_element(midiNotes.begin(), midiNotes.end());
+            chord.numNotes = static_cast<uint8_t>(std::min<size_t>(midiNotes.size(), 255));
+
+            for (const auto note : midiNotes)
+                chord.pitchClasses |= static_cast<uint16_t>(1u << (note % 12));
+
+            return chord;
+        }
+
+        std::vector<uint8_t> unpack(const PackedChord& chord)
+        {
+            // Close voicing upwards from the bass, good enough to audition with
+            std::vector<uint8_t> notes;
+
+            for (int step = 0; step < 12; ++step)
+            {
+                const auto note = chord.bass + step;
+                if ((chord.pitchClasses & (1u << (note % 12))) != 0 && note < 128)
+                    notes.push_back(static_cast<uint8_t>(note));
+            }
+
+            return notes;
+        }
+
+        uint16_t transpose(const uint16_t pitchClasses, const int semitones) noexcept
+        {
+            const auto k = ((semitones % 12) + 12) % 12;
+            const uint32_t set = pitchClasses & 0x0FFFu;
+            return static_cast<uint16_t>(((set << k) | (set >> (12 - k))) & 0x0FFFu);
+        }
+
+        uint16_t normalise(const uint16_t pitchClasses) noexcept
+        {
+            auto lowest = pitchClasses;
+
+            for (int k = 1; k < 12; ++k)
+                lowest = std::min(lowest, transpose(pitchClasses, -k));
+
+            return lowest;
+        }
+
+        std::vector<int> canonicalShifts(const uint16_t pitchClasses)
+        {
+            const auto lowest = normalise(pitchClasses);
+            std::vector<int> shifts;
+
+            for (int k = 0; k < 12; ++k)
+                if (transpose(pitchClasses, -k) == lowest)
+                    shifts.push_back(k);
+
+            return shifts;
+        }
+    } // namespace chordlib
+
+    //==============================================================================
+    struct ChordLibrary::FileHeader
+    {
+        char magic[4] = {'M', 'H', 'C', 'L'};
+        uint32_t version = 1;
+        uint32_t numProgressions = 0;
+        uint32_t ngramLength = 2;
+        uint64_t numChords = 0;
+        uint64_t progressionsOffset = 0;
+        uint64_t chordsOffset = 0;
+        uint64_t pcsIndexOffset = 0;
+        uint64_t pcsIndexCount = 0;
+        uint64_t ngramIndexOffset = 0;
+        uint64_t ngramIndexCount = 0;
+    };
+
+    struct ChordLibrary::ProgressionEntry
+    {
+        uint32_t firstChord = 0;
+        uint32_t numChords = 0;
+    };
+
+    struct ChordLibrary::IndexEntry
+    {
+        uint64_t key = 0;
+        uint32_t progression = 0;
+        uint32_t position = 0;
+    };
+
+    static constexpr uint32_t libraryVersion = 1;
+
+    static uint64_t align8(const uint64_t offset) noexcept
+    {
+        return (offset + 7u) & ~uint64_t(7);
+    }
+
+    //==============================================================================
+    bool ChordLibrary::open(const juce::File& libraryFile)
+    {
+        close();
+
+        auto mapped = std::make_unique<juce::MemoryMappedFile>(libraryFile, juce::MemoryMappedFile::readOnly);
+        const auto* base = static_cast<const char*>(mapped->getData());
+        const auto size = static_cast<uint64_t>(mapped->getSize());
+
+        if (base == nullptr || size < sizeof(FileHeader))
+            return false;
+
+        const auto* h = reinterpret_cast<const FileHeader*>(base);
+
+        if (std::memcmp(h->magic, "MHCL", 4) != 0 || h->version != libraryVersion || h->ngramLength == 0)
+            return false;
+
+        // Every section must lie inside the mapping before we hand out pointers into it
+        const auto fits = [size](const uint64_t offset, const uint64_t count, const size_t itemSize)
+        {
+            return offset <= size && count <= (size - offset) / itemSize;
+        };
+
+        if (!fits(h->progressionsOffset, h->numProgressions, sizeof(ProgressionEntry))
+            || !fits(h->chordsOffset, h->numChords, sizeof(chordlib::PackedChord))
+            || !fits(h->pcsIndexOffset, h->pcsIndexCount, sizeof(IndexEntry))
+            || !fits(h->ngramIndexOffset, h->ngramIndexCount, sizeof(IndexEntry)))
+            return false;
+
+        mapping = std::move(mapped);
+        file = libraryFile;
+        header = h;
+        progressions = reinterpret_cast<const ProgressionEntry*>(base + h->progressionsOffset);
+        chords = reinterpret_cast<const chordlib::PackedChord*>(base + h->chordsOffset);
+        pcsIndex = reinterpret_cast<const IndexEntry*>(base + h->pcsIndexOffset);
+        ngramIndex = reinterpret_cast<const IndexEntry*>(base + h->ngramIndexOffset);
+        return true;
+    }
+
+    void ChordLibrary::close()
+    {
+        header = nullptr;
+        progressions = nullptr;
+        chords = nullptr;
+        pcsIndex = nullptr;
+        ngramIndex = nullptr;
+        mapping.reset();
+        file = juce::File();
+    }
+
+    uint32_t ChordLibrary::getNumProgressions() const noexcept
+    {
+        return header != nullptr ? header->numProgressions : 0;
+    }
+
+    const chordlib::PackedChord* ChordLibrary::chordsOf(const uint32_t progression, uint32_t& length) const noexcept
+    {
+        length = 0;
+
+        if (header == nullptr || progression >= header->numProgressions)
+            return nullptr;
+
+        const auto& entry = progressions[progression];
+
+        if (static_cast<uint64_t>(entry.firstChord) + entry.numChords > header->numChords)
+            return nullptr;
+
+        length = entry.numChords;
+        return chords + entry.firstChord;
+    }
+
+    std::vector<chordlib::PackedChord> ChordLibrary::getProgression(const uint32_t index) const
+    {
+        uint32_t length = 0;
+        const auto* first = chordsOf(index, length);
+        return first != nullptr ? std::vector<chordlib::PackedChord>(first, first + length)
+                                : std::vector<chordlib::PackedChord>();
+    }
+
+    uint64_t ChordLibrary::ngramKey(const chordlib::PackedChord* sequence, const size_t n, const int shift) noexcept
+    {
+        // FNV-1a over the chords moved into the first chord's canonical key
+        uint64_t hash = 14695981039346656037ull;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            const auto set = chordlib::transpose(sequence[i].pitchClasses, -shift);
+            hash = (hash ^ (set & 0xFFu)) * 1099511628211ull;
+            hash = (hash ^ (set >> 8)) * 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+    template <typename Fn>
+    void ChordLibrary::forEachPosting(const IndexEntry* index, const uint64_t count, const uint64_t key, Fn&& fn) const
+    {
+        const auto* end = index + count;
+        const auto* it = std::lower_bound(index, end, key, [](const IndexEntry& e, const uint64_t k)
+        {
+            return e.key < k;
+        });
+
+        for (; it != end && it->key == key; ++it)
+            fn(*it);
+    }
+
+    bool ChordLibrary::matchesAt(const std::vector<chordlib::PackedChord>& sequence, const uint32_t progression,
+                                 const uint32_t position, int& transposition) const noexcept
+    {
+        uint32_t length = 0;
+        const auto* candidate = chordsOf(progression, length);
+
+        if (candidate == nullptr || static_cast<uint64_t>(position) + sequence.size() > length)
+            return false;
+
+        candidate += position;
+
+        for (int t = 0; t < 12; ++t)
+        {
+            bool all = true;
+
+            for (size_t i = 0; i < sequence.size() && all; ++i)
+                all = chordlib::transpose(sequence[i].pitchClasses, t) == candidate[i].pitchClasses;
+
+            if (all)
+            {
+                transposition = t;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    ChordLibrary::Page ChordLibrary::find(const std::vector<chordlib::PackedChord>& sequence, const size_t offset,
+                                          const size_t limit) const
+    {
+        Page page;
+        page.offset = offset;
+
+        if (header == nullptr || sequence.empty())
+            return page;
+
+        // Candidate occurrences come from the n-gram index when the query is long
+        // enough, otherwise from the pitch class set index. Both are keyed in a
+        // transposition invariant way; candidates are then verified chord by chord.
+        std::vector<std::pair<uint32_t, uint32_t>> candidates;
+        const auto collect = [&candidates](const IndexEntry& e)
+        {
+            candidates.emplace_back(e.progression, e.position);
+        };
+
+        size_t numLookups = 1;
+
+        if (sequence.size() >= header->ngramLength)
+        {
+            const auto shifts = chordlib::canonicalShifts(sequence.front().pitchClasses);
+            numLookups = shifts.size();
+
+            for (const auto shift : shifts)
+                forEachPosting(ngramIndex, header->ngramIndexCount,
+                               ngramKey(sequence.data(), header->ngramLength, shift), collect);
+        }
+        else
+        {
+            forEachPosting(pcsIndex, header->pcsIndexCount,
+                           chordlib::normalise(sequence.front().pitchClasses), collect);
+        }
+
+        // A single posting list is already in (progression, position) order
+        if (numLookups > 1)
+        {
+            std::sort(candidates.begin(), candidates.end());
+            candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        }
+
+        for (const auto& [progression, position] : candidates)
+        {
+            int transposition = 0;
+
+            if (!matchesAt(sequence, progression, position, transposition))
+                continue;
+
+            if (page.totalMatches >= offset && page.matches.size() < limit)
+                page.matches.push_back({progression, position, transposition});
+
+            ++page.totalMatches;
+        }
+
+        return page;
+    }
+
+    //==============================================================================
+    bool ChordLibrary::write(const juce::File& destination,
+                             const std::vector<std::vector<chordlib::PackedChord>>& progressionList,
+                             const uint32_t ngramLength)
+    {
+        if (ngramLength == 0)
+            return false;
+
+        FileHeader h;
+        h.version = libraryVersion;
+        h.numProgressions = static_cast<uint32_t>(progressionList.size());
+        h.ngramLength = ngramLength;
+
+        std::vector<ProgressionEntry> entries;
+        std::vector<IndexEntry> pcs;
+        std::vector<IndexEntry> ngrams;
+        entries.reserve(progressionList.size());
+
+        uint64_t chordCount = 0;
+
+        for (uint32_t p = 0; p < progressionList.size(); ++p)
+        {
+            const auto& progression = progressionList[p];
+            entries.push_back({static_cast<uint32_t>(chordCount), static_cast<uint32_t>(progression.size())});
+
+            for (uint32_t i = 0; i < progression.size(); ++i)
+            {
+                pcs.push_back({chordlib::normalise(progression[i].pitchClasses), p, i});
+
+                if (i + ngramLength <= progression.size())
+                {
+                    const auto shift = chordlib::canonicalShifts(progression[i].pitchClasses).front();
+                    ngrams.push_back({ngramKey(progression.data() + i, ngramLength, shift), p, i});
+                }
+            }
+
+            chordCount += progression.size();
+        }
+
+        const auto byKey = [](const IndexEntry& a, const IndexEntry& b)
+        {
+            return std::tie(a.key, a.progression, a.position) < std::tie(b.key, b.progression, b.position);
+        };
+
+        std::sort(pcs.begin(), pcs.end(), byKey);
+        std::sort(ngrams.begin(), ngrams.end(), byKey);
+
+        h.numChords = chordCount;
+        h.progressionsOffset = align8(sizeof(FileHeader));
+        h.chordsOffset = align8(h.progressionsOffset + entries.size() * sizeof(ProgressionEntry));
+        h.pcsIndexOffset = align8(h.chordsOffset + chordCount * sizeof(chordlib::PackedChord));
+        h.pcsIndexCount = pcs.size();
+        h.ngramIndexOffset = align8(h.pcsIndexOffset + pcs.size() * sizeof(IndexEntry));
+        h.ngramIndexCount = ngrams.size();
+
+        destination.deleteFile();
+        juce::FileOutputStream out(destination);
+
+        if (!out.openedOk())
+            return false;
+
+        const auto padTo = [&out](const uint64_t offset)
+        {
+            while (static_cast<uint64_t>(out.getPosition()) < offset)
+                out.writeByte(0);
+        };
+
+        out.write(&h, sizeof(h));
+        padTo(h.progressionsOffset);
+        out.write(entries.data(), entries.size() * sizeof(ProgressionEntry));
+        padTo(h.chordsOffset);
+        for (const auto& progression : progressionList)
+            out.write(progression.data(), progression.size() * sizeof(chordlib::PackedChord));
+        padTo(h.pcsIndexOffset);
+        out.write(pcs.data(), pcs.size() * sizeof(IndexEntry));
+        padTo(h.ngramIndexOffset);
+        out.write(ngrams.data(), ngrams.size() * sizeof(IndexEntry));
+        out.flush();
+
+        return out.getStatus().wasOk();
+    }
+} // namespace mh
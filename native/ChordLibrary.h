@@ -0,0 +1,111 @@
+#ifndef CHORDLIBRARY_H
+#define CHORDLIBRARY_H
+
+#include <juce_core/juce_core.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace mh
+{
+    namespace chordlib
+    {
+        // A chord reduced to what the library searches on: its pitch class set
+        // (bit n set = pitch class n present) plus enough to re-voice it for audition.
+        struct PackedChord
+        {
+            uint16_t pitchClasses = 0;
+            uint8_t bass = 0;
+            uint8_t numNotes = 0;
+
+            bool operator==(const PackedChord&) const = default;
+        };
+        static_assert(sizeof(PackedChord) == 4);
+
+        PackedChord pack(const std::vector<uint8_t>& midiNotes);
+        std::vector<uint8_t> unpack(const PackedChord& chord);
+
+        uint16_t transpose(uint16_t pitchClasses, int semitones) noexcept;
+
+        // Smallest pitch class set among all twelve transpositions
+        uint16_t normalise(uint16_t pitchClasses) noexcept;
+
+        // Every shift k for which transpose(set, -k) gives the normalised form. Sets
+        // with rotational symmetry (augmented, diminished...) have more than one.
+        std::vector<int> canonicalShifts(uint16_t pitchClasses);
+    } // namespace chordlib
+
+    //==============================================================================
+    // A read-only library of chord progressions in a single memory-mapped file.
+    // Nothing is loaded into the heap: the OS pages in whatever the binary searches
+    // and match verification touch.
+    //
+    // Layout (little endian, 8 byte aligned sections):
+    //   FileHeader
+    //   ProgressionEntry[numProgressions]   first chord and length of each progression
+    //   PackedChord[numChords]              all progressions back to back
+    //   IndexEntry[pcsIndexCount]           normalised pitch class set -> occurrence
+    //   IndexEntry[ngramIndexCount]         hash of n normalised chords -> occurrence
+    // Both indexes are sorted by key, so a lookup is a binary search.
+    class ChordLibrary
+    {
+    public:
+        struct Match
+        {
+            uint32_t progression = 0;
+            uint32_t position = 0;
+            int transposition = 0; // semitones from the query up to the match
+        };
+
+        struct Page
+        {
+            std::vector<Match> matches;
+            size_t totalMatches = 0;
+            size_t offset = 0;
+        };
+
+        ChordLibrary() = default;
+
+        bool open(const juce::File& file);
+        void close();
+        bool isOpen() const noexcept { return header != nullptr; }
+        juce::File getFile() const { return file; }
+
+        uint32_t getNumProgressions() const noexcept;
+        std::vector<chordlib::PackedChord> getProgression(uint32_t index) const;
+
+        // Finds every occurrence of `sequence` in any key and returns the requested
+        // page of matches, ordered by progression then position.
+        Page find(const std::vector<chordlib::PackedChord>& sequence, size_t offset, size_t limit) const;
+
+        // Writes a library file. Building sorts the indexes in memory, so this is for
+        // offline tools and imports rather than the plugin's hot paths.
+        static bool write(const juce::File& destination,
+                          const std::vector<std::vector<chordlib::PackedChord>>& progressions,
+                          uint32_t ngramLength = 2);
+
+    private:
+        struct FileHeader;
+        struct ProgressionEntry;
+        struct IndexEntry;
+
+        const chordlib::PackedChord* chordsOf(uint32_t progression, uint32_t& length) const noexcept;
+        bool matchesAt(const std::vector<chordlib::PackedChord>& sequence, uint32_t progression,
+                       uint32_t position, int& transposition) const noexcept;
+        template <typename Fn>
+        void forEachPosting(const IndexEntry* index, uint64_t count, uint64_t key, Fn&& fn) const;
+
+        static uint64_t ngramKey(const chordlib::PackedChord* chords, size_t n, int shift) noexcept;
+
+        juce::File file;
+        std::unique_ptr<juce::MemoryMappedFile> mapping;
+        const FileHeader* header = nullptr;
+        const ProgressionEntry* progressions = nullptr;
+        const chordlib::PackedChord* chords = nullptr;
+        const IndexEntry* pcsIndex = nullptr;
+        const IndexEntry* ngramIndex = nullptr;
+    };
+} // namespace mh
+
+#endif //CHORDLIBRARY_H
@@ -0,0 +1,157 @@
+#include "DispatchScheduler.h"
+
+#include <algorithm>
+#include <initializer_list>
+
+namespace mh
+{
+    namespace
+    {
+        double nowMs() noexcept { return juce::Time::getMillisecondCounterHiRes(); }
+    }
+
+    DispatchScheduler::~DispatchScheduler()
+    {
+        cancelPendingUpdate();
+        stopTimer();
+    }
+
+    DispatchScheduler::Entry* DispatchScheduler::find(const Client& client) noexcept
+    {
+        const auto it = std::find_if(clients.begin(), clients.end(), [&client](const Entry& e)
+        {
+            return e.client == &client;
+        });
+
+        return it != clients.end() ? &*it : nullptr;
+    }
+
+    void DispatchScheduler::add(Client& client)
+    {
+        if (find(client) == nullptr)
+            clients.push_back({&client, false, 0});
+    }
+
+    void DispatchScheduler::remove(Client& client)
+    {
+        auto* entry = find(client);
+
+        if (entry == nullptr)
+            return;
+
+        // A tick walks the list by index, so it is only compacted once the tick is over
+        if (ticking)
+        {
+            entry->client = nullptr;
+            entry->pending = false;
+            return;
+        }
+
+        clients.erase(clients.begin() + (entry - clients.data()));
+        cursor = clients.empty() ? 0 : cursor % clients.size();
+    }
+
+    void DispatchScheduler::submit(Client& client)
+    {
+        auto* entry = find(client);
+
+        if (entry == nullptr || entry->pending)
+            return;
+
+        entry->pending = true;
+        entry->submittedMs = nowMs();
+
+        // A tick already waiting for the timer picks this up too
+        if (!isTimerRunning())
+            triggerAsyncUpdate();
+    }
+
+    void DispatchScheduler::handleAsyncUpdate()
+    {
+        tick();
+    }
+
+    void DispatchScheduler::timerCallback()
+    {
+        stopTimer();
+        tick();
+    }
+
+    void DispatchScheduler::tick()
+    {
+        if (clients.empty())
+            return;
+
+        const auto start = nowMs();
+        const auto count = clients.size();
+        const auto first = cursor % count;
+        auto next = first;
+        bool anyLeft = false;
+
+        ticking = true;
+        ++stats.ticks;
+
+        // Foreground instances in the first pass, the others in the second
+        for (const auto foreground : {true, false})
+        {
+            for (size_t n = 0; n < count; ++n)
+            {
+                const auto i = (first + n) % count;
+                auto& entry = clients[i];
+
+                if (entry.client == nullptr || !entry.pending || entry.client->isInForeground() != foreground)
+                    continue;
+
+                const auto now = nowMs();
+                const auto overdue = now - entry.submittedMs >= maxDeferralMs;
+
+                if (now - start >= tickBudgetMs && !overdue)
+                {
+                    ++stats.deferred;
+                    anyLeft = true;
+                    continue;
+                }
+
+                if (overdue && now - start >= tickBudgetMs)
+                    ++stats.overdue;
+
+                // Cleared first, so an update that submits again is run on a later tick
+                entry.pending = false;
+                entry.client->runScheduledUpdate();
+                ++stats.updates;
+                next = i + 1;
+            }
+        }
+
+        ticking = false;
+
+        // Whoever was removed during the tick goes now, the cursor staying on
+        // the client it pointed at
+        size_t kept = 0;
+        size_t newCursor = 0;
+
+        for (size_t i = 0; i < clients.size(); ++i)
+        {
+            if (i == next % count)
+                newCursor = kept;
+
+            if (clients[i].client != nullptr)
+                clients[kept++] = clients[i];
+        }
+
+        clients.resize(kept);
+        cursor = kept > 0 ? newCursor % kept : 0;
+
+        stats.lastTickMs = nowMs() - start;
+        stats.maxTickMs = std::max(stats.maxTickMs, stats.lastTickMs);
+
+        // Anything submitted during the tick, or left by it, waits for the timer
+        anyLeft = anyLeft || std::any_of(clients.begin(), clients.end(), [](const Entry& e) { return e.pending; });
+
+        if (anyLeft)
+        {
+            cancelPendingUpdate();
+            startTimer(tickIntervalMs);
+        }
+    }
+} // namespace mh
@@ -0,0 +1,92 @@
+#ifndef DISPATCHSCHEDULER_H
+#define DISPATCHSCHEDULER_H
+
+#include <juce_events/juce_events.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace mh
+{
+    //==============================================================================
+    // One per process, shared by every plugin instance through a
+    // juce::SharedResourcePointer. Instances submit their message thread updates
+    // here instead of running them as soon as their own AsyncUpdater fires, and
+    // the scheduler runs them in ticks:
+    //
+    //   - instances whose editor is showing go first, then the others
+    //   - within each group, round robin, starting after whoever ran last
+    //   - a tick stops starting updates once tickBudgetMs is spent, and the
+    //     rest wait tickIntervalMs for the next one, so the host's own UI gets
+    //     the message thread in between
+    //   - an update left waiting for maxDeferralMs runs on the next tick
+    //     whatever the budget, so background instances are deferred but never
+    //     starved
+    //
+    // A submission for an instance that is already waiting is merged into it,
+    // which is what an AsyncUpdater does too. An update is never split, so one
+    // slow instance can overrun a tick, but it then goes to the back.
+    //
+    // Message thread only.
+    class DispatchScheduler : private juce::AsyncUpdater,
+                              private juce::Timer
+    {
+    public:
+        class Client
+        {
+        public:
+            virtual ~Client() = default;
+
+            virtual void runScheduledUpdate() = 0;
+            virtual bool isInForeground() const = 0;
+        };
+
+        struct Stats
+        {
+            uint64_t ticks = 0;
+            uint64_t updates = 0;
+            uint64_t deferred = 0;     // updates left for a later tick
+            uint64_t overdue = 0;      // run past the budget after waiting too long
+            double lastTickMs = 0;
+            double maxTickMs = 0;
+        };
+
+        static constexpr double tickBudgetMs = 4.0;
+        static constexpr int tickIntervalMs = 4;
+        static constexpr double maxDeferralMs = 40.0;
+
+        DispatchScheduler() = default;
+        ~DispatchScheduler() override;
+
+        void add(Client& client);
+        void remove(Client& client);
+
+        // Runs the client's update on the next tick, or a later one when the
+        // message thread is busy
+        void submit(Client& client);
+
+        const Stats& getStats() const noexcept { return stats; }
+        size_t getNumClients() const noexcept { return clients.size(); }
+
+    private:
+        struct Entry
+        {
+            Client* client = nullptr; // null once removed during a tick
+            bool pending = false;
+            double submittedMs = 0;
+        };
+
+        void handleAsyncUpdate() override;
+        void timerCallback() override;
+        void tick();
+
+        Entry* find(const Client& client) noexcept;
+
+        std::vector<Entry> clients;
+        size_t cursor = 0;
+        bool ticking = false;
+        Stats stats;
+    };
+} // namespace mh
+
+#endif //DISPATCHSCHEDULER_H
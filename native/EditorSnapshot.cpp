@@ -0,0 +1,106 @@
+#include "EditorSnapshot.h"
+
+namespace mh
+{
+    std::string EditorSnapshot::escape(const std::string& json)
+    {
+        // serialize quotes and escapes a string; keep only the inside
+        const auto quoted = elem::js::serialize(elem::js::Value(json));
+        return quoted.size() >= 2 ? quoted.substr(1, quoted.size() - 2) : std::string();
+    }
+
+    void EditorSnapshot::setState(const elem::js::Object& state)
+    {
+        stateLiteral = elem::js::serialize(elem::js::serialize(state));
+    }
+
+    void EditorSnapshot::setTableContent(const elem::js::Object& tableContent)
+    {
+        auto json = elem::js::serialize(tableContent);
+
+        // Strip the braces so the members can follow the progression
+        if (json.size() >= 2 && json.front() == '{' && json.back() == '}')
+            json = json.substr(1, json.size() - 2);
+
+        tableContentRest = escape(json);
+        tableContentStale = true;
+        tableContentChanged = true;
+    }
+
+    const std::string& EditorSnapshot::getTableContentLiteral()
+    {
+        if (!tableContentStale)
+            return tableContentLiteral;
+
+        static const auto head = escape("{\"tableContent\":{\"chordProgression\":[");
+        static const auto comma = escape(",");
+        static const auto tail = escape("}}");
+
+        auto& literal = tableContentLiteral;
+        literal.clear();
+        literal.reserve(progressionJson.size() + tableContentRest.size() + head.size() + 16);
+
+        literal += '"';
+        literal += head;
+        literal += progressionJson;
+        literal += ']';
+
+        if (!tableContentRest.empty())
+        {
+            literal += comma;
+            literal += tableContentRest;
+        }
+
+        literal += tail;
+        literal += '"';
+
+        tableContentStale = false;
+        return literal;
+    }
+
+    void EditorSnapshot::addIncomingMidi(const std::string& hex)
+    {
+        recentMidi.push_back(elem::js::serialize(elem::js::Value(hex)));
+
+        while (recentMidi.size() > maxRecentMidi)
+            recentMidi.pop_front();
+    }
+
+    std::string EditorSnapshot::getRecentMidiLiteral() const
+    {
+        std::string json = "[";
+
+        for (size_t i = 0; i < recentMidi.size(); ++i)
+        {
+            if (i > 0)
+                json += ',';
+            json += recentMidi[i];
+        }
+
+        json += ']';
+        return elem::js::serialize(elem::js::Value(json));
+    }
+
+    bool EditorSnapshot::takeTableContentChanged() noexcept
+    {
+        const auto changed = tableContentChanged;
+        tableContentChanged = false;
+        return changed;
+    }
+
+    std::string EditorSnapshot::withPayload(const char* script, const std::string& literal, const char placeholder)
+    {
+        const std::string_view text(script);
+        const auto at = text.find(placeholder);
+
+        if (at == std::string_view::npos)
+            return std::string(text);
+
+        std::string expr;
+        expr.reserve(text.size() + literal.size());
+        expr.append(text.substr(0, at));
+        expr.append(literal);
+        expr.append(text.substr(at + 1));
+        return expr;
+    }
+} // namespace mh
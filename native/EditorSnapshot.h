@@ -0,0 +1,120 @@
+#ifndef EDITORSNAPSHOT_H
+#define EDITORSNAPSHOT_H
+
+#include <elem/Value.h>
+
+#include "PersistentVector.h"
+
+#include <algorithm>
+#include <any>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace mh
+{
+    //==============================================================================
+    // Everything an editor needs when it opens, kept as ready to send JS string
+    // literals and updated as changes happen, so hydrating a new editor is a copy
+    // rather than a serialisation of the whole session.
+    //
+    // The chord progression is the only part that grows with session length. Its
+    // JSON is kept in one string with the offset of every chord, and an edit only
+    // rewrites the chords from the first one that changed. Note numbers need no
+    // escaping, so that text goes into the JS literal as it is.
+    class EditorSnapshot
+    {
+    public:
+        static constexpr size_t maxRecentMidi = 32;
+
+        void setState(const elem::js::Object& state);
+
+        // Everything but the progression, which comes from setProgression
+        void setTableContent(const elem::js::Object& tableContent);
+
+        // Works with any element type that has a `noteNumbers` sequence
+        template <typename Chord>
+        void setProgression(const PersistentVector<Chord>& next)
+        {
+            const auto* previous = std::any_cast<PersistentVector<Chord>>(&progression);
+
+            if (previous != nullptr && next.sharesStructureWith(*previous))
+                return;
+
+            size_t firstChanged = 0;
+
+            if (previous != nullptr)
+            {
+                bool anyChanged = false;
+                firstChanged = std::min(previous->size(), next.size());
+
+                PersistentVector<Chord>::diff(*previous, next, [&](const size_t begin, size_t)
+                {
+                    if (!anyChanged)
+                        firstChanged = begin;
+                    anyChanged = true;
+                });
+            }
+
+            // Drop everything from the first changed chord, then write the new tail
+            if (firstChanged < chordOffsets.size())
+            {
+                progressionJson.resize(chordOffsets[firstChanged]);
+                chordOffsets.resize(firstChanged);
+            }
+
+            for (auto i = chordOffsets.size(); i < next.size(); ++i)
+            {
+                chordOffsets.push_back(progressionJson.size());
+
+                if (i > 0)
+                    progressionJson += ',';
+
+                progressionJson += '[';
+                for (size_t n = 0; n < next[i].noteNumbers.size(); ++n)
+                {
+                    if (n > 0)
+                        progressionJson += ',';
+                    progressionJson += std::to_string(static_cast<int>(next[i].noteNumbers[n]));
+                }
+                progressionJson += ']';
+            }
+
+            progression = next;
+            tableContentStale = true;
+            tableContentChanged = true;
+        }
+
+        void addIncomingMidi(const std::string& hex);
+
+        const std::string& getStateLiteral() const noexcept { return stateLiteral; }
+        const std::string& getTableContentLiteral();
+        std::string getRecentMidiLiteral() const;
+
+        // True once after each change of the table content or progression
+        bool takeTableContentChanged() noexcept;
+
+        // Replaces the first `placeholder` in a dispatch script with a literal,
+        // without going through juce::String for large payloads
+        static std::string withPayload(const char* script, const std::string& literal, char placeholder = '%');
+
+    private:
+        static std::string escape(const std::string& json);
+
+        std::string stateLiteral = "\"{}\"";
+
+        std::string tableContentRest;  // escaped members after the progression, without braces
+        std::string progressionJson;   // chords joined with commas, without brackets
+        std::vector<size_t> chordOffsets;
+        std::string tableContentLiteral;
+        bool tableContentStale = true;
+        bool tableContentChanged = false;
+
+        std::deque<std::string> recentMidi; // already quoted
+
+        // The progression the JSON was written from, whatever its element type
+        std::any progression;
+    };
+} // namespace mh
+
+#endif //EDITORSNAPSHOT_H
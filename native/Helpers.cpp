@@ -11,27 +11,76 @@ namespace mh
 {
     namespace util
     {
-        elem::js::Value wrapChordsToJsValue(const std::vector<MindfulMIDI::ChordNotes>& chordProgession)
+        namespace
+        {
+            juce::File assetsOverride;
+            juce::File userDataOverride;
+        }
+
+        elem::js::Value wrapChordsToJsValue(const MindfulMIDI::ChordProgression& chordProgession)
         {
             elem::js::Array chordProgressionJs;
+            chordProgressionJs.reserve(chordProgession.size());
 
-            // Convert std::vector<ChordNotes> to elem::js::Array
-            for (const auto& chord : chordProgession)
+            // Convert the persistent progression to elem::js::Array, one { notes, time }
+            // object per chord
+            chordProgession.forEach([&chordProgressionJs](const MindfulMIDI::ChordNotes& chord)
             {
-                elem::js::Array chordJs;
+                elem::js::Array notesJs;
                 for (const uint8_t note : chord.noteNumbers)
                 {
-                    chordJs.push_back(static_cast<elem::js::Number>(note));
+                    notesJs.push_back(static_cast<elem::js::Number>(note));
                 }
+
+                elem::js::Object chordJs;
+                chordJs.insert_or_assign("notes", notesJs);
+                chordJs.insert_or_assign("time", chord.time);
                 chordProgressionJs.push_back(chordJs);
-            }
+            });
             return elem::js::Value(chordProgressionJs);
         }
 
+        MindfulMIDI::ChordProgression unwrapChordsFromJsValue(const elem::js::Value& chordProgession)
+        {
+            MindfulMIDI::ChordProgression result;
+
+            if (!chordProgession.isArray())
+                return result;
+
+            for (const auto& chordJs : chordProgession.getArray())
+            {
+                // State saved before chords had a time holds bare arrays of notes,
+                // which come back at time 0
+                MindfulMIDI::ChordNotes chord;
+                elem::js::Value notesJs = chordJs;
+
+                if (chordJs.isObject())
+                {
+                    notesJs = chordJs.getWithDefault("notes", elem::js::Array());
+                    chord.time = chordJs.getWithDefault("time", static_cast<elem::js::Number>(0));
+                }
+
+                if (!notesJs.isArray())
+                    continue;
+
+                chord.noteNumbers.clear();
+                for (const auto& note : notesJs.getArray())
+                {
+                    if (note.isNumber())
+                        chord.noteNumbers.push_back(static_cast<uint8_t>(static_cast<elem::js::Number>(note)));
+                }
+                result = result.push_back(std::move(chord));
+            }
+            return result;
+        }
+
         //////////////////////////////////////////
         /////////////////////////////////////////
         juce::File getAssetsDirectory()
         {
+            if (assetsOverride != juce::File())
+                return assetsOverride;
+
 #if JUCE_MAC
             auto assetsDir = juce::File::getSpecialLocation(juce::File::SpecialLocationType::currentApplicationFile)
                 .getChildFile("Contents/Resources/dist");
@@ -48,5 +97,23 @@ namespace mh
 
             return assetsDir;
         }
+
+        //////////////////////////////////////////
+        /////////////////////////////////////////
+        // Per-user files the plugin reads and writes, like the chord library
+        juce::File getUserDataDirectory()
+        {
+            if (userDataOverride != juce::File())
+                return userDataOverride;
+
+            return juce::File::getSpecialLocation(juce::File::SpecialLocationType::userApplicationDataDirectory)
+                .getChildFile("MindfulHarmony");
+        }
+
+        void overrideDirectories(const juce::File& assets, const juce::File& userData)
+        {
+            assetsOverride = assets;
+            userDataOverride = userData;
+        }
     } // end util
 } // end mh
@@ -14,9 +14,14 @@ namespace mh
     namespace util
     {
         juce::File getAssetsDirectory();
+        juce::File getUserDataDirectory();
+        // For the replay harness, which runs outside the plugin bundle and must not
+        // touch the user's files. Call before any processor is made.
+        void overrideDirectories(const juce::File& assets, const juce::File& userData);
         bool isOdd(int num);
 
-        elem::js::Value wrapChordsToJsValue(const std::vector<MindfulMIDI::ChordNotes>& chordProgession);
+        elem::js::Value wrapChordsToJsValue(const MindfulMIDI::ChordProgression& chordProgession);
+        MindfulMIDI::ChordProgression unwrapChordsFromJsValue(const elem::js::Value& chordProgession);
 
     } // namespace util
 } // namespace mh
@@ -0,0 +1,257 @@
+#include "InstructionBatch.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace mh
+{
+    namespace instructions
+    {
+        namespace
+        {
+            constexpr int maxDepth = 64;
+
+            // Reads bytes back out of the code points they were sent as
+            class Reader
+            {
+            public:
+                explicit Reader(const std::string_view m) : message(m) {}
+
+                bool failed() const noexcept { return error != nullptr; }
+                const char* getError() const noexcept { return error; }
+                bool atEnd() const noexcept { return position >= message.size(); }
+
+                uint8_t byte() noexcept
+                {
+                    if (position >= message.size())
+                        return fail("Batch ends early");
+
+                    uint32_t codePoint = static_cast<uint8_t>(message[position++]);
+
+                    if (codePoint >= 0x80)
+                    {
+                        // Only two byte sequences are produced, for 0x80..0x100
+                        if ((codePoint & 0xE0) != 0xC0 || position >= message.size())
+                            return fail("Batch is not byte encoded");
+
+                        codePoint = ((codePoint & 0x1F) << 6) | (static_cast<uint8_t>(message[position++]) & 0x3F);
+                    }
+
+                    if (codePoint == 0 || codePoint > 0x100)
+                        return fail("Batch is not byte encoded");
+
+                    return static_cast<uint8_t>(codePoint - 1);
+                }
+
+                uint64_t varuint() noexcept
+                {
+                    uint64_t value = 0;
+
+                    for (int shift = 0; shift < 64; shift += 7)
+                    {
+                        const auto b = byte();
+                        value |= static_cast<uint64_t>(b & 0x7F) << shift;
+
+                        if ((b & 0x80) == 0 || failed())
+                            return value;
+                    }
+
+                    fail("Malformed length");
+                    return 0;
+                }
+
+                // Counts are bounded by what could possibly follow, so a corrupt
+                // one fails here rather than in a huge allocation
+                size_t count(const size_t minBytesEach) noexcept
+                {
+                    const auto n = varuint();
+
+                    if (n > (message.size() - std::min(position, message.size())) / std::max<size_t>(1, minBytesEach))
+                    {
+                        fail("Count runs past the end of the batch");
+                        return 0;
+                    }
+
+                    return static_cast<size_t>(n);
+                }
+
+                template <typename T>
+                T fixed() noexcept
+                {
+                    uint8_t bytes[sizeof(T)];
+                    for (auto& b : bytes)
+                        b = byte();
+
+                    T value;
+                    std::memcpy(&value, bytes, sizeof(T));
+                    return value;
+                }
+
+                std::string text(const size_t length)
+                {
+                    std::string s(length, '\0');
+                    for (auto& c : s)
+                        c = static_cast<char>(byte());
+                    return s;
+                }
+
+                uint8_t fail(const char* description) noexcept
+                {
+                    if (error == nullptr)
+                        error = description;
+                    position = message.size();
+                    return 0;
+                }
+
+            private:
+                std::string_view message;
+                size_t position = 0;
+                const char* error = nullptr;
+            };
+
+            struct Decoder
+            {
+                Reader& in;
+                std::vector<std::string> strings;
+
+                bool string(std::string& out, const Tag tag)
+                {
+                    if (tag == Tag::string)
+                    {
+                        out = in.text(in.count(1));
+                        strings.push_back(out);
+                        return !in.failed();
+                    }
+
+                    if (tag == Tag::stringRef)
+                    {
+                        const auto index = in.varuint();
+
+                        if (index >= strings.size())
+                        {
+                            in.fail("Unknown string reference");
+                            return false;
+                        }
+
+                        out = strings[static_cast<size_t>(index)];
+                        return !in.failed();
+                    }
+
+                    in.fail("Expected a string");
+                    return false;
+                }
+
+                elem::js::Value value(const int depth)
+                {
+                    if (depth > maxDepth)
+                    {
+                        in.fail("Values nested too deeply");
+                        return {};
+                    }
+
+                    const auto tag = static_cast<Tag>(in.byte());
+
+                    switch (tag)
+                    {
+                        case Tag::undefined: return {};
+                        case Tag::boolFalse: return elem::js::Value(false);
+                        case Tag::boolTrue: return elem::js::Value(true);
+                        case Tag::int32: return static_cast<elem::js::Number>(in.fixed<int32_t>());
+                        case Tag::uint32: return static_cast<elem::js::Number>(in.fixed<uint32_t>());
+                        case Tag::float64: return static_cast<elem::js::Number>(in.fixed<double>());
+
+                        case Tag::string:
+                        case Tag::stringRef:
+                        {
+                            std::string s;
+                            string(s, tag);
+                            return elem::js::Value(s);
+                        }
+
+                        case Tag::array:
+                        {
+                            elem::js::Array array(in.count(1));
+                            for (auto& element : array)
+                                element = value(depth + 1);
+                            return array;
+                        }
+
+                        case Tag::float32Array:
+                        {
+                            elem::js::Float32Array array(in.count(4));
+                            for (auto& element : array)
+                                element = in.fixed<float>();
+                            return array;
+                        }
+
+                        case Tag::object:
+                        {
+                            elem::js::Object object;
+                            const auto n = in.count(2);
+
+                            for (size_t i = 0; i < n && !in.failed(); ++i)
+                            {
+                                std::string key;
+                                if (!string(key, static_cast<Tag>(in.byte())))
+                                    break;
+                                object.insert_or_assign(std::move(key), value(depth + 1));
+                            }
+                            return object;
+                        }
+                    }
+
+                    in.fail("Unknown value tag");
+                    return {};
+                }
+            };
+        }
+
+        bool isPacked(const std::string_view message) noexcept
+        {
+            Reader in(message);
+            return !message.empty() && in.byte() == magic && !in.failed();
+        }
+
+        bool unpack(const std::string_view message, elem::js::Array& batch, std::string& error)
+        {
+            Reader in(message);
+
+            if (in.byte() != magic || in.byte() != formatVersion)
+            {
+                error = "Not a packed instruction batch, or from a different version";
+                return false;
+            }
+
+            Decoder decoder{in, {}};
+            const auto numInstructions = in.count(2);
+            batch.reserve(batch.size() + numInstructions);
+
+            for (size_t i = 0; i < numInstructions && !in.failed(); ++i)
+            {
+                const auto opcode = in.byte();
+                const auto numArgs = in.count(1);
+
+                elem::js::Array instruction;
+                instruction.reserve(numArgs + 1);
+                instruction.push_back(static_cast<elem::js::Number>(opcode));
+
+                for (size_t a = 0; a < numArgs && !in.failed(); ++a)
+                    instruction.push_back(decoder.value(0));
+
+                batch.push_back(std::move(instruction));
+            }
+
+            if (!in.failed() && !in.atEnd())
+                in.fail("Trailing bytes after the last instruction");
+
+            if (in.failed())
+            {
+                error = in.getError();
+                return false;
+            }
+
+            return true;
+        }
+    } // namespace instructions
+} // namespace mh
@@ -0,0 +1,63 @@
+#ifndef INSTRUCTIONBATCH_H
+#define INSTRUCTIONBATCH_H
+
+#include <elem/Value.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace mh
+{
+    namespace instructions
+    {
+        //==============================================================================
+        // A compact binary form of the instruction batches Elementary's Renderer
+        // produces, packed in JS by dsp/instructionBatch.js and unpacked here straight
+        // into the elem::js::Array that Runtime::applyInstructions takes, with no JSON
+        // text in between. JSON batches are still accepted, as a debug fallback.
+        //
+        // Layout, little endian:
+        //   u8 magic (0xEB), u8 version
+        //   varuint instruction count, then per instruction
+        //     u8 opcode, varuint argument count, arguments as values
+        //   value: u8 tag, then
+        //     undefined, false, true   nothing
+        //     int32, uint32, float64   the number
+        //     string                   varuint byte length, UTF-8; joins the string table
+        //     stringRef                varuint index into the batch's string table
+        //     array                    varuint count, values
+        //     float32Array             varuint count, f32 each
+        //     object                   varuint count, then key (string or stringRef) and value pairs
+        //
+        // choc hands JS strings over as UTF-8, so the bytes travel as a string of
+        // code points one above each byte value (1..256). That keeps NULs out of the
+        // string and costs one extra byte only for values from 127 up.
+        enum class Tag : uint8_t
+        {
+            undefined = 0,
+            boolFalse,
+            boolTrue,
+            int32,
+            uint32,
+            float64,
+            string,
+            stringRef,
+            array,
+            float32Array,
+            object
+        };
+
+        inline constexpr uint8_t magic = 0xEB;
+        inline constexpr uint8_t formatVersion = 1;
+
+        // True if `message` starts like a packed batch rather than JSON
+        bool isPacked(std::string_view message) noexcept;
+
+        // Appends the decoded instructions to `batch`. Returns false, with a
+        // description in `error`, if the message is malformed.
+        bool unpack(std::string_view message, elem::js::Array& batch, std::string& error);
+    } // namespace instructions
+} // namespace mh
+
+#endif //INSTRUCTIONBATCH_H
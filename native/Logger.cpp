@@ -0,0 +1,356 @@
+#include "Logger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace mh
+{
+    namespace logging
+    {
+        const char* toString(const Level level)
+        {
+            switch (level)
+            {
+            case Level::trace: return "trace";
+            case Level::debug: return "debug";
+            case Level::info:  return "info";
+            case Level::warn:  return "warn";
+            case Level::error: return "error";
+            case Level::off:   break;
+            }
+            return "off";
+        }
+
+        const char* toString(const Category category)
+        {
+            switch (category)
+            {
+            case Category::general: return "general";
+            case Category::midi:    return "midi";
+            case Category::audio:   return "audio";
+            case Category::bridge:  return "bridge";
+            case Category::engine:  return "engine";
+            case Category::state:   return "state";
+            case Category::numCategories: break;
+            }
+            return "unknown";
+        }
+
+        bool fromString(const std::string_view name, Level& level)
+        {
+            for (auto l = Level::trace; l <= Level::off; l = static_cast<Level>(static_cast<uint8_t>(l) + 1))
+            {
+                if (name == toString(l))
+                {
+                    level = l;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool fromString(const std::string_view name, Category& category)
+        {
+            for (uint8_t i = 0; i < static_cast<uint8_t>(Category::numCategories); ++i)
+            {
+                if (name == toString(static_cast<Category>(i)))
+                {
+                    category = static_cast<Category>(i);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        static void appendNumber(std::string& out, const double value)
+        {
+            char buffer[32];
+
+            if (std::abs(value) < 1.0e15 && value == std::floor(value))
+                std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(value));
+            else
+                std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+
+            out += buffer;
+        }
+
+        std::string formatEntry(const Entry& entry)
+        {
+            char prefix[64];
+            std::snprintf(prefix, sizeof(prefix), "[%.3f] [%s] [%s] ",
+                          static_cast<double>(entry.timestampNs) / 1.0e9,
+                          toString(entry.level),
+                          toString(entry.category));
+
+            std::string line(prefix);
+
+            if (entry.textLength > 0)
+            {
+                line.append(entry.text, entry.textLength);
+                return line;
+            }
+
+            if (entry.format == nullptr)
+                return line;
+
+            size_t argIndex = 0;
+
+            for (const char* c = entry.format; *c != 0; ++c)
+            {
+                if (c[0] == '{' && c[1] == '}' && argIndex < entry.numArgs)
+                {
+                    appendNumber(line, entry.args[argIndex++]);
+                    ++c;
+                }
+                else
+                {
+                    line += *c;
+                }
+            }
+
+            return line;
+        }
+
+        //==============================================================================
+        Logger::Logger(const size_t capacity)
+            : startTime(std::chrono::steady_clock::now())
+        {
+            // The ring indexes with a mask, so round up to a power of two
+            size_t size = 2;
+            while (size < capacity)
+                size <<= 1;
+
+            slots = std::make_unique<Slot[]>(size);
+            mask = size - 1;
+
+            for (size_t i = 0; i < size; ++i)
+                slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        void Logger::setCategoryEnabled(const Category category, const bool enabled) noexcept
+        {
+            const auto bit = 1u << static_cast<uint32_t>(category);
+
+            if (enabled)
+                categoryMask.fetch_or(bit, std::memory_order_relaxed);
+            else
+                categoryMask.fetch_and(~bit, std::memory_order_relaxed);
+        }
+
+        void Logger::stamp(Entry& e, const Level l, const Category c) const noexcept
+        {
+            e.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - startTime).count();
+            e.level = l;
+            e.category = c;
+        }
+
+        bool Logger::writeText(const Level l, const Category c, const std::string_view text) noexcept
+        {
+            return push([&](Entry& e)
+            {
+                stamp(e, l, c);
+                e.format = nullptr;
+                e.numArgs = 0;
+                e.textLength = static_cast<uint8_t>(std::min(text.size(), Entry::maxTextLength));
+                std::memcpy(e.text, text.data(), e.textLength);
+                e.text[e.textLength] = 0;
+            });
+        }
+
+        size_t Logger::drain(Entry* dest, const size_t maxEntries) noexcept
+        {
+            size_t count = 0;
+
+            while (count < maxEntries)
+            {
+                auto& slot = slots[dequeuePos & mask];
+                const auto seq = slot.sequence.load(std::memory_order_acquire);
+
+                if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(dequeuePos + 1) < 0)
+                    break;
+
+                dest[count++] = slot.entry;
+                slot.sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+                ++dequeuePos;
+            }
+
+            return count;
+        }
+
+        //==============================================================================
+        RotatingFileSink::RotatingFileSink(juce::File dir, juce::String name, const int64_t maxSize, const int numFiles)
+            : directory(std::move(dir)), baseName(std::move(name)), maxBytes(maxSize), maxFiles(std::max(1, numFiles))
+        {
+            directory.createDirectory();
+        }
+
+        juce::File RotatingFileSink::fileForIndex(const int index) const
+        {
+            if (index == 0)
+                return directory.getChildFile(baseName + ".log");
+
+            return directory.getChildFile(baseName + "." + juce::String(index) + ".log");
+        }
+
+        void RotatingFileSink::rotate()
+        {
+            stream.reset();
+
+            fileForIndex(maxFiles).deleteFile();
+
+            for (int i = maxFiles - 1; i >= 0; --i)
+            {
+                if (const auto f = fileForIndex(i); f.existsAsFile())
+                    f.moveFileTo(fileForIndex(i + 1));
+            }
+        }
+
+        void RotatingFileSink::write(const std::vector<std::string>& lines)
+        {
+            if (stream == nullptr)
+            {
+                stream = std::make_unique<juce::FileOutputStream>(fileForIndex(0));
+
+                if (stream->failedToOpen())
+                {
+                    stream.reset();
+                    return;
+                }
+            }
+
+            for (const auto& line : lines)
+            {
+                stream->write(line.data(), line.size());
+                stream->writeByte('\n');
+            }
+
+            stream->flush();
+
+            if (stream->getPosition() >= maxBytes)
+                rotate();
+        }
+
+        //==============================================================================
+        LogDrain::LogDrain(Logger& source, EditorSink sink)
+            : logger(source), editorSink(std::move(sink))
+        {
+            setRate(20, 256);
+        }
+
+        LogDrain::~LogDrain()
+        {
+            stopTimer();
+        }
+
+        void LogDrain::setRate(const int newTicksPerSecond, const size_t maxEntriesPerTick)
+        {
+            ticksPerSecond = std::max(1, newTicksPerSecond);
+            entriesPerTick = std::max<size_t>(1, maxEntriesPerTick);
+            scratch.resize(entriesPerTick);
+            lines.reserve(entriesPerTick + 1);
+            startTimerHz(ticksPerSecond);
+        }
+
+        void LogDrain::setLogFile(juce::File directory, const int64_t maxBytes, const int maxFiles)
+        {
+            fileDirectory = directory;
+            fileMaxBytes = maxBytes;
+            fileMaxCount = maxFiles;
+            fileSink = std::make_unique<RotatingFileSink>(std::move(directory), "MindfulMIDI", maxBytes, maxFiles);
+            sinks |= rotatingFile;
+        }
+
+        void LogDrain::configure(const Settings& settings, const juce::File& logDirectory)
+        {
+            logger.setLevel(settings.level);
+
+            for (uint8_t i = 0; i < static_cast<uint8_t>(Category::numCategories); ++i)
+                logger.setCategoryEnabled(static_cast<Category>(i), (settings.categoryMask & (1u << i)) != 0);
+
+            if (settings.ticksPerSecond != ticksPerSecond || settings.entriesPerTick != entriesPerTick)
+                setRate(settings.ticksPerSecond, settings.entriesPerTick);
+
+            // Whatever was queued for the old sinks goes to them first
+            flush();
+
+            // An open log file is only started over when it moves or its limits change
+            if ((settings.sinks & rotatingFile) == 0)
+                fileSink.reset();
+            else if (fileSink == nullptr || logDirectory != fileDirectory || settings.maxFileBytes != fileMaxBytes
+                     || settings.maxFiles != fileMaxCount)
+                setLogFile(logDirectory, settings.maxFileBytes, settings.maxFiles);
+
+            sinks = settings.sinks;
+        }
+
+        LogDrain::Settings LogDrain::getSettings() const
+        {
+            Settings settings;
+            settings.level = logger.getLevel();
+            settings.categoryMask = logger.getCategoryMask();
+            settings.sinks = sinks;
+            settings.ticksPerSecond = ticksPerSecond;
+            settings.entriesPerTick = entriesPerTick;
+
+            if (fileSink != nullptr)
+            {
+                settings.maxFileBytes = fileMaxBytes;
+                settings.maxFiles = fileMaxCount;
+            }
+
+            return settings;
+        }
+
+        void LogDrain::flush()
+        {
+            while (drainBatch(entriesPerTick) == entriesPerTick) {}
+        }
+
+        void LogDrain::timerCallback()
+        {
+            drainBatch(entriesPerTick);
+        }
+
+        size_t LogDrain::drainBatch(const size_t maxEntries)
+        {
+            const auto count = logger.drain(scratch.data(), std::min(maxEntries, scratch.size()));
+
+            lines.clear();
+
+            for (size_t i = 0; i < count; ++i)
+                lines.push_back(formatEntry(scratch[i]));
+
+            // Report drops once per batch rather than once per lost entry
+            if (const auto drops = logger.getNumDropped(); drops != lastReportedDrops)
+            {
+                lines.push_back("[logger] dropped " + std::to_string(drops - lastReportedDrops) + " entries");
+                lastReportedDrops = drops;
+            }
+
+            if (lines.empty())
+                return count;
+
+            bool handled = false;
+
+            if ((sinks & editorConsole) != 0 && editorSink)
+                handled = editorSink(lines);
+
+            if ((sinks & standardOut) != 0 && !handled)
+            {
+                for (const auto& line : lines)
+                    std::cout << line << '\n';
+
+                std::cout.flush();
+            }
+
+            if ((sinks & rotatingFile) != 0 && fileSink != nullptr)
+                fileSink->write(lines);
+
+            return count;
+        }
+    } // namespace logging
+} // namespace mh
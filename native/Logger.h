@@ -0,0 +1,284 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <juce_core/juce_core.h>
+#include <juce_events/juce_events.h>
+
+#include <array>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Entries below this level are compiled out of MH_LOG entirely.
+// 0 = trace, 1 = debug, 2 = info, 3 = warn, 4 = error
+#ifndef MH_LOG_MINIMUM_LEVEL
+ #if JUCE_DEBUG
+  #define MH_LOG_MINIMUM_LEVEL 0
+ #else
+  #define MH_LOG_MINIMUM_LEVEL 2
+ #endif
+#endif
+
+namespace mh
+{
+    namespace logging
+    {
+        enum class Level : uint8_t
+        {
+            trace = 0,
+            debug,
+            info,
+            warn,
+            error,
+            off
+        };
+
+        enum class Category : uint8_t
+        {
+            general = 0,
+            midi,
+            audio,
+            bridge,
+            engine,
+            state,
+            numCategories
+        };
+
+        inline constexpr auto compiledMinimumLevel = static_cast<Level>(MH_LOG_MINIMUM_LEVEL);
+
+        const char* toString(Level level);
+        const char* toString(Category category);
+
+        // As toString names them, false for anything else
+        bool fromString(std::string_view name, Level& level);
+        bool fromString(std::string_view name, Category& category);
+
+        //==============================================================================
+        // A single fixed size record in the ring. Nothing in here owns heap memory, so
+        // writing one from the audio thread is a few stores and at most one memcpy.
+        // `format` must point at a string with static storage duration; its `{}`
+        // placeholders are filled from `args` only when the entry is drained.
+        struct Entry
+        {
+            static constexpr size_t maxArgs = 4;
+            static constexpr size_t maxTextLength = 191;
+
+            int64_t timestampNs = 0;
+            const char* format = nullptr;
+            std::array<double, maxArgs> args{};
+            uint8_t numArgs = 0;
+            Level level = Level::info;
+            Category category = Category::general;
+            uint8_t textLength = 0;
+            char text[maxTextLength + 1]{};
+        };
+
+        std::string formatEntry(const Entry& entry);
+
+        //==============================================================================
+        // A leveled, categorised logger backed by a preallocated bounded ring
+        // (multiple producers, one consumer). Any thread may write, including the audio
+        // thread; writes never lock or allocate and are dropped if the ring is full.
+        class Logger
+        {
+        public:
+            explicit Logger(size_t capacity = 1024);
+
+            void setLevel(Level newLevel) noexcept { level.store(newLevel, std::memory_order_relaxed); }
+            Level getLevel() const noexcept { return level.load(std::memory_order_relaxed); }
+
+            void setCategoryEnabled(Category category, bool enabled) noexcept;
+            uint32_t getCategoryMask() const noexcept { return categoryMask.load(std::memory_order_relaxed); }
+
+            bool isEnabled(Level l, Category c) const noexcept
+            {
+                return l >= level.load(std::memory_order_relaxed)
+                    && (categoryMask.load(std::memory_order_relaxed) & (1u << static_cast<uint32_t>(c))) != 0;
+            }
+
+            template <typename... Args>
+            bool write(Level l, Category c, const char* format, Args... args) noexcept
+            {
+                static_assert(sizeof...(Args) <= Entry::maxArgs, "Too many log arguments");
+
+                return push([&](Entry& e)
+                {
+                    stamp(e, l, c);
+                    e.format = format;
+                    e.numArgs = static_cast<uint8_t>(sizeof...(Args));
+                    [[maybe_unused]] size_t i = 0;
+                    ((e.args[i++] = static_cast<double>(args)), ...);
+                    e.textLength = 0;
+                });
+            }
+
+            // Copies (and truncates) the text into the entry, for messages that are not
+            // string literals, e.g. forwarded JS console output.
+            bool writeText(Level l, Category c, std::string_view text) noexcept;
+
+            // Consumer side. Only one thread may drain at a time.
+            size_t drain(Entry* dest, size_t maxEntries) noexcept;
+
+            uint32_t getNumDropped() const noexcept { return dropped.load(std::memory_order_relaxed); }
+
+        private:
+            struct Slot
+            {
+                std::atomic<size_t> sequence{0};
+                Entry entry;
+            };
+
+            template <typename Fill>
+            bool push(Fill&& fill) noexcept
+            {
+                auto pos = enqueuePos.load(std::memory_order_relaxed);
+
+                for (;;)
+                {
+                    auto& slot = slots[pos & mask];
+                    const auto seq = slot.sequence.load(std::memory_order_acquire);
+                    const auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+                    if (diff == 0)
+                    {
+                        if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        {
+                            fill(slot.entry);
+                            slot.sequence.store(pos + 1, std::memory_order_release);
+                            return true;
+                        }
+                    }
+                    else if (diff < 0)
+                    {
+                        dropped.fetch_add(1, std::memory_order_relaxed);
+                        return false;
+                    }
+                    else
+                    {
+                        pos = enqueuePos.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            void stamp(Entry& e, Level l, Category c) const noexcept;
+
+            std::unique_ptr<Slot[]> slots;
+            size_t mask = 0;
+            std::atomic<size_t> enqueuePos{0};
+            size_t dequeuePos = 0;
+
+            std::atomic<Level> level{Level::info};
+            std::atomic<uint32_t> categoryMask{~0u};
+            std::atomic<uint32_t> dropped{0};
+            const std::chrono::steady_clock::time_point startTime;
+
+            JUCE_DECLARE_NON_COPYABLE(Logger)
+        };
+
+        //==============================================================================
+        // Appends lines to a log file, moving it aside to `name.1.log`, `name.2.log`...
+        // once it grows past `maxBytes`, keeping at most `maxFiles` old files.
+        class RotatingFileSink
+        {
+        public:
+            RotatingFileSink(juce::File directory, juce::String baseName, int64_t maxBytes, int maxFiles);
+
+            void write(const std::vector<std::string>& lines);
+
+        private:
+            void rotate();
+            juce::File fileForIndex(int index) const;
+
+            juce::File directory;
+            juce::String baseName;
+            int64_t maxBytes;
+            int maxFiles;
+            std::unique_ptr<juce::FileOutputStream> stream;
+        };
+
+        //==============================================================================
+        // Pulls entries out of a Logger on the message thread at a bounded rate and
+        // hands them to the enabled sinks in batches.
+        class LogDrain : private juce::Timer
+        {
+        public:
+            enum Sinks : uint32_t
+            {
+                editorConsole = 1 << 0,
+                standardOut = 1 << 1,
+                rotatingFile = 1 << 2
+            };
+
+            // A plugin shares stdout with its host, so writing there is opt-in
+            static constexpr uint32_t defaultSinks = editorConsole | rotatingFile;
+
+            // The editor sink returns false when there is no editor to write to, in which
+            // case the batch falls through to stdout if that sink is on.
+            using EditorSink = std::function<bool(const std::vector<std::string>& lines)>;
+
+            // The logger's filters and the drain's sinks and rate together, as the
+            // processor saves them with its state
+            struct Settings
+            {
+                Level level = Level::info;
+                uint32_t categoryMask = ~0u;
+                uint32_t sinks = defaultSinks;
+                int ticksPerSecond = 20;
+                size_t entriesPerTick = 256;
+                int64_t maxFileBytes = 1 << 20;
+                int maxFiles = 4;
+
+                bool operator==(const Settings&) const = default;
+            };
+
+            LogDrain(Logger& source, EditorSink editorSink);
+            ~LogDrain() override;
+
+            // The log file, when its sink is on, goes in `logDirectory`
+            void configure(const Settings& settings, const juce::File& logDirectory);
+            Settings getSettings() const;
+
+            void setSinks(uint32_t sinkFlags) { sinks = sinkFlags; }
+            void setRate(int ticksPerSecond, size_t maxEntriesPerTick);
+            void setLogFile(juce::File directory, int64_t maxBytes = 1 << 20, int maxFiles = 4);
+
+            // Drains everything currently queued, ignoring the rate limit.
+            void flush();
+
+        private:
+            void timerCallback() override;
+            size_t drainBatch(size_t maxEntries);
+
+            Logger& logger;
+            EditorSink editorSink;
+            uint32_t sinks = defaultSinks;
+            int ticksPerSecond = 20;
+            size_t entriesPerTick = 256;
+            uint32_t lastReportedDrops = 0;
+
+            std::vector<Entry> scratch;
+            std::vector<std::string> lines;
+            std::unique_ptr<RotatingFileSink> fileSink;
+            juce::File fileDirectory;
+            int64_t fileMaxBytes = 0;
+            int fileMaxCount = 0;
+        };
+    } // namespace logging
+} // namespace mh
+
+#define MH_LOG(logger, lvl, cat, ...)                                                                \
+    do                                                                                               \
+    {                                                                                                \
+        if constexpr (mh::logging::Level::lvl >= mh::logging::compiledMinimumLevel)                  \
+        {                                                                                            \
+            if ((logger).isEnabled(mh::logging::Level::lvl, mh::logging::Category::cat))             \
+                (logger).write(mh::logging::Level::lvl, mh::logging::Category::cat, __VA_ARGS__);    \
+        }                                                                                            \
+    } while (false)
+
+#endif //LOGGER_H
@@ -0,0 +1,366 @@
+#include "MidiFileStream.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace mh
+{
+    namespace smf
+    {
+        Writer::Writer(juce::File destination, const uint16_t ticksPerQuarterNote)
+            : file(std::move(destination)), ppq(ticksPerQuarterNote)
+        {
+        }
+
+        bool Writer::begin()
+        {
+            file.deleteFile();
+            out = std::make_unique<juce::FileOutputStream>(file);
+
+            if (out->failedToOpen())
+            {
+                out.reset();
+                return false;
+            }
+
+            out->write("MThd", 4);
+            out->writeIntBigEndian(6);
+            out->writeShortBigEndian(0); // format 0
+            out->writeShortBigEndian(1); // one track
+            out->writeShortBigEndian(static_cast<short>(ppq));
+
+            out->write("MTrk", 4);
+            trackLengthPosition = out->getPosition();
+            out->writeIntBigEndian(0); // patched by finish()
+            trackStartPosition = out->getPosition();
+            lastTick = 0;
+            return true;
+        }
+
+        void Writer::writeVariableLength(uint32_t value)
+        {
+            uint8_t bytes[5];
+            int n = 0;
+
+            bytes[n++] = static_cast<uint8_t>(value & 0x7F);
+            while ((value >>= 7) != 0)
+                bytes[n++] = static_cast<uint8_t>((value & 0x7F) | 0x80);
+
+            while (n > 0)
+                out->writeByte(static_cast<char>(bytes[--n]));
+        }
+
+        void Writer::writeDelta(const uint64_t tick)
+        {
+            // Events must arrive in time order; anything early is written at lastTick
+            const auto delta = tick > lastTick ? tick - lastTick : 0;
+            writeVariableLength(static_cast<uint32_t>(std::min<uint64_t>(delta, 0x0FFFFFFF)));
+            lastTick = std::max(lastTick, tick);
+        }
+
+        void Writer::writeTempo(const uint64_t tick, const double bpm)
+        {
+            if (out == nullptr || bpm <= 0)
+                return;
+
+            const auto microsPerQuarter = static_cast<uint32_t>(60000000.0 / bpm);
+            writeDelta(tick);
+            const uint8_t meta[] = {0xFF, 0x51, 0x03,
+                                    static_cast<uint8_t>(microsPerQuarter >> 16),
+                                    static_cast<uint8_t>(microsPerQuarter >> 8),
+                                    static_cast<uint8_t>(microsPerQuarter)};
+            out->write(meta, sizeof(meta));
+        }
+
+        void Writer::writeEvent(const uint64_t tick, const uint8_t* data, const size_t size)
+        {
+            if (out == nullptr || size == 0 || data[0] < 0x80 || data[0] >= 0xF0)
+                return;
+
+            writeDelta(tick);
+            out->write(data, size);
+        }
+
+        bool Writer::finish()
+        {
+            if (out == nullptr)
+                return false;
+
+            writeVariableLength(0);
+            const uint8_t endOfTrack[] = {0xFF, 0x2F, 0x00};
+            out->write(endOfTrack, sizeof(endOfTrack));
+
+            const auto trackLength = out->getPosition() - trackStartPosition;
+            out->setPosition(trackLengthPosition);
+            out->writeIntBigEndian(static_cast<int>(trackLength));
+            out->flush();
+
+            const auto ok = out->getStatus().wasOk();
+            out.reset();
+            return ok;
+        }
+
+        //==============================================================================
+        bool Reader::fail(std::string message)
+        {
+            error = std::move(message);
+            return false;
+        }
+
+        bool Reader::read(const juce::File& source, const EventFn& onEvent, const ProgressFn& onProgress)
+        {
+            error.clear();
+
+            auto fileStream = std::make_unique<juce::FileInputStream>(source);
+
+            if (fileStream->failedToOpen())
+                return fail("Could not open " + source.getFullPathName().toStdString());
+
+            const auto totalLength = std::max<int64_t>(1, fileStream->getTotalLength());
+            juce::BufferedInputStream in(fileStream.release(), 1 << 16, true);
+
+            const auto readVariableLength = [&in]()
+            {
+                uint32_t value = 0;
+                for (int i = 0; i < 4; ++i)
+                {
+                    const auto b = static_cast<uint8_t>(in.readByte());
+                    value = (value << 7) | (b & 0x7F);
+                    if ((b & 0x80) == 0)
+                        break;
+                }
+                return value;
+            };
+
+            char id[4];
+            if (in.read(id, 4) != 4 || std::memcmp(id, "MThd", 4) != 0)
+                return fail("Not a Standard MIDI File");
+
+            const auto headerLength = static_cast<uint32_t>(in.readIntBigEndian());
+            format = static_cast<uint16_t>(in.readShortBigEndian());
+            numTracks = static_cast<uint16_t>(in.readShortBigEndian());
+            const auto division = static_cast<uint16_t>(in.readShortBigEndian());
+
+            if (headerLength > 6)
+                in.skipNextBytes(headerLength - 6);
+
+            if (format > 1)
+                return fail("Only format 0 and 1 MIDI files are supported");
+
+            if ((division & 0x8000) != 0)
+                return fail("SMPTE timed MIDI files are not supported");
+
+            ppq = division;
+
+            bool haveTempo = false;
+            int64_t lastReported = 0;
+
+            for (uint16_t track = 0; track < numTracks && !in.isExhausted();)
+            {
+                if (in.read(id, 4) != 4)
+                    break;
+
+                const auto chunkLength = static_cast<uint32_t>(in.readIntBigEndian());
+                const auto chunkEnd = in.getPosition() + chunkLength;
+
+                // Unknown chunks are allowed and ignored
+                if (std::memcmp(id, "MTrk", 4) != 0)
+                {
+                    in.skipNextBytes(chunkLength);
+                    continue;
+                }
+
+                uint64_t tick = 0;
+                uint8_t runningStatus = 0;
+
+                while (in.getPosition() < chunkEnd && !in.isExhausted())
+                {
+                    tick += readVariableLength();
+                    auto status = static_cast<uint8_t>(in.readByte());
+                    uint8_t data1 = 0;
+
+                    if (status < 0x80)
+                    {
+                        if (runningStatus == 0)
+                            return fail("Corrupt track: data byte without status");
+
+                        data1 = status;
+                        status = runningStatus;
+                    }
+                    else if (status < 0xF0)
+                    {
+                        runningStatus = status;
+                        data1 = static_cast<uint8_t>(in.readByte());
+                    }
+
+                    if (status == 0xFF)
+                    {
+                        runningStatus = 0;
+                        const auto type = static_cast<uint8_t>(in.readByte());
+                        const auto length = readVariableLength();
+
+                        if (type == 0x51 && length == 3 && !haveTempo)
+                        {
+                            uint8_t t[3];
+                            in.read(t, 3);
+                            const auto micros = (uint32_t(t[0]) << 16) | (uint32_t(t[1]) << 8) | t[2];
+                            if (micros > 0)
+                                bpm = 60000000.0 / micros;
+                            haveTempo = true;
+                        }
+                        else
+                        {
+                            in.skipNextBytes(length);
+                        }
+
+                        if (type == 0x2F)
+                            break;
+                    }
+                    else if (status == 0xF0 || status == 0xF7)
+                    {
+                        runningStatus = 0;
+                        in.skipNextBytes(readVariableLength());
+                    }
+                    else if (status >= 0xF0)
+                    {
+                        return fail("Corrupt track: unexpected system message in file");
+                    }
+                    else
+                    {
+                        const auto type = status & 0xF0;
+                        const auto data2 = (type == 0xC0 || type == 0xD0) ? uint8_t(0) : static_cast<uint8_t>(in.readByte());
+
+                        if (onEvent)
+                            onEvent({track, tick, status, data1, data2});
+                    }
+
+                    if (onProgress && in.getPosition() - lastReported > (1 << 16))
+                    {
+                        lastReported = in.getPosition();
+                        if (!onProgress(static_cast<float>(lastReported) / static_cast<float>(totalLength)))
+                            return fail("Cancelled");
+                    }
+                }
+
+                // Tolerate tracks that end before or after their declared length
+                if (in.getPosition() < chunkEnd)
+                    in.setPosition(chunkEnd);
+
+                ++track;
+            }
+
+            if (onProgress)
+                onProgress(1.0f);
+
+            return true;
+        }
+
+        //==============================================================================
+        void ChordCollector::add(const Event& e)
+        {
+            if ((e.status & 0xF0) != 0x90 || e.data2 == 0)
+                return;
+
+            if (!notes.empty() && e.tick < notes.back().tick)
+                ordered = false;
+
+            notes.push_back({e.tick, e.data1});
+        }
+
+        std::vector<ChordCollector::Chord> ChordCollector::takeChords(const uint64_t toleranceTicks)
+        {
+            // Tracks of a format 1 file arrive one after another, so merge them by time
+            if (!ordered)
+                std::stable_sort(notes.begin(), notes.end(), [](const NoteOn& a, const NoteOn& b)
+                {
+                    return a.tick < b.tick;
+                });
+
+            std::vector<Chord> chords;
+
+            for (const auto& n : notes)
+            {
+                if (chords.empty() || n.tick > chords.back().tick + toleranceTicks)
+                    chords.push_back({n.tick, {}});
+
+                auto& chord = chords.back().notes;
+                const auto note = static_cast<uint8_t>(n.note);
+
+                if (std::find(chord.begin(), chord.end(), note) == chord.end())
+                    chord.insert(std::upper_bound(chord.begin(), chord.end(), note), note);
+            }
+
+            notes.clear();
+            notes.shrink_to_fit();
+            ordered = true;
+            return chords;
+        }
+
+        //==============================================================================
+        ChordWriter::ChordWriter(juce::File destination, const double t)
+            : writer(std::move(destination)),
+              tempo(t),
+              ticksPerSecond(t / 60.0 * writer.getTicksPerQuarterNote()),
+              groupTolerance(static_cast<uint64_t>(writer.getTicksPerQuarterNote() / 16))
+        {
+        }
+
+        bool ChordWriter::begin()
+        {
+            if (!writer.begin())
+                return false;
+
+            writer.writeTempo(0, tempo);
+            return true;
+        }
+
+        void ChordWriter::add(const std::vector<uint8_t>& bytes, const double seconds)
+        {
+            const auto tick = static_cast<uint64_t>(std::max(0.0, seconds) * ticksPerSecond);
+
+            if (written++ == 0 || tick > groupTick + groupTolerance)
+            {
+                releaseHeld(tick);
+                groupTick = tick;
+            }
+
+            if (bytes.size() == 3 && bytes[0] >= 0x80)
+            {
+                writer.writeEvent(tick, bytes.data(), bytes.size());
+
+                const auto type = bytes[0] & 0xF0;
+                const auto key = static_cast<uint16_t>(((bytes[0] & 0x0F) << 8) | (bytes[1] & 0x7F));
+
+                if (type == 0x90 && bytes[2] > 0)
+                    held.push_back(key);
+                else if (type == 0x80 || type == 0x90)
+                    held.erase(std::remove(held.begin(), held.end(), key), held.end());
+
+                return;
+            }
+
+            for (const auto note : bytes)
+            {
+                const uint8_t on[] = {0x90, static_cast<uint8_t>(note & 0x7F), 100};
+                writer.writeEvent(tick, on, 3);
+                held.push_back(static_cast<uint16_t>(note & 0x7F));
+            }
+        }
+
+        bool ChordWriter::finish()
+        {
+            releaseHeld(groupTick + writer.getTicksPerQuarterNote());
+            return writer.finish();
+        }
+
+        void ChordWriter::releaseHeld(const uint64_t tick)
+        {
+            for (const auto h : held)
+            {
+                const uint8_t off[] = {static_cast<uint8_t>(0x80 | (h >> 8)), static_cast<uint8_t>(h & 0x7F), 0};
+                writer.writeEvent(tick, off, 3);
+            }
+            held.clear();
+        }
+    } // namespace smf
+} // namespace mh
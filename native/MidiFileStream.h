@@ -0,0 +1,278 @@
+#ifndef MIDIFILESTREAM_H
+#define MIDIFILESTREAM_H
+
+#include <juce_core/juce_core.h>
+
+#include "PersistentVector.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mh
+{
+    namespace smf
+    {
+        //==============================================================================
+        // Writes a format 0 Standard MIDI File event by event through the file
+        // stream's own buffer. The track length is patched in by finish(), so the
+        // whole file never has to exist in memory.
+        class Writer
+        {
+        public:
+            Writer(juce::File destination, uint16_t ticksPerQuarterNote = 480);
+
+            bool begin();
+            void writeTempo(uint64_t tick, double bpm);
+            void writeEvent(uint64_t tick, const uint8_t* data, size_t size);
+            bool finish();
+
+            uint16_t getTicksPerQuarterNote() const noexcept { return ppq; }
+
+        private:
+            void writeVariableLength(uint32_t value);
+            void writeDelta(uint64_t tick);
+
+            juce::File file;
+            uint16_t ppq;
+            std::unique_ptr<juce::FileOutputStream> out;
+            int64_t trackLengthPosition = 0;
+            int64_t trackStartPosition = 0;
+            uint64_t lastTick = 0;
+        };
+
+        //==============================================================================
+        struct Event
+        {
+            uint16_t track = 0;
+            uint64_t tick = 0;
+            uint8_t status = 0;
+            uint8_t data1 = 0;
+            uint8_t data2 = 0;
+        };
+
+        // A single pass, streaming parser for format 0 and 1 files of any size.
+        // Channel events are handed to `onEvent` as they are decoded, track by track in
+        // file order; meta and sysex events are skipped except for the first tempo.
+        class Reader
+        {
+        public:
+            using EventFn = std::function<void(const Event&)>;
+            using ProgressFn = std::function<bool(float)>; // return false to cancel
+
+            bool read(const juce::File& source, const EventFn& onEvent, const ProgressFn& onProgress = nullptr);
+
+            uint16_t getFormat() const noexcept { return format; }
+            uint16_t getNumTracks() const noexcept { return numTracks; }
+            uint16_t getTicksPerQuarterNote() const noexcept { return ppq; }
+            double getTempo() const noexcept { return bpm; }
+            const std::string& getError() const noexcept { return error; }
+
+        private:
+            bool fail(std::string message);
+
+            uint16_t format = 0;
+            uint16_t numTracks = 0;
+            uint16_t ppq = 480;
+            double bpm = 120.0;
+            std::string error;
+        };
+
+        //==============================================================================
+        // Turns note-on events into chords: notes that start within a tolerance of
+        // the first note of a group are one chord. Only the note-on times are kept
+        // while reading, so memory stays at 8 bytes per note however big the file.
+        class ChordCollector
+        {
+        public:
+            struct Chord
+            {
+                uint64_t tick = 0;
+                std::vector<uint8_t> notes;
+            };
+
+            void add(const Event& e);
+            std::vector<Chord> takeChords(uint64_t toleranceTicks);
+
+        private:
+            struct NoteOn
+            {
+                uint64_t tick : 56;
+                uint64_t note : 8;
+            };
+
+            std::vector<NoteOn> notes;
+            bool ordered = true;
+        };
+
+        //==============================================================================
+        // Writes chords at a fixed tempo from their times in seconds. Chords that
+        // start within a 16th of a beat of each other sound together, and each group
+        // is released when the next one starts. A chord is either a list of note
+        // numbers or a raw three byte message, as logged for outgoing MIDI.
+        class ChordWriter
+        {
+        public:
+            explicit ChordWriter(juce::File destination, double tempo = 120.0);
+
+            bool begin();
+            void add(const std::vector<uint8_t>& bytes, double seconds);
+            bool finish();
+
+        private:
+            void releaseHeld(uint64_t tick);
+
+            Writer writer;
+            const double tempo;
+            const double ticksPerSecond;
+            // sendMIDI posts the notes of one chord as separate entries a few ms apart
+            const uint64_t groupTolerance;
+
+            std::vector<uint16_t> held; // channel << 8 | note for every note sounding in the current group
+            uint64_t groupTick = 0;
+            size_t written = 0;
+        };
+
+        //==============================================================================
+        // Reads or writes a file on a worker thread. Export walks a published
+        // snapshot of a chord log, so its owner can keep editing; import builds a new
+        // progression that the owner takes once the job reports it has finished.
+        // `Chord` has `noteNumbers` and a `time` in seconds. `notify` is called from
+        // the worker as progress is made and when the job is done.
+        template <typename Chord>
+        class FileJob final : public juce::ThreadPoolJob
+        {
+        public:
+            enum class Operation
+            {
+                exportFile,
+                importFile
+            };
+
+            using Progression = PersistentVector<Chord>;
+            using Snapshot = typename VersionHistory<Chord>::Snapshot;
+
+            FileJob(const Operation op, juce::File f, std::shared_ptr<const Snapshot> s, std::function<void()> n)
+                : juce::ThreadPoolJob("MIDI file"), operation(op), file(std::move(f)), snapshot(std::move(s)), notify(std::move(n))
+            {
+            }
+
+            JobStatus runJob() override
+            {
+                ok = operation == Operation::exportFile ? runExport() : runImport();
+                finished.store(true);
+                notify();
+                return jobHasFinished;
+            }
+
+            const Operation operation;
+            const juce::File file;
+            std::atomic<float> progress { 0.0f };
+            std::atomic<bool> finished { false };
+
+            // Only read by the owner after `finished`
+            bool ok = false;
+            std::string error;
+            Progression imported;
+
+        private:
+            bool report(const float p)
+            {
+                const auto previous = progress.exchange(p);
+                if (static_cast<int>(p * 100.0f) != static_cast<int>(previous * 100.0f))
+                    notify();
+
+                return !shouldExit();
+            }
+
+            bool runExport()
+            {
+                ChordWriter writer(file);
+
+                if (snapshot == nullptr || !writer.begin())
+                {
+                    error = "Could not write " + file.getFullPathName().toStdString();
+                    return false;
+                }
+
+                const auto& chords = snapshot->data;
+                size_t written = 0;
+                bool cancelled = false;
+
+                chords.forEach([&](const Chord& chord)
+                {
+                    if (cancelled)
+                        return;
+
+                    writer.add(chord.noteNumbers, chord.time);
+
+                    if ((++written & 1023) == 0 && !report(static_cast<float>(written) / static_cast<float>(chords.size())))
+                        cancelled = true;
+                });
+
+                const auto finishedOk = writer.finish();
+
+                if (cancelled)
+                {
+                    error = "Cancelled";
+                    file.deleteFile();
+                    return false;
+                }
+
+                report(1.0f);
+
+                if (!finishedOk)
+                    error = "Could not finish writing " + file.getFullPathName().toStdString();
+
+                return finishedOk;
+            }
+
+            bool runImport()
+            {
+                Reader reader;
+                ChordCollector collector;
+
+                // Reading is most of the work; building the progression is the last 10%
+                const auto readOk = reader.read(file,
+                                                [&collector](const Event& e) { collector.add(e); },
+                                                [this](const float p) { return report(p * 0.9f); });
+
+                if (!readOk)
+                {
+                    error = reader.getError();
+                    return false;
+                }
+
+                const auto ppq = std::max<uint16_t>(1, reader.getTicksPerQuarterNote());
+                const auto secondsPerTick = 60.0 / (reader.getTempo() * ppq);
+                const auto chords = collector.takeChords(ppq / 16);
+
+                for (size_t i = 0; i < chords.size(); ++i)
+                {
+                    Chord chord;
+                    chord.noteNumbers = chords[i].notes;
+                    chord.time = static_cast<double>(chords[i].tick) * secondsPerTick;
+                    imported = imported.push_back(std::move(chord));
+
+                    if ((i & 1023) == 0 && !report(0.9f + 0.1f * static_cast<float>(i) / static_cast<float>(chords.size())))
+                    {
+                        error = "Cancelled";
+                        return false;
+                    }
+                }
+
+                report(1.0f);
+                return true;
+            }
+
+            std::shared_ptr<const Snapshot> snapshot;
+            std::function<void()> notify;
+        };
+    } // namespace smf
+} // namespace mh
+
+#endif //MIDIFILESTREAM_H
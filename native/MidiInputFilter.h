@@ -0,0 +1,305 @@
+#ifndef MIDIINPUTFILTER_H
+#define MIDIINPUTFILTER_H
+
+#include <choc_MIDI.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <utility>
+
+namespace mh
+{
+    //==============================================================================
+    // Thins out incoming MIDI on the audio thread, before it crosses to the
+    // message thread and both JS contexts.
+    //
+    // Message types are dropped by a mask with a bit per status: channel messages
+    // by their high nibble, system messages by their low one. Clock and active
+    // sensing are dropped unless asked for, and sysex never crosses.
+    //
+    // Continuous values (controllers, pitch bend and both kinds of pressure) are
+    // collapsed to the latest one per block: a later value takes the place of an
+    // earlier one still waiting to go. Controllers that switch or select, such as
+    // sustain, RPN/NRPN and channel mode, keep every value, as there the order
+    // and the count matter.
+    //
+    // With a rate limit set, a value that comes sooner after the last one sent
+    // than the limit allows is held rather than dropped, and goes out once the
+    // time is up, so the final position of a fader always arrives.
+    //
+    // Settings can change from any thread; everything else is audio thread only
+    // and nothing allocates.
+    class MidiInputFilter
+    {
+    public:
+        static constexpr uint32_t bitFor(const uint8_t status) noexcept
+        {
+            return status >= 0xF0 ? 1u << (16 + (status & 0x0F)) : 1u << (status >> 4);
+        }
+
+        static constexpr uint32_t defaultDropMask = 1u << (16 + 0x8) | 1u << (16 + 0xE); // clock, active sensing
+
+        struct Settings
+        {
+            uint32_t dropMask = defaultDropMask;
+            bool coalesce = true;
+            float maxRateHz = 0; // per controller, 0 for no limit
+
+            bool operator==(const Settings&) const = default;
+        };
+
+        // As the front end names the message types
+        static uint32_t bitFor(const std::string_view name) noexcept
+        {
+            for (const auto& [n, status] : names)
+                if (n == name)
+                    return bitFor(status);
+
+            return 0;
+        }
+
+        // What one block let through and held back
+        struct Counts
+        {
+            uint32_t dropped = 0;
+            uint32_t coalesced = 0;
+            uint32_t held = 0;
+        };
+
+        static constexpr size_t maxEventsPerBlock = 512;
+
+        MidiInputFilter() { reset(); }
+
+        //==============================================================================
+        void configure(const Settings& s) noexcept
+        {
+            dropMask.store(s.dropMask, std::memory_order_relaxed);
+            coalesce.store(s.coalesce, std::memory_order_relaxed);
+            maxRateHz.store(std::max(s.maxRateHz, 0.0f), std::memory_order_relaxed);
+        }
+
+        Settings getSettings() const noexcept
+        {
+            return {dropMask.load(std::memory_order_relaxed), coalesce.load(std::memory_order_relaxed),
+                    maxRateHz.load(std::memory_order_relaxed)};
+        }
+
+        //==============================================================================
+        void prepare(const double newSampleRate) noexcept
+        {
+            sampleRate = newSampleRate;
+            reset();
+        }
+
+        void reset() noexcept
+        {
+            clock = 0;
+            numEvents = 0;
+            numHeld = 0;
+            pending.fill(none);
+            lastSent.fill(std::numeric_limits<int64_t>::min() / 2);
+            heldAt.fill(none);
+        }
+
+        // Settings stay the same for the whole block
+        void beginBlock() noexcept
+        {
+            const auto settings = getSettings();
+            blockDropMask = settings.dropMask;
+            blockCoalesce = settings.coalesce;
+            interval = settings.maxRateHz > 0 ? static_cast<int64_t>(sampleRate / settings.maxRateHz) : 0;
+            counts = {};
+        }
+
+        // In time order, as a MidiBuffer holds them
+        void add(const uint8_t* data, const int numBytes, const int offset) noexcept
+        {
+            if (numBytes <= 0 || numBytes > 3 || data[0] < 0x80 || (blockDropMask & bitFor(data[0])) != 0)
+            {
+                ++counts.dropped;
+                return;
+            }
+
+            const choc::midi::ShortMessage message(data[0], numBytes > 1 ? data[1] : 0, numBytes > 2 ? data[2] : 0);
+            const auto key = keyFor(message);
+
+            if (key == none)
+            {
+                push(message, offset, none);
+                return;
+            }
+
+            // A held value is simply replaced, it goes once the limit allows
+            if (heldAt[key] != none)
+            {
+                held[heldAt[key]].message = message;
+                ++counts.coalesced;
+                return;
+            }
+
+            if (blockCoalesce && pending[key] != none)
+            {
+                events[pending[key]].message = message;
+                ++counts.coalesced;
+                return;
+            }
+
+            const auto time = clock + offset;
+
+            if (interval > 0 && time < lastSent[key] + interval)
+            {
+                heldAt[key] = static_cast<uint16_t>(numHeld);
+                held[numHeld++] = {message, lastSent[key] + interval, key};
+                ++counts.held;
+                return;
+            }
+
+            lastSent[key] = time;
+            push(message, offset, key);
+        }
+
+        // Calls emit(sampleOffset, message) for everything let through this block,
+        // held values that came due included, in time order
+        template <typename EmitFn>
+        Counts endBlock(const int numSamples, EmitFn&& emit) noexcept
+        {
+            const auto end = clock + std::max(numSamples, 1);
+
+            for (size_t i = 0; i < numHeld;)
+            {
+                const auto h = held[i];
+
+                // Anything held past a change of limit goes now
+                const auto due = std::min(h.due, lastSent[h.key] + interval);
+
+                if (due >= end || numEvents == maxEventsPerBlock)
+                {
+                    ++i;
+                    continue;
+                }
+
+                const auto offset = static_cast<int>(std::max<int64_t>(due - clock, 0));
+                lastSent[h.key] = clock + offset;
+                heldAt[h.key] = none;
+                events[numEvents++] = {h.message, offset, none};
+
+                // Swap in the last one, keeping the index of the one moved
+                held[i] = held[--numHeld];
+                if (i < numHeld)
+                    heldAt[held[i].key] = static_cast<uint16_t>(i);
+            }
+
+            std::stable_sort(events.begin(), events.begin() + static_cast<long>(numEvents),
+                             [](const Event& a, const Event& b) { return a.offset < b.offset; });
+
+            for (size_t i = 0; i < numEvents; ++i)
+            {
+                if (events[i].key != none)
+                    pending[events[i].key] = none;
+
+                emit(events[i].offset, events[i].message);
+            }
+
+            numEvents = 0;
+            clock = end;
+            return counts;
+        }
+
+        size_t getNumHeld() const noexcept { return numHeld; }
+
+    private:
+        static constexpr uint16_t none = 0xFFFF;
+
+        // Controllers, then polyphonic pressure, then pitch bend and channel
+        // pressure per channel
+        static constexpr size_t numKeys = 16 * 128 + 16 * 128 + 16 + 16;
+
+        static constexpr std::pair<std::string_view, uint8_t> names[] = {
+            {"noteOff", 0x80},        {"noteOn", 0x90},        {"polyPressure", 0xA0},
+            {"controlChange", 0xB0},  {"programChange", 0xC0}, {"channelPressure", 0xD0},
+            {"pitchBend", 0xE0},      {"sysex", 0xF0},         {"timecode", 0xF1},
+            {"songPosition", 0xF2},   {"songSelect", 0xF3},    {"tuneRequest", 0xF6},
+            {"clock", 0xF8},          {"start", 0xFA},         {"continue", 0xFB},
+            {"stop", 0xFC},           {"activeSensing", 0xFE}, {"reset", 0xFF},
+        };
+
+        static constexpr bool switchesOrSelects(const uint8_t controller) noexcept
+        {
+            return controller == 6 || controller == 38           // data entry, follows the RPN/NRPN select
+                   || (controller >= 64 && controller <= 69)     // pedals and switches
+                   || (controller >= 96 && controller <= 101)    // data increment, RPN/NRPN select
+                   || controller >= 120;                         // channel mode
+        }
+
+        static uint16_t keyFor(const choc::midi::ShortMessage& m) noexcept
+        {
+            const auto channel = m.data[0] & 0x0F;
+
+            switch (m.data[0] & 0xF0)
+            {
+                case 0xB0:
+                    return switchesOrSelects(m.data[1] & 0x7F) ? none
+                                                               : static_cast<uint16_t>(channel * 128 + (m.data[1] & 0x7F));
+                case 0xA0: return static_cast<uint16_t>(2048 + channel * 128 + (m.data[1] & 0x7F));
+                case 0xE0: return static_cast<uint16_t>(4096 + channel);
+                case 0xD0: return static_cast<uint16_t>(4112 + channel);
+                default:   return none;
+            }
+        }
+
+        void push(const choc::midi::ShortMessage& message, const int offset, const uint16_t key) noexcept
+        {
+            if (numEvents == maxEventsPerBlock)
+            {
+                ++counts.dropped;
+                return;
+            }
+
+            if (key != none)
+                pending[key] = static_cast<uint16_t>(numEvents);
+
+            events[numEvents++] = {message, offset, key};
+        }
+
+        struct Event
+        {
+            choc::midi::ShortMessage message;
+            int offset = 0;
+            uint16_t key = none;
+        };
+
+        struct Held
+        {
+            choc::midi::ShortMessage message;
+            int64_t due = 0; // samples since prepare
+            uint16_t key = 0;
+        };
+
+        std::atomic<uint32_t> dropMask{defaultDropMask};
+        std::atomic<bool> coalesce{true};
+        std::atomic<float> maxRateHz{0};
+
+        double sampleRate = 44100;
+        int64_t clock = 0;
+
+        uint32_t blockDropMask = defaultDropMask;
+        bool blockCoalesce = true;
+        int64_t interval = 0;
+        Counts counts;
+
+        std::array<Event, maxEventsPerBlock> events{};
+        size_t numEvents = 0;
+        std::array<uint16_t, numKeys> pending{}; // index into events of a value still to go this block
+
+        std::array<int64_t, numKeys> lastSent{};
+        std::array<Held, numKeys> held{};
+        std::array<uint16_t, numKeys> heldAt{};
+        size_t numHeld = 0;
+    };
+} // namespace mh
+
+#endif //MIDIINPUTFILTER_H
@@ -0,0 +1,85 @@
+#include "MidiScheduler.h"
+
+namespace mh
+{
+    void MidiScheduler::FixedHeap::reserve(const size_t newCapacity)
+    {
+        capacity = newCapacity;
+        items.reserve(capacity);
+    }
+
+    bool MidiScheduler::FixedHeap::push(const Pending& p) noexcept
+    {
+        // Never grow past the reserved storage, the audio thread must not allocate
+        if (items.size() >= capacity)
+            return false;
+
+        items.push_back(p);
+        std::push_heap(items.begin(), items.end(), Later{});
+        return true;
+    }
+
+    void MidiScheduler::FixedHeap::pop() noexcept
+    {
+        std::pop_heap(items.begin(), items.end(), Later{});
+        items.pop_back();
+    }
+
+    //==============================================================================
+    MidiScheduler::MidiScheduler(const size_t capacity)
+    {
+        bySample.reserve(capacity);
+        byBeat.reserve(capacity);
+    }
+
+    double MidiScheduler::quantizeUp(const double ppq, const double grid) noexcept
+    {
+        if (grid <= 0)
+            return ppq;
+
+        // Allow a little slack so an event that is already on the grid stays there
+        return std::ceil(ppq / grid - 1.0e-9) * grid;
+    }
+
+    bool MidiScheduler::schedule(const choc::midi::ShortMessage& message, const Timing& timing,
+                                 const Transport& transport, const NoteExpression& expression) noexcept
+    {
+        const auto samplesPerBeat = transport.samplesPerBeat();
+        const auto blockStart = static_cast<double>(sampleClock);
+        const Pending base{0, nextSequence++, message, expression};
+
+        // Absolute positions can only be honoured against a running host timeline
+        if (timing.base == TimeBase::ppq)
+        {
+            auto p = base;
+            p.key = quantizeUp(timing.time, timing.quantizeBeats);
+            return byBeat.push(p);
+        }
+
+        // Everything else is relative to now. With a grid available and quantize
+        // requested, resolve to a host position so it lands on the beat.
+        double delaySamples = 0;
+
+        if (timing.base == TimeBase::samplesFromNow)
+            delaySamples = std::max(0.0, timing.time);
+        else if (timing.base == TimeBase::beatsFromNow)
+            delaySamples = std::max(0.0, timing.time) * samplesPerBeat;
+
+        if (timing.quantizeBeats > 0 && transport.hasGrid())
+        {
+            auto p = base;
+            p.key = quantizeUp(transport.ppqPosition + delaySamples / samplesPerBeat, timing.quantizeBeats);
+            return byBeat.push(p);
+        }
+
+        auto p = base;
+        p.key = blockStart + delaySamples;
+        return bySample.push(p);
+    }
+
+    void MidiScheduler::clear() noexcept
+    {
+        bySample.clear();
+        byBeat.clear();
+    }
+} // namespace mh
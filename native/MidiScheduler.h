@@ -0,0 +1,246 @@
+#ifndef MIDISCHEDULER_H
+#define MIDISCHEDULER_H
+
+#include <choc_MIDI.h>
+
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace mh
+{
+    // Per-note expression carried with an outgoing event. Only note-ons use it,
+    // and only once MPE output is configured, see MpeAllocator.
+    struct NoteExpression
+    {
+        float pitchBend = 0; // semitones
+        float pressure = 0;  // 0..1
+    };
+
+    //==============================================================================
+    // Audio thread scheduler for outgoing MIDI. Events are stamped either in samples
+    // or in beats, optionally quantized to the host grid, and held in preallocated
+    // priority queues until the block that contains them, where they are emitted at
+    // their exact sample offset.
+    //
+    // Sample-stamped events run on the scheduler's own sample clock, so they play out
+    // whether or not the host transport is rolling. Beat-stamped events are keyed to
+    // the host PPQ position and only fire while the transport is playing. When it
+    // stops, jumps back or wraps its loop, their pending note-offs go out at once so
+    // nothing is left hanging, and the note-ons they would have ended are dropped.
+    class MidiScheduler
+    {
+    public:
+        enum class TimeBase : uint8_t
+        {
+            now = 0,        // as soon as possible, in the next processed block
+            samplesFromNow, // `time` samples after the block the event arrives in
+            beatsFromNow,   // `time` quarter notes after the block the event arrives in
+            ppq             // absolute host position in quarter notes
+        };
+
+        static constexpr bool isTimeBase(const int value) noexcept
+        {
+            return value >= static_cast<int>(TimeBase::now) && value <= static_cast<int>(TimeBase::ppq);
+        }
+
+        struct Timing
+        {
+            TimeBase base = TimeBase::now;
+            double time = 0;
+            // When > 0 and the host provides a position, the event is moved forward
+            // to the next multiple of this many quarter notes.
+            double quantizeBeats = 0;
+        };
+
+        struct Transport
+        {
+            bool isPlaying = false;
+            bool hasPpq = false;
+            double ppqPosition = 0;
+            double bpm = 120.0;
+            double sampleRate = 44100.0;
+            bool isLooping = false;
+            double loopStartPpq = 0;
+            double loopEndPpq = 0;
+
+            double samplesPerBeat() const noexcept { return sampleRate * 60.0 / std::max(1.0, bpm); }
+            bool hasGrid() const noexcept { return isPlaying && hasPpq; }
+        };
+
+        explicit MidiScheduler(size_t capacity = 1024);
+
+        // Audio thread only. Returns false if the queue is full and the event was dropped.
+        bool schedule(const choc::midi::ShortMessage& message, const Timing& timing, const Transport& transport,
+                      const NoteExpression& expression = {}) noexcept;
+
+        // Audio thread only. Calls emit(sampleOffset, message, expression) for every event due in the
+        // block that starts at the current scheduler clock, then advances the clock.
+        template <typename EmitFn>
+        void process(const Transport& transport, int numSamples, EmitFn&& emit) noexcept
+        {
+            if (numSamples <= 0)
+                return;
+
+            const auto blockEnd = static_cast<double>(sampleClock + numSamples);
+            const auto lastSample = numSamples - 1;
+
+            while (!bySample.empty() && bySample.top().key < blockEnd)
+            {
+                const auto& e = bySample.top();
+                const auto offset = static_cast<int>(std::floor(e.key - static_cast<double>(sampleClock)));
+                emit(std::clamp(offset, 0, lastSample), e.message, e.expression);
+                bySample.pop();
+            }
+
+            const bool wasRunning = hadGrid;
+            hadGrid = transport.hasGrid();
+
+            if (wasRunning && !transport.hasGrid())
+                releaseBeatNotes(0, emit);
+
+            if (transport.hasGrid())
+            {
+                const auto samplesPerBeat = transport.samplesPerBeat();
+                auto ppq = transport.ppqPosition;
+                auto ppqEnd = ppq + numSamples / samplesPerBeat;
+                double startSample = 0;
+
+                // The host jumped back, relocating or wrapping its loop between blocks.
+                // The slack absorbs hosts that round their positions.
+                if (wasRunning && ppq < expectedPpq - std::max(4.0 / samplesPerBeat, 1.0e-3))
+                    releaseBeatNotes(0, emit);
+
+                // A block crossing the end of the host loop carries on from its start
+                if (transport.isLooping && transport.loopEndPpq > transport.loopStartPpq
+                    && ppq < transport.loopEndPpq && ppqEnd > transport.loopEndPpq)
+                {
+                    startSample = (transport.loopEndPpq - ppq) * samplesPerBeat;
+                    emitBeatEvents(ppq, transport.loopEndPpq, 0, samplesPerBeat, lastSample, emit);
+                    releaseBeatNotes(std::clamp(static_cast<int>(std::floor(startSample)), 0, lastSample), emit);
+
+                    ppqEnd = transport.loopStartPpq + (ppqEnd - transport.loopEndPpq);
+                    ppq = transport.loopStartPpq;
+                }
+
+                emitBeatEvents(ppq, ppqEnd, startSample, samplesPerBeat, lastSample, emit);
+                expectedPpq = ppqEnd;
+            }
+
+            sampleClock += numSamples;
+        }
+
+        // Audio thread only. Drops everything still pending.
+        void clear() noexcept;
+
+        size_t getNumPending() const noexcept { return bySample.size() + byBeat.size(); }
+        int64_t getSampleClock() const noexcept { return sampleClock; }
+
+    private:
+        struct Pending
+        {
+            double key = 0;
+            uint64_t sequence = 0;
+            choc::midi::ShortMessage message;
+            NoteExpression expression;
+        };
+
+        // A binary min-heap over storage reserved up front. Ties keep arrival order, so
+        // a note-off queued before a note-on at the same time still goes out first.
+        class FixedHeap
+        {
+        public:
+            void reserve(size_t capacity);
+            bool push(const Pending& p) noexcept;
+            void pop() noexcept;
+            const Pending& top() const noexcept { return items.front(); }
+            bool empty() const noexcept { return items.empty(); }
+            size_t size() const noexcept { return items.size(); }
+            void clear() noexcept { items.clear(); }
+
+            // Drops whatever `keep` turns down, then restores the heap order
+            template <typename KeepFn>
+            void retain(KeepFn&& keep) noexcept
+            {
+                size_t kept = 0;
+
+                for (size_t i = 0; i < items.size(); ++i)
+                    if (keep(items[i]))
+                        items[kept++] = items[i];
+
+                items.resize(kept);
+                std::make_heap(items.begin(), items.end(), Later{});
+            }
+
+        private:
+            struct Later
+            {
+                bool operator()(const Pending& a, const Pending& b) const noexcept
+                {
+                    return a.key > b.key || (a.key == b.key && a.sequence > b.sequence);
+                }
+            };
+
+            std::vector<Pending> items;
+            size_t capacity = 0;
+        };
+
+        static double quantizeUp(double ppq, double grid) noexcept;
+
+        static size_t noteIndex(const choc::midi::ShortMessage& m) noexcept
+        {
+            return static_cast<size_t>(m.getChannel0to15()) * 128 + (m.getNoteNumber() & 0x7F);
+        }
+
+        // Emits the beat-stamped events keyed before ppqEnd, the span from ppq
+        // starting at startSample. Anything keyed earlier (e.g. after the host
+        // relocated) is late rather than lost, so it goes out at startSample.
+        template <typename EmitFn>
+        void emitBeatEvents(const double ppq, const double ppqEnd, const double startSample, const double samplesPerBeat,
+                            const int lastSample, EmitFn& emit) noexcept
+        {
+            const auto firstSample = std::clamp(static_cast<int>(std::floor(startSample)), 0, lastSample);
+
+            while (!byBeat.empty() && byBeat.top().key < ppqEnd)
+            {
+                const auto& e = byBeat.top();
+                const auto offset = static_cast<int>(std::floor(startSample + (e.key - ppq) * samplesPerBeat));
+                emit(std::clamp(offset, firstSample, lastSample), e.message, e.expression);
+                byBeat.pop();
+            }
+        }
+
+        // The transport stopped or went back under beat-stamped notes: note-offs
+        // go out at the offset given, and note-ons still waiting for those notes
+        // never will. Anything else keeps its position.
+        template <typename EmitFn>
+        void releaseBeatNotes(const int offset, EmitFn& emit) noexcept
+        {
+            std::bitset<16 * 128> released;
+
+            byBeat.retain([&](const Pending& p)
+            {
+                if (!p.message.isNoteOff())
+                    return true;
+
+                released.set(noteIndex(p.message));
+                emit(offset, p.message, p.expression);
+                return false;
+            });
+
+            if (released.any())
+                byBeat.retain([&](const Pending& p) { return !p.message.isNoteOn() || !released.test(noteIndex(p.message)); });
+        }
+
+        FixedHeap bySample;
+        FixedHeap byBeat;
+        int64_t sampleClock = 0;
+        uint64_t nextSequence = 0;
+        double expectedPpq = 0; // where the next block should start if the host plays on
+        bool hadGrid = false;
+    };
+} // namespace mh
+
+#endif //MIDISCHEDULER_H
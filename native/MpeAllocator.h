@@ -0,0 +1,283 @@
+#ifndef MPEALLOCATOR_H
+#define MPEALLOCATOR_H
+
+#include <choc_MIDI.h>
+
+#include "MidiScheduler.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+namespace mh
+{
+    //==============================================================================
+    // Turns outgoing notes into MPE. Every note gets a member channel of its own,
+    // with its pitch bend and pressure sent on that channel just before the note-on,
+    // so each note of a voiced chord can be bent and pressed independently.
+    //
+    // A lower zone has its master on channel 1 and members from channel 2 up, an
+    // upper zone its master on channel 16 and members from 15 down. Notes sent on
+    // channel 16 go to the upper zone when there is one, everything else to the
+    // lower. Other channel messages go to the zone's master channel, and
+    // polyphonic aftertouch becomes channel pressure on the note's member channel.
+    // Without any zone configured, messages pass through untouched.
+    //
+    // Free member channels are kept in the order they were released and sounding
+    // ones in the order they started, as index linked lists, so allocation takes
+    // the least recently used channel in O(1). With every channel busy the oldest
+    // note is ended and its channel reused.
+    //
+    // Audio thread only; nothing allocates.
+    class MpeAllocator
+    {
+    public:
+        struct Layout
+        {
+            uint8_t lowerMembers = 0; // 0..15, the two zones and their masters share 16 channels
+            uint8_t upperMembers = 0;
+            uint8_t memberBendRange = 48; // semitones, the MPE default
+
+            bool isEnabled() const noexcept { return lowerMembers > 0 || upperMembers > 0; }
+            bool operator==(const Layout&) const = default;
+        };
+
+        static constexpr uint8_t none = 0xFF;
+
+        MpeAllocator() { configureZones({}); }
+
+        const Layout& getLayout() const noexcept { return layout; }
+
+        // Each zone takes its members plus a master channel, the lower zone
+        // first. With 14 or 15 lower members there is no room left for upper ones.
+        static Layout clamp(Layout requested) noexcept
+        {
+            const int lower = std::min<int>(requested.lowerMembers, 15);
+            const int upper = lower == 0 ? std::min<int>(requested.upperMembers, 15)
+                              : lower >= 14 ? 0
+                                            : std::min<int>(requested.upperMembers, 14 - lower);
+
+            return {static_cast<uint8_t>(lower), static_cast<uint8_t>(upper), requested.memberBendRange};
+        }
+
+        // Ends whatever is sounding, then announces the new zones with MPE
+        // Configuration Messages and member pitch bend ranges
+        template <typename EmitFn>
+        void configure(const Layout& newLayout, EmitFn&& emit) noexcept
+        {
+            allNotesOff(emit);
+            configureZones(clamp(newLayout));
+
+            const bool spareChannels = layout.lowerMembers + layout.upperMembers < 15;
+
+            for (auto& zone : zones)
+            {
+                // An empty zone is announced only if its master isn't the other zone's member
+                if (zone.numMembers == 0 && !spareChannels)
+                    continue;
+
+                // RPN 6 on the master channel sets the number of members, 0 removes the zone
+                emitRpn(zone.master, 6, zone.numMembers, emit);
+
+                for (uint8_t i = 0; i < zone.numMembers; ++i)
+                    emitRpn(memberChannel(zone, i), 0, layout.memberBendRange, emit);
+            }
+        }
+
+        // Routes one outgoing message, emitting whatever it becomes
+        template <typename EmitFn>
+        void process(const choc::midi::ShortMessage& message, const NoteExpression& expression, EmitFn&& emit) noexcept
+        {
+            if (!layout.isEnabled() || message.length() == 0 || message.data[0] >= 0xF0)
+            {
+                emit(message);
+                return;
+            }
+
+            auto& zone = zoneFor(message.getChannel0to15());
+
+            if (message.isNoteOn())
+                noteOn(zone, message.getNoteNumber(), message.getVelocity(), expression, emit);
+            else if (message.isNoteOff())
+                noteOff(zone, message, emit);
+            else if (message.isAftertouch())
+            {
+                if (const auto channel = zone.noteChannel[message.getNoteNumber()]; channel != none)
+                    emit(choc::midi::ShortMessage(static_cast<uint8_t>(0xD0 | channel), message.data[2], 0));
+            }
+            else
+                emit(choc::midi::ShortMessage(static_cast<uint8_t>((message.data[0] & 0xF0) | zone.master),
+                                              message.data[1], message.data[2]));
+        }
+
+        template <typename EmitFn>
+        void allNotesOff(EmitFn&& emit) noexcept
+        {
+            for (auto& zone : zones)
+                while (zone.busyHead != none)
+                    release(zone, channels[zone.busyHead].note, 0, emit);
+        }
+
+        // Member channel the note is sounding on, 0 based, or `none`
+        uint8_t getChannelForNote(const bool upperZone, const uint8_t note) const noexcept
+        {
+            return zones[upperZone ? upper : lower].noteChannel[note & 0x7F];
+        }
+
+    private:
+        static constexpr size_t lower = 0, upper = 1;
+
+        struct Channel
+        {
+            uint8_t previous = none;
+            uint8_t next = none;
+            uint8_t note = none;
+        };
+
+        struct Zone
+        {
+            uint8_t master = 0;      // 0 based
+            uint8_t firstMember = 0;
+            int8_t direction = 1;    // members count up from the lower master and down from the upper
+            uint8_t numMembers = 0;
+
+            uint8_t freeHead = none, freeTail = none; // least recently released first
+            uint8_t busyHead = none, busyTail = none; // oldest note first
+            std::array<uint8_t, 128> noteChannel{};
+        };
+
+        static uint8_t memberChannel(const Zone& zone, const uint8_t index) noexcept
+        {
+            return static_cast<uint8_t>(zone.firstMember + zone.direction * index);
+        }
+
+        void configureZones(const Layout& newLayout) noexcept
+        {
+            layout = newLayout;
+            channels = {};
+
+            zones[lower] = Zone{0, 1, 1, layout.lowerMembers};
+            zones[upper] = Zone{15, 14, -1, layout.upperMembers};
+
+            for (auto& zone : zones)
+            {
+                zone.noteChannel.fill(none);
+                for (uint8_t i = 0; i < zone.numMembers; ++i)
+                    append(zone.freeHead, zone.freeTail, memberChannel(zone, i));
+            }
+        }
+
+        Zone& zoneFor(const uint8_t channel0to15) noexcept
+        {
+            if (channel0to15 == 15 && layout.upperMembers > 0)
+                return zones[upper];
+
+            return layout.lowerMembers > 0 ? zones[lower] : zones[upper];
+        }
+
+        //==============================================================================
+        void append(uint8_t& head, uint8_t& tail, const uint8_t channel) noexcept
+        {
+            channels[channel].previous = tail;
+            channels[channel].next = none;
+
+            if (tail != none)
+                channels[tail].next = channel;
+            else
+                head = channel;
+
+            tail = channel;
+        }
+
+        void unlink(uint8_t& head, uint8_t& tail, const uint8_t channel) noexcept
+        {
+            auto& c = channels[channel];
+
+            if (c.previous != none)
+                channels[c.previous].next = c.next;
+            else
+                head = c.next;
+
+            if (c.next != none)
+                channels[c.next].previous = c.previous;
+            else
+                tail = c.previous;
+
+            c.previous = c.next = none;
+        }
+
+        template <typename EmitFn>
+        void noteOn(Zone& zone, const uint8_t note, const uint8_t velocity, const NoteExpression& expression, EmitFn& emit) noexcept
+        {
+            // A retriggered note ends the one already sounding
+            if (zone.noteChannel[note] != none)
+                release(zone, note, 0, emit);
+
+            // Steal the oldest note when every member is busy
+            if (zone.freeHead == none && zone.busyHead != none)
+                release(zone, channels[zone.busyHead].note, 0, emit);
+
+            const auto channel = zone.freeHead;
+
+            if (channel == none)
+                return;
+
+            unlink(zone.freeHead, zone.freeTail, channel);
+            append(zone.busyHead, zone.busyTail, channel);
+            channels[channel].note = note;
+            zone.noteChannel[note] = channel;
+
+            // Expression goes first so the note starts with it
+            const auto range = std::max<double>(1, layout.memberBendRange);
+            const auto bend = std::clamp(static_cast<int>(std::lround(8192.0 + expression.pitchBend / range * 8192.0)), 0, 16383);
+            const auto pressure = std::clamp(static_cast<int>(std::lround(expression.pressure * 127.0f)), 0, 127);
+
+            emit(choc::midi::ShortMessage(static_cast<uint8_t>(0xE0 | channel), static_cast<uint8_t>(bend & 0x7F),
+                                          static_cast<uint8_t>(bend >> 7)));
+            emit(choc::midi::ShortMessage(static_cast<uint8_t>(0xD0 | channel), static_cast<uint8_t>(pressure), 0));
+            emit(choc::midi::ShortMessage(static_cast<uint8_t>(0x90 | channel), note, velocity));
+        }
+
+        template <typename EmitFn>
+        void noteOff(Zone& zone, const choc::midi::ShortMessage& message, EmitFn& emit) noexcept
+        {
+            // A note the zones never placed, held from before MPE was switched
+            // on or already stolen, is ended on the channel it was sent to
+            if (const auto note = message.getNoteNumber(); zone.noteChannel[note] != none)
+                release(zone, note, message.getVelocity(), emit);
+            else
+                emit(message);
+        }
+
+        template <typename EmitFn>
+        void release(Zone& zone, const uint8_t note, const uint8_t velocity, EmitFn& emit) noexcept
+        {
+            const auto channel = zone.noteChannel[note];
+            emit(choc::midi::ShortMessage(static_cast<uint8_t>(0x80 | channel), note, velocity));
+
+            unlink(zone.busyHead, zone.busyTail, channel);
+            append(zone.freeHead, zone.freeTail, channel);
+            channels[channel].note = none;
+            zone.noteChannel[note] = none;
+        }
+
+        template <typename EmitFn>
+        static void emitRpn(const uint8_t channel, const uint8_t rpn, const uint8_t value, EmitFn& emit) noexcept
+        {
+            const auto cc = static_cast<uint8_t>(0xB0 | channel);
+            emit(choc::midi::ShortMessage(cc, 101, 0));
+            emit(choc::midi::ShortMessage(cc, 100, rpn));
+            emit(choc::midi::ShortMessage(cc, 6, value));
+            emit(choc::midi::ShortMessage(cc, 38, 0));
+            emit(choc::midi::ShortMessage(cc, 101, 127));
+            emit(choc::midi::ShortMessage(cc, 100, 127));
+        }
+
+        Layout layout;
+        std::array<Zone, 2> zones;
+        std::array<Channel, 16> channels{};
+    };
+} // namespace mh
+
+#endif //MPEALLOCATOR_H
@@ -0,0 +1,166 @@
+#ifndef PARAMNODE_H
+#define PARAMNODE_H
+
+#include <elem/GraphNode.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <string>
+
+namespace mh
+{
+    //==============================================================================
+    // Plain-value mirror of the host parameters, written wherever the host tells us
+    // about a change (often the audio thread) and read by ParamNodes every block.
+    // Slots are added while constructing the processor and never after.
+    class ParamBindings
+    {
+    public:
+        void add(const std::string& paramId, float initialValue)
+        {
+            auto& slot = slots.emplace_back();
+            slot.paramId = paramId;
+            slot.value.store(initialValue, std::memory_order_relaxed);
+        }
+
+        int indexOf(const std::string& paramId) const
+        {
+            for (size_t i = 0; i < slots.size(); ++i)
+                if (slots[i].paramId == paramId)
+                    return static_cast<int>(i);
+
+            return -1;
+        }
+
+        void set(size_t index, float value) noexcept
+        {
+            if (index < slots.size())
+                slots[index].value.store(value, std::memory_order_relaxed);
+        }
+
+        float get(size_t index) const noexcept
+        {
+            return index < slots.size() ? slots[index].value.load(std::memory_order_relaxed) : 0.0f;
+        }
+
+        // A parameter counts as bound while at least one ParamNode in the live graph
+        // reads it. Changes to bound parameters need no JS round trip.
+        void retain(int index) noexcept
+        {
+            if (index >= 0 && static_cast<size_t>(index) < slots.size())
+                slots[static_cast<size_t>(index)].bindCount.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void release(int index) noexcept
+        {
+            if (index >= 0 && static_cast<size_t>(index) < slots.size())
+                slots[static_cast<size_t>(index)].bindCount.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        bool isBound(size_t index) const noexcept
+        {
+            return index < slots.size() && slots[index].bindCount.load(std::memory_order_relaxed) > 0;
+        }
+
+        size_t size() const noexcept { return slots.size(); }
+
+    private:
+        struct Slot
+        {
+            std::string paramId;
+            std::atomic<float> value{0.0f};
+            std::atomic<int> bindCount{0};
+        };
+
+        std::deque<Slot> slots;
+    };
+
+    //==============================================================================
+    // `mh::param` node: outputs the current value of a host parameter, with optional
+    // one-pole smoothing. Render it from JS once, with props
+    //
+    //   { paramId: "gain", smoothMs: 20 }
+    //
+    // and host automation reaches the runtime directly on every block.
+    template <typename FloatType>
+    struct ParamNode : public elem::GraphNode<FloatType>
+    {
+        ParamNode(elem::NodeId id, double const sr, int const blockSize, ParamBindings& b)
+            : elem::GraphNode<FloatType>(id, sr, blockSize), bindings(b)
+        {
+        }
+
+        ~ParamNode() override
+        {
+            bindings.release(paramIndex.load());
+        }
+
+        int setProperty(std::string const& key, elem::js::Value const& val) override
+        {
+            if (key == "paramId")
+            {
+                if (!val.isString())
+                    return elem::ReturnCode::InvalidPropertyType();
+
+                const auto index = bindings.indexOf(static_cast<elem::js::String>(val));
+
+                if (index < 0)
+                    return elem::ReturnCode::InvalidPropertyValue();
+
+                bindings.retain(index);
+                bindings.release(paramIndex.exchange(index));
+            }
+
+            if (key == "smoothMs")
+            {
+                if (!val.isNumber())
+                    return elem::ReturnCode::InvalidPropertyType();
+
+                const auto smoothSamples = static_cast<double>(val) * 0.001 * elem::GraphNode<FloatType>::getSampleRate();
+                smoothingCoeff.store(smoothSamples > 1.0 ? 1.0 - std::exp(-1.0 / smoothSamples) : 0.0);
+            }
+
+            return elem::GraphNode<FloatType>::setProperty(key, val);
+        }
+
+        void process(elem::BlockContext<FloatType> const& ctx) override
+        {
+            auto* outputData = ctx.outputData;
+            auto const numSamples = ctx.numSamples;
+            auto const index = paramIndex.load(std::memory_order_relaxed);
+
+            if (index < 0)
+            {
+                std::fill_n(outputData, numSamples, FloatType(0));
+                return;
+            }
+
+            auto const target = static_cast<FloatType>(bindings.get(static_cast<size_t>(index)));
+            auto const coeff = static_cast<FloatType>(smoothingCoeff.load(std::memory_order_relaxed));
+
+            if (coeff <= FloatType(0) || !primed)
+            {
+                current = target;
+                primed = true;
+                std::fill_n(outputData, numSamples, current);
+                return;
+            }
+
+            for (size_t i = 0; i < numSamples; ++i)
+            {
+                current += (target - current) * coeff;
+                outputData[i] = current;
+            }
+        }
+
+        ParamBindings& bindings;
+        std::atomic<int> paramIndex{-1};
+        std::atomic<double> smoothingCoeff{0.0};
+        FloatType current = 0;
+        bool primed = false;
+    };
+} // namespace mh
+
+#endif //PARAMNODE_H
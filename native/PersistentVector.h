@@ -0,0 +1,413 @@
+#ifndef PERSISTENTVECTOR_H
+#define PERSISTENTVECTOR_H
+
+#include <juce_core/juce_core.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mh
+{
+    //==============================================================================
+    // An immutable vector with structural sharing: a 32-way trie of shared, never
+    // mutated nodes plus a tail block for cheap appends. Every "modifying" call
+    // returns a new vector sharing all untouched nodes with the old one, so copies
+    // are O(1) and push_back / set / get are O(log32 n).
+    template <typename T>
+    class PersistentVector
+    {
+        static constexpr unsigned bits = 5;
+        static constexpr size_t width = size_t(1) << bits;
+        static constexpr size_t mask = width - 1;
+
+        struct Node
+        {
+            std::vector<std::shared_ptr<const Node>> children; // branch nodes
+            std::vector<T> values;                              // leaf nodes
+        };
+
+        using NodePtr = std::shared_ptr<const Node>;
+
+    public:
+        PersistentVector()
+            : root(emptyNode()), tail(emptyNode())
+        {
+        }
+
+        size_t size() const noexcept { return count; }
+        bool empty() const noexcept { return count == 0; }
+
+        const T& operator[](size_t index) const { return leafFor(index).values[index & mask]; }
+
+        PersistentVector push_back(T value) const
+        {
+            PersistentVector result(*this);
+
+            // Room in the tail, copy at most one block
+            if (count - tailOffset() < width)
+            {
+                auto newTail = std::make_shared<Node>(*tail);
+                newTail->values.push_back(std::move(value));
+                result.tail = std::move(newTail);
+                ++result.count;
+                return result;
+            }
+
+            // The tail is full: push it into the trie, growing a level if the root is full
+            if ((count >> bits) > (size_t(1) << shift))
+            {
+                auto newRoot = std::make_shared<Node>();
+                newRoot->children.push_back(root);
+                newRoot->children.push_back(newPath(shift, tail));
+                result.root = std::move(newRoot);
+                result.shift = shift + bits;
+            }
+            else
+            {
+                result.root = pushTail(shift, root, tail);
+            }
+
+            auto newTail = std::make_shared<Node>();
+            newTail->values.reserve(width);
+            newTail->values.push_back(std::move(value));
+            result.tail = std::move(newTail);
+            ++result.count;
+            return result;
+        }
+
+        PersistentVector set(size_t index, T value) const
+        {
+            jassert(index < count);
+            PersistentVector result(*this);
+
+            if (index >= tailOffset())
+            {
+                auto newTail = std::make_shared<Node>(*tail);
+                newTail->values[index & mask] = std::move(value);
+                result.tail = std::move(newTail);
+            }
+            else
+            {
+                result.root = assoc(shift, root, index, std::move(value));
+            }
+
+            return result;
+        }
+
+        template <typename Fn>
+        void forEach(Fn&& fn) const
+        {
+            for (size_t i = 0; i < count; i += width)
+            {
+                const auto& leaf = leafFor(i);
+                for (const auto& v : leaf.values)
+                    fn(v);
+            }
+        }
+
+        std::vector<T> toVector() const
+        {
+            std::vector<T> out;
+            out.reserve(count);
+            forEach([&out](const T& v) { out.push_back(v); });
+            return out;
+        }
+
+        // Calls onChanged(begin, end) for each run of indices whose values differ
+        // between the two vectors, including anything past the end of the shorter one.
+        // Subtrees shared by both are skipped by pointer, so the cost follows the
+        // size of the difference rather than the size of the vectors.
+        template <typename RangeFn>
+        static void diff(const PersistentVector& a, const PersistentVector& b, RangeFn&& onChanged)
+        {
+            RangeCollector<RangeFn> ranges{onChanged};
+            const auto minCount = std::min(a.count, b.count);
+            const auto limit = std::min(a.tailOffset(), b.tailOffset());
+
+            if (limit > 0)
+            {
+                // Bring both roots to the same height. Tries are left packed, so the
+                // shorter one lines up with the leftmost spine of the taller one.
+                auto nodeA = a.root;
+                auto nodeB = b.root;
+                auto levelA = a.shift;
+                auto levelB = b.shift;
+
+                for (; levelA > levelB; levelA -= bits) nodeA = nodeA->children.front();
+                for (; levelB > levelA; levelB -= bits) nodeB = nodeB->children.front();
+
+                compareNodes(nodeA, nodeB, levelA, 0, limit, ranges);
+            }
+
+            // At most one tail's worth of elements lies between the trie and the end of
+            // the shorter vector
+            for (auto i = limit; i < minCount; ++i)
+                if (!(a[i] == b[i]))
+                    ranges.add(i, i + 1);
+
+            if (a.count != b.count)
+                ranges.add(minCount, std::max(a.count, b.count));
+
+            ranges.flush();
+        }
+
+        bool sharesStructureWith(const PersistentVector& other) const noexcept
+        {
+            return root == other.root && tail == other.tail && count == other.count;
+        }
+
+    private:
+        template <typename RangeFn>
+        struct RangeCollector
+        {
+            RangeFn& fn;
+            size_t begin = 0, end = 0;
+            bool open = false;
+
+            void add(size_t b, size_t e)
+            {
+                if (open && b == end)
+                {
+                    end = e;
+                    return;
+                }
+
+                flush();
+                begin = b;
+                end = e;
+                open = true;
+            }
+
+            void flush()
+            {
+                if (open)
+                    fn(begin, end);
+                open = false;
+            }
+        };
+
+        static NodePtr emptyNode()
+        {
+            static const NodePtr empty = std::make_shared<Node>();
+            return empty;
+        }
+
+        size_t tailOffset() const noexcept
+        {
+            return count < width ? 0 : ((count - 1) >> bits) << bits;
+        }
+
+        const Node& leafFor(size_t index) const
+        {
+            jassert(index < count);
+
+            if (index >= tailOffset())
+                return *tail;
+
+            const Node* node = root.get();
+            for (auto level = shift; level > 0; level -= bits)
+                node = node->children[(index >> level) & mask].get();
+
+            return *node;
+        }
+
+        NodePtr pushTail(unsigned level, const NodePtr& parent, const NodePtr& tailNode) const
+        {
+            const auto subIndex = ((count - 1) >> level) & mask;
+            auto result = std::make_shared<Node>(*parent);
+
+            NodePtr toInsert;
+            if (level == bits)
+                toInsert = tailNode;
+            else if (subIndex < parent->children.size())
+                toInsert = pushTail(level - bits, parent->children[subIndex], tailNode);
+            else
+                toInsert = newPath(level - bits, tailNode);
+
+            if (subIndex < result->children.size())
+                result->children[subIndex] = std::move(toInsert);
+            else
+                result->children.push_back(std::move(toInsert));
+
+            return result;
+        }
+
+        static NodePtr newPath(unsigned level, const NodePtr& node)
+        {
+            if (level == 0)
+                return node;
+
+            auto result = std::make_shared<Node>();
+            result->children.push_back(newPath(level - bits, node));
+            return result;
+        }
+
+        static NodePtr assoc(unsigned level, const NodePtr& node, size_t index, T value)
+        {
+            auto result = std::make_shared<Node>(*node);
+
+            if (level == 0)
+            {
+                result->values[index & mask] = std::move(value);
+            }
+            else
+            {
+                const auto subIndex = (index >> level) & mask;
+                result->children[subIndex] = assoc(level - bits, node->children[subIndex], index, std::move(value));
+            }
+
+            return result;
+        }
+
+        template <typename Collector>
+        static void compareNodes(const NodePtr& a, const NodePtr& b, unsigned level, size_t base, size_t limit,
+                                 Collector& ranges)
+        {
+            if (a == b)
+                return;
+
+            if (level == 0)
+            {
+                const auto n = std::min({a->values.size(), b->values.size(), limit - base});
+                for (size_t i = 0; i < n; ++i)
+                    if (!(a->values[i] == b->values[i]))
+                        ranges.add(base + i, base + i + 1);
+                return;
+            }
+
+            const auto n = std::min(a->children.size(), b->children.size());
+            for (size_t c = 0; c < n; ++c)
+            {
+                const auto childBase = base + (c << level);
+                if (childBase >= limit)
+                    break;
+
+                compareNodes(a->children[c], b->children[c], level - bits, childBase, limit, ranges);
+            }
+        }
+
+        NodePtr root;
+        NodePtr tail;
+        size_t count = 0;
+        unsigned shift = bits;
+    };
+
+    //==============================================================================
+    // A branching undo history of PersistentVector versions. Each commit records
+    // only a handle to the new vector, so unlimited history costs O(log n) new
+    // nodes per edit rather than a full copy. Undo moves to the parent version,
+    // redo to the most recent child, and checkout jumps to any version, which is
+    // how "what-if" branches are started.
+    //
+    // All editing happens on one thread. Other threads read the head through
+    // getSnapshot(), which only copies a shared_ptr under a spin lock; the writer
+    // builds each new version before taking that lock to publish it.
+    template <typename T>
+    class VersionHistory
+    {
+    public:
+        struct Snapshot
+        {
+            uint32_t version = 0;
+            PersistentVector<T> data;
+        };
+
+        VersionHistory()
+        {
+            versions.push_back({-1, -1, {}, "initial"});
+            publish();
+        }
+
+        const PersistentVector<T>& head() const noexcept { return versions[current].data; }
+        uint32_t getCurrentVersion() const noexcept { return current; }
+        size_t getNumVersions() const noexcept { return versions.size(); }
+
+        uint32_t commit(PersistentVector<T> next, std::string label = {})
+        {
+            const auto id = static_cast<uint32_t>(versions.size());
+            versions.push_back({static_cast<int32_t>(current), -1, std::move(next), std::move(label)});
+            versions[current].lastChild = static_cast<int32_t>(id);
+            current = id;
+            publish();
+            return id;
+        }
+
+        bool canUndo() const noexcept { return versions[current].parent >= 0; }
+        bool canRedo() const noexcept { return versions[current].lastChild >= 0; }
+
+        bool undo()
+        {
+            if (!canUndo())
+                return false;
+
+            const auto from = current;
+            current = static_cast<uint32_t>(versions[current].parent);
+            versions[current].lastChild = static_cast<int32_t>(from);
+            publish();
+            return true;
+        }
+
+        bool redo()
+        {
+            if (!canRedo())
+                return false;
+
+            current = static_cast<uint32_t>(versions[current].lastChild);
+            publish();
+            return true;
+        }
+
+        bool checkout(uint32_t version)
+        {
+            if (version >= versions.size())
+                return false;
+
+            current = version;
+            publish();
+            return true;
+        }
+
+        int32_t getParentOf(uint32_t version) const noexcept
+        {
+            return version < versions.size() ? versions[version].parent : -1;
+        }
+
+        const PersistentVector<T>* get(uint32_t version) const noexcept
+        {
+            return version < versions.size() ? &versions[version].data : nullptr;
+        }
+
+        std::shared_ptr<const Snapshot> getSnapshot() const
+        {
+            const juce::SpinLock::ScopedLockType lock(snapshotLock);
+            return snapshot;
+        }
+
+    private:
+        struct Version
+        {
+            int32_t parent = -1;
+            int32_t lastChild = -1;
+            PersistentVector<T> data;
+            std::string label;
+        };
+
+        void publish()
+        {
+            auto next = std::make_shared<const Snapshot>(Snapshot{current, versions[current].data});
+            const juce::SpinLock::ScopedLockType lock(snapshotLock);
+            snapshot.swap(next);
+        }
+
+        std::vector<Version> versions;
+        uint32_t current = 0;
+
+        mutable juce::SpinLock snapshotLock;
+        std::shared_ptr<const Snapshot> snapshot;
+    };
+} // namespace mh
+
+#endif //PERSISTENTVECTOR_H
@@ -2,18 +2,337 @@
 #include "PluginProcessor.h"
 #include "WebViewEditor.h"
 
-#include <choc_javascript_QuickJS.h>
+#include <chrono>
 
 #include "Helpers.h"
+#include "InstructionBatch.h"
 
+//==============================================================================
+// Moves recorded audio thread frames to disk while a session is being recorded
+struct MindfulMIDI::TraceDrain final : juce::Timer
+{
+    explicit TraceDrain(mh::trace::Recorder& r)
+        : recorder(r)
+    {
+        startTimerHz(10);
+    }
+
+    ~TraceDrain() override { stopTimer(); }
+
+    void timerCallback() override { recorder.drain(); }
+
+    mh::trace::Recorder& recorder;
+};
+
+struct MindfulMIDI::StatsReporter final : juce::Timer
+{
+    explicit StatsReporter(MindfulMIDI& p)
+        : processor(p)
+    {
+        startTimerHz(1);
+    }
+
+    ~StatsReporter() override { stopTimer(); }
+
+    void timerCallback() override { processor.dispatchStats(); }
+
+    MindfulMIDI& processor;
+};
+
+namespace
+{
+    std::atomic<uint32_t> nextInstanceId{1};
+
+    // Top bit marks a request, so an all zero layout can still be asked for
+    constexpr uint32_t mpeRequestPending = 1u << 31;
+
+    uint32_t packMpeLayout(const mh::MpeAllocator::Layout& layout)
+    {
+        return mpeRequestPending | static_cast<uint32_t>(layout.lowerMembers) << 16
+               | static_cast<uint32_t>(layout.upperMembers) << 8 | layout.memberBendRange;
+    }
+
+    mh::MpeAllocator::Layout unpackMpeLayout(const uint32_t packed)
+    {
+        return {static_cast<uint8_t>(packed >> 16), static_cast<uint8_t>(packed >> 8), static_cast<uint8_t>(packed)};
+    }
+
+    mh::MpeAllocator::Layout mpeLayoutFromJs(const elem::js::Value& v)
+    {
+        const auto number = [&v](const char* key, const elem::js::Number fallback)
+        {
+            return static_cast<int>(v.isObject() ? v.getWithDefault(key, fallback) : fallback);
+        };
+
+        return mh::MpeAllocator::clamp({static_cast<uint8_t>(std::clamp(number("lowerMembers", 0), 0, 15)),
+                                        static_cast<uint8_t>(std::clamp(number("upperMembers", 0), 0, 15)),
+                                        static_cast<uint8_t>(std::clamp(number("bendRange", 48), 1, 96))});
+    }
+
+    elem::js::Object mpeLayoutToJs(const mh::MpeAllocator::Layout& layout)
+    {
+        elem::js::Object o;
+        o.insert_or_assign("lowerMembers", static_cast<elem::js::Number>(layout.lowerMembers));
+        o.insert_or_assign("upperMembers", static_cast<elem::js::Number>(layout.upperMembers));
+        o.insert_or_assign("bendRange", static_cast<elem::js::Number>(layout.memberBendRange));
+        return o;
+    }
+
+    // Message types are named in a list, or given as the raw mask. Anything
+    // left out keeps its current setting.
+    mh::MidiInputFilter::Settings midiInputSettingsFromJs(const elem::js::Value& v, mh::MidiInputFilter::Settings settings)
+    {
+        if (!v.isObject())
+            return settings;
+
+        const auto& o = v.getObject();
+
+        if (const auto drop = o.find("drop"); drop != o.end() && drop->second.isArray())
+        {
+            settings.dropMask = 0;
+            for (const auto& name : drop->second.getArray())
+                if (name.isString())
+                    settings.dropMask |= mh::MidiInputFilter::bitFor(static_cast<elem::js::String>(name));
+        }
+        else
+        {
+            settings.dropMask = static_cast<uint32_t>(v.getWithDefault("dropMask", static_cast<elem::js::Number>(settings.dropMask)));
+        }
+
+        settings.coalesce = v.getWithDefault("coalesce", settings.coalesce);
+        settings.maxRateHz = std::clamp(static_cast<float>(v.getWithDefault("maxRate", static_cast<elem::js::Number>(settings.maxRateHz))),
+                                        0.0f, 1000.0f);
+
+        return settings;
+    }
+
+    // Sinks are named in a list, categories switched on or off by name, and
+    // anything left out keeps its current setting
+    mh::logging::LogDrain::Settings logSettingsFromJs(const elem::js::Value& v, mh::logging::LogDrain::Settings settings)
+    {
+        using mh::logging::LogDrain;
+
+        if (!v.isObject())
+            return settings;
+
+        const auto& o = v.getObject();
+
+        if (const auto level = o.find("level"); level != o.end() && level->second.isString())
+            mh::logging::fromString(static_cast<elem::js::String>(level->second), settings.level);
+
+        if (const auto categories = o.find("categories"); categories != o.end() && categories->second.isObject())
+        {
+            for (const auto& [name, enabled] : categories->second.getObject())
+            {
+                mh::logging::Category category;
+
+                if (!enabled.isBool() || !mh::logging::fromString(name, category))
+                    continue;
+
+                const auto bit = 1u << static_cast<uint32_t>(category);
+                settings.categoryMask = static_cast<bool>(enabled) ? settings.categoryMask | bit : settings.categoryMask & ~bit;
+            }
+        }
+
+        if (const auto sinks = o.find("sinks"); sinks != o.end() && sinks->second.isArray())
+        {
+            settings.sinks = 0;
+            for (const auto& name : sinks->second.getArray())
+            {
+                if (!name.isString())
+                    continue;
+
+                const auto sink = static_cast<elem::js::String>(name);
+
+                if (sink == "editor")
+                    settings.sinks |= LogDrain::editorConsole;
+                else if (sink == "stdout")
+                    settings.sinks |= LogDrain::standardOut;
+                else if (sink == "file")
+                    settings.sinks |= LogDrain::rotatingFile;
+            }
+        }
+
+        settings.ticksPerSecond = std::clamp(static_cast<int>(v.getWithDefault("rate", static_cast<elem::js::Number>(settings.ticksPerSecond))), 1, 100);
+        settings.entriesPerTick = static_cast<size_t>(std::clamp(v.getWithDefault("batch", static_cast<elem::js::Number>(settings.entriesPerTick)), 16.0, 4096.0));
+        settings.maxFileBytes = static_cast<int64_t>(std::clamp(v.getWithDefault("maxFileBytes", static_cast<elem::js::Number>(settings.maxFileBytes)), 4096.0, 1.0e9));
+        settings.maxFiles = std::clamp(static_cast<int>(v.getWithDefault("maxFiles", static_cast<elem::js::Number>(settings.maxFiles))), 1, 32);
+
+        return settings;
+    }
+
+    elem::js::Object logSettingsToJs(const mh::logging::LogDrain::Settings& settings)
+    {
+        using mh::logging::LogDrain;
+
+        elem::js::Object categories;
+        for (uint8_t i = 0; i < static_cast<uint8_t>(mh::logging::Category::numCategories); ++i)
+            categories.insert_or_assign(mh::logging::toString(static_cast<mh::logging::Category>(i)),
+                                        (settings.categoryMask & (1u << i)) != 0);
+
+        elem::js::Array sinks;
+        if ((settings.sinks & LogDrain::editorConsole) != 0) sinks.push_back(elem::js::String("editor"));
+        if ((settings.sinks & LogDrain::standardOut) != 0) sinks.push_back(elem::js::String("stdout"));
+        if ((settings.sinks & LogDrain::rotatingFile) != 0) sinks.push_back(elem::js::String("file"));
+
+        elem::js::Object o;
+        o.insert_or_assign("level", elem::js::String(mh::logging::toString(settings.level)));
+        o.insert_or_assign("categories", categories);
+        o.insert_or_assign("sinks", sinks);
+        o.insert_or_assign("rate", static_cast<elem::js::Number>(settings.ticksPerSecond));
+        o.insert_or_assign("batch", static_cast<elem::js::Number>(settings.entriesPerTick));
+        o.insert_or_assign("maxFileBytes", static_cast<elem::js::Number>(settings.maxFileBytes));
+        o.insert_or_assign("maxFiles", static_cast<elem::js::Number>(settings.maxFiles));
+        return o;
+    }
+
+    mh::ProgressionPlayer::Options playbackOptionsFromJs(const elem::js::Value& options)
+    {
+        const auto number = [&options](const char* key, const elem::js::Number fallback)
+        {
+            return options.isObject() ? options.getWithDefault(key, fallback) : fallback;
+        };
+
+        const auto array = [&options](const char* key)
+        {
+            return options.isObject() ? options.getWithDefault(key, elem::js::Array()) : elem::js::Array();
+        };
+
+        mh::ProgressionPlayer::Options o;
+        o.from = static_cast<size_t>(std::max(0.0, number("from", 0)));
+
+        if (const auto to = number("to", -1); to >= 0)
+            o.to = static_cast<size_t>(to);
+
+        for (const auto& d : array("durations"))
+            if (d.isNumber())
+                o.durations.push_back(static_cast<elem::js::Number>(d));
+
+        for (const auto& v : array("voicings"))
+        {
+            if (!v.isObject())
+                continue;
+
+            o.voicings.push_back({static_cast<int8_t>(std::clamp(static_cast<int>(v.getWithDefault("inversion", 0.0)), -8, 8)),
+                                  static_cast<int8_t>(std::clamp(static_cast<int>(v.getWithDefault("octave", 0.0)), -4, 4))});
+        }
+
+        for (const auto& v : array("velocities"))
+            if (v.isNumber())
+                o.velocities.push_back(static_cast<uint8_t>(std::clamp(static_cast<int>(static_cast<elem::js::Number>(v)), 1, 127)));
+
+        o.gate = number("gate", o.gate);
+        o.loop = options.isObject() ? options.getWithDefault("loop", true) : true;
+        o.alignBeats = number("align", o.alignBeats);
+        o.channel = static_cast<uint8_t>(std::clamp(static_cast<int>(number("channel", 1)), 1, 16) - 1);
+        return o;
+    }
+
+    elem::js::Object midiInputSettingsToJs(const mh::MidiInputFilter::Settings& settings)
+    {
+        elem::js::Object o;
+        o.insert_or_assign("dropMask", static_cast<elem::js::Number>(settings.dropMask));
+        o.insert_or_assign("coalesce", settings.coalesce);
+        o.insert_or_assign("maxRate", static_cast<elem::js::Number>(settings.maxRateHz));
+        return o;
+    }
+
+    // Supplies the recorded host transport to a replayed block
+    struct ReplayPlayHead final : juce::AudioPlayHead
+    {
+        juce::Optional<PositionInfo> getPosition() const override
+        {
+            PositionInfo info;
+            info.setIsPlaying(transport.isPlaying);
+            info.setBpm(transport.bpm);
+
+            if (transport.hasPpq)
+                info.setPpqPosition(transport.ppqPosition);
+
+            return info;
+        }
+
+        mh::MidiScheduler::Transport transport;
+    };
+
+    struct StageTiming
+    {
+        double totalMicros = 0;
+        double maxMicros = 0;
+        uint64_t count = 0;
+
+        template <typename Fn>
+        void measure(Fn&& fn)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            fn();
+            const auto micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            totalMicros += micros;
+            maxMicros = std::max(maxMicros, micros);
+            ++count;
+        }
+
+        elem::js::Object toJs() const
+        {
+            elem::js::Object o;
+            o.insert_or_assign("count", static_cast<elem::js::Number>(count));
+            o.insert_or_assign("totalMs", totalMicros * 0.001);
+            o.insert_or_assign("meanUs", count > 0 ? totalMicros / static_cast<double>(count) : 0.0);
+            o.insert_or_assign("maxUs", maxMicros);
+            return o;
+        }
+    };
+
+    std::string describeEvents(const std::vector<mh::trace::MidiEvent>& events)
+    {
+        std::string text;
+        for (const auto& e : events)
+        {
+            if (!text.empty())
+                text += ", ";
+            text += juce::String::toHexString(e.bytes.data(), static_cast<int>(e.bytes.size())).toStdString();
+            text += " @" + std::to_string(e.offset);
+        }
+        return text;
+    }
+}
 
 //==============================================================================
 MindfulMIDI::MindfulMIDI()
     : AudioProcessor(BusesProperties()
                      .withInput("Input", juce::AudioChannelSet::stereo(), true)
                      .withOutput("Output", juce::AudioChannelSet::stereo(), true))
-      , jsEngine(choc::javascript::createQuickJSContext())
+      , instanceId(nextInstanceId.fetch_add(1))
+      , jsEngine(quickJS.createContext())
 {
+    // QuickJS polls this while a script runs, and aborts the script when it returns true.
+    // The handler stays with quickJS across every context it creates.
+    quickJS.setInterruptHandler([](void* watchdog)
+    {
+        return static_cast<mh::ScriptWatchdog*>(watchdog)->shouldInterrupt();
+    }, &scriptWatchdog);
+
+    // Chord changes are rare next to notes, and this FIFO lives as long as the
+    // processor so the audio thread can always publish to it
+    chord_fifo_queue.reset(64);
+    retiredRuntimes.reset(4);
+
+    dispatchScheduler->add(*this);
+
+    statsReporter = std::make_unique<StatsReporter>(*this);
+
+    // Log entries are written lock-free from any thread and drained here on the
+    // message thread in batches, to the editor console when open and to the log file.
+    logDrain = std::make_unique<mh::logging::LogDrain>(logger, [this](const std::vector<std::string>& lines)
+    {
+        return dispatchLogBatchToUI(lines);
+    });
+    logDrain->configure({}, mh::util::getUserDataDirectory().getChildFile(staticNames::LOG_DIRECTORY));
+
+    // Only the bank's index is read here, so hosts can list its programs
+    if (programBank.open(mh::util::getUserDataDirectory().getChildFile(staticNames::PROGRAM_BANK_FILE_NAME)))
+        resetDecodedPrograms();
+
     // Initialize parameters from the manifest file
 #if ELEM_DEV_LOCALHOST
     auto manifestFile = juce::URL("http://localhost:5173/manifest.json");
@@ -54,6 +373,9 @@ MindfulMIDI::MindfulMIDI()
 
         p->addListener(this);
         addParameter(p);
+        parameterMap.insert_or_assign(paramId, p);
+        floatParams.push_back(p);
+        paramBindings.add(paramId, static_cast<float>(defValue));
 
         // Push a new ParameterReadout onto the list to represent this parameter
         paramReadouts.emplace_back(ParameterReadout{static_cast<float>(defValue), false});
@@ -69,6 +391,19 @@ MindfulMIDI::MindfulMIDI()
 
 MindfulMIDI::~MindfulMIDI()
 {
+    dispatchScheduler->remove(*this);
+
+    // Any MIDI file, voicing or program job still running references this instance,
+    // so they are told to exit and waited for however long that takes. The file
+    // and voicing jobs stop early when asked, and programs decode quickly.
+    fileWorkers.removeAllJobs(true, -1);
+    voicingWorkers.removeAllJobs(true, -1);
+    programWorkers.removeAllJobs(true, -1);
+
+    handleStopRecording();
+    statsReporter.reset();
+    statsDump.reset();
+
     for (auto& p : getParameters())
     {
         p->removeListener(this);
@@ -80,19 +415,210 @@ juce::AudioProcessorEditor* MindfulMIDI::createEditor()
 {
     editor = new WebViewEditor(this, mh::util::getAssetsDirectory(), 800, 500);
 
-    editor->setMidiOut = [this](const std::string& message, const int index)
+    // Incoming MIDI and log lines queued for the view go out as one script per flush
+    editor->getDispatchQueue().setBatchEncoder(mh::ViewDispatchQueue::Batch::midi,
+        [](const std::vector<std::string>& hexMessages)
+        {
+            elem::js::Array vec;
+            for (const auto& hex : hexMessages)
+                vec.push_back(elem::js::Value(hex));
+
+            // Need the double serialize here to correctly form the string script. The first
+            // serialize produces the payload we want, the second serialize ensures we can replace
+            // the % character in the above script block and produce a valid javascript expression.
+            return juce::String(jsFunctions::midi2jsScript).replace("%", elem::js::serialize(
+                                                                        elem::js::serialize(elem::js::serialize(vec)))).
+                                                            toStdString();
+        }, 256);
+
+    editor->getDispatchQueue().setBatchEncoder(mh::ViewDispatchQueue::Batch::log,
+        [](const std::vector<std::string>& lines)
+        {
+            auto wrappedLines = choc::value::createEmptyArray();
+            for (const auto& line : lines)
+                wrappedLines.addArrayElement(line);
+
+            return serialize(jsFunctions::logBatchToViewScript, wrappedLines, "%");
+        }, 512);
+
+    // State changing messages go through handleBridgeMessage, see there
+    editor->setMidiOut = [this](const std::string& message, const mh::MidiScheduler::Timing& timing,
+                                const mh::NoteExpression& expression)
     {
-        handleMidiOut(message, index);
+        elem::js::Object args;
+        args.insert_or_assign("message", message);
+        args.insert_or_assign("timeBase", static_cast<elem::js::Number>(timing.base));
+        args.insert_or_assign("time", timing.time);
+        args.insert_or_assign("quantize", timing.quantizeBeats);
+        args.insert_or_assign("bend", static_cast<elem::js::Number>(expression.pitchBend));
+        args.insert_or_assign("pressure", static_cast<elem::js::Number>(expression.pressure));
+        handleBridgeMessage(bridgeMessages::SEND_MIDI, args);
+    };
+
+    editor->configureMPE = [this](const int lowerMembers, const int upperMembers, const int bendRange)
+    {
+        elem::js::Object args;
+        args.insert_or_assign("lowerMembers", static_cast<elem::js::Number>(lowerMembers));
+        args.insert_or_assign("upperMembers", static_cast<elem::js::Number>(upperMembers));
+        args.insert_or_assign("bendRange", static_cast<elem::js::Number>(bendRange));
+        handleBridgeMessage(bridgeMessages::CONFIGURE_MPE, args);
+    };
+
+    editor->configureMIDIInput = [this](const std::string& settings)
+    {
+        try
+        {
+            handleBridgeMessage(bridgeMessages::CONFIGURE_MIDI_INPUT, elem::js::parseJSON(settings));
+        }
+        catch (...)
+        {
+            MH_LOG(logger, error, bridge, "MIDI input settings are not valid JSON");
+        }
+    };
+
+    editor->configureLogging = [this](const std::string& settings)
+    {
+        try
+        {
+            handleBridgeMessage(bridgeMessages::CONFIGURE_LOGGING, elem::js::parseJSON(settings));
+        }
+        catch (...)
+        {
+            MH_LOG(logger, error, bridge, "Log settings are not valid JSON");
+        }
+    };
+
+    editor->playProgression = [this](const std::string& options)
+    {
+        try
+        {
+            handleBridgeMessage(bridgeMessages::PLAY_PROGRESSION, elem::js::parseJSON(options));
+        }
+        catch (...)
+        {
+            dispatchError("Playback Error", "Could not read the playback options");
+        }
+    };
+
+    editor->stopProgression = [this]()
+    {
+        handleBridgeMessage(bridgeMessages::STOP_PROGRESSION, elem::js::Object());
+    };
+
+    editor->voiceLead = [this](const std::string& request)
+    {
+        try
+        {
+            handleBridgeMessage(bridgeMessages::VOICE_LEAD, elem::js::parseJSON(request));
+        }
+        catch (...)
+        {
+            dispatchError("Voicing Error", "Could not read the voice leading request");
+        }
+    };
+
+    editor->suggestChords = [this](const int count)
+    {
+        elem::js::Object args;
+        args.insert_or_assign("count", static_cast<elem::js::Number>(count));
+        handleBridgeMessage(bridgeMessages::SUGGEST_CHORDS, args);
+    };
+
+    editor->loadProgramBank = [this](const std::string& path)
+    {
+        elem::js::Object args;
+        args.insert_or_assign("path", path);
+        handleBridgeMessage(bridgeMessages::LOAD_PROGRAM_BANK, args);
+    };
+
+    editor->storeProgram = [this](const int index, const std::string& name)
+    {
+        elem::js::Object args;
+        args.insert_or_assign("index", static_cast<elem::js::Number>(index));
+        args.insert_or_assign("name", name);
+        handleBridgeMessage(bridgeMessages::STORE_PROGRAM, args);
+    };
+
+    editor->selectProgram = [this](const int index)
+    {
+        elem::js::Object args;
+        args.insert_or_assign("index", static_cast<elem::js::Number>(index));
+        handleBridgeMessage(bridgeMessages::SELECT_PROGRAM, args);
     };
 
     editor->resetTableContent = [this]()
     {
-        handleResetTableContent();
+        handleBridgeMessage(bridgeMessages::RESET_TABLE_CONTENT, elem::js::Object());
+    };
+
+    editor->loadLibrary = [this](const std::string& path)
+    {
+        handleBridgeMessage(bridgeMessages::LOAD_LIBRARY, elem::js::Object{{"path", path}});
+    };
+
+    editor->queryLibrary = [this](const std::vector<std::vector<uint8_t>>& chords, const int page, const int pageSize)
+    {
+        elem::js::Array chordsJs;
+        for (const auto& chord : chords)
+        {
+            elem::js::Array notes;
+            for (const auto note : chord)
+                notes.push_back(static_cast<elem::js::Number>(note));
+            chordsJs.push_back(notes);
+        }
+
+        elem::js::Object args;
+        args.insert_or_assign("chords", chordsJs);
+        args.insert_or_assign("page", static_cast<elem::js::Number>(page));
+        args.insert_or_assign("pageSize", static_cast<elem::js::Number>(pageSize));
+        handleBridgeMessage(bridgeMessages::QUERY_LIBRARY, args);
+    };
+
+    editor->exportMIDIFile = [this](const std::string& path)
+    {
+        handleBridgeMessage(bridgeMessages::EXPORT_MIDI_FILE, elem::js::Object{{"path", path}});
+    };
+
+    editor->importMIDIFile = [this](const std::string& path)
+    {
+        handleBridgeMessage(bridgeMessages::IMPORT_MIDI_FILE, elem::js::Object{{"path", path}});
+    };
+
+    editor->undoChords = [this]()
+    {
+        handleBridgeMessage(bridgeMessages::UNDO_CHORDS, elem::js::Object());
+    };
+
+    editor->redoChords = [this]()
+    {
+        handleBridgeMessage(bridgeMessages::REDO_CHORDS, elem::js::Object());
+    };
+
+    editor->checkoutChords = [this](const int version)
+    {
+        handleBridgeMessage(bridgeMessages::CHECKOUT_CHORDS,
+                            elem::js::Object{{"version", static_cast<elem::js::Number>(version)}});
+    };
+
+    editor->startRecording = [this](const std::string& path)
+    {
+        handleStartRecording(path);
+    };
+
+    editor->stopRecording = [this]()
+    {
+        handleStopRecording();
+    };
+
+    editor->dumpStats = [this](const std::string& path)
+    {
+        handleDumpStats(path);
     };
 
     editor->ready = [this]()
     {
-        dispatchStateChange();
+        const juce::ScopedLock engineScope(engineLock);
+        dispatchEditorSnapshot();
     };
 
     // When setting a parameter value, we simply tell the host. This will in turn
@@ -155,23 +681,60 @@ double MindfulMIDI::getTailLengthSeconds() const
 //==============================================================================
 int MindfulMIDI::getNumPrograms()
 {
-    return 1; // NB: some hosts don't cope very well if you tell them there are 0 programs,
-    // so this should be at least 1, even if you're not really implementing programs.
+    // NB: some hosts don't cope very well if you tell them there are 0 programs,
+    // so this should be at least 1, even without a bank
+    return std::max(1, numBankPrograms.load());
 }
 
 int MindfulMIDI::getCurrentProgram()
 {
-    return 0;
+    return currentProgram.load();
 }
 
-void MindfulMIDI::setCurrentProgram(int /* index */)
+void MindfulMIDI::setCurrentProgram(int index)
 {
+    // VST3 hosts change programs through a parameter, which can land here on the
+    // audio thread, so the choice is only recorded and picked up by pollPrograms
+    if (index < 0 || index >= numBankPrograms.load())
+        return;
+
+    currentProgram.store(index);
+    programRequest.store(index);
+    triggerAsyncUpdate();
 }
 
-const juce::String MindfulMIDI::getProgramName(int /* index */) { return {}; }
+const juce::String MindfulMIDI::getProgramName(int index)
+{
+    std::shared_ptr<const std::vector<std::string>> names;
+    {
+        const juce::SpinLock::ScopedLockType lock(programNamesLock);
+        names = programNames;
+    }
+
+    if (names == nullptr || index < 0 || static_cast<size_t>(index) >= names->size())
+        return {};
 
-void MindfulMIDI::changeProgramName(int /* index */, const juce::String& /* newName */)
+    return juce::String((*names)[static_cast<size_t>(index)]);
+}
+
+void MindfulMIDI::changeProgramName(int index, const juce::String& newName)
 {
+    // Rewriting the bank is left to the next update, on the message thread,
+    // but the new name is served straight away
+    auto name = newName.toStdString().substr(0, mh::ProgramBank::maxNameLength);
+    {
+        const juce::SpinLock::ScopedLockType lock(programNamesLock);
+
+        if (programNames == nullptr || index < 0 || static_cast<size_t>(index) >= programNames->size())
+            return;
+
+        auto renamed = std::make_shared<std::vector<std::string>>(*programNames);
+        (*renamed)[static_cast<size_t>(index)] = name;
+        programNames = std::move(renamed);
+        pendingRenames.emplace_back(static_cast<uint32_t>(index), std::move(name));
+    }
+
+    triggerAsyncUpdate();
 }
 
 //==============================================================================
@@ -192,6 +755,15 @@ void MindfulMIDI::prepareToPlay(double sampleRate, int samplesPerBlock)
         shouldInitialize.store(true);
     }
 
+    // Scratch only ever holds copies of input channels, and never grows on the
+    // audio thread
+    const auto numScratchChannels = std::min(getTotalNumInputChannels(), maxElementaryChannels);
+    scratchBuffer.setSize(numScratchChannels, samplesPerBlock, false, true, true);
+    preparedBlockSize = samplesPerBlock;
+
+    chordDetector.prepare(sampleRate);
+    midiInputFilter.prepare(sampleRate);
+
     // Now that the environment is set up, push our current state
     triggerAsyncUpdate();
 }
@@ -215,73 +787,1379 @@ void MindfulMIDI::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffe
     // Process all MIDI first
     auto now = MIDIClock::now();
 
-    // Copy the input so that our input and output buffers are distinct
-    // scratchBuffer.makeCopyOf(buffer, true);
+    // An offline render runs the engine in line on this thread, see runUpdate.
+    // Back in realtime the message thread takes over again.
+    const bool offline = isNonRealtime();
+
+    if (engineOnRenderThread.exchange(offline) && !offline)
+        triggerAsyncUpdate();
+
+    if (offline)
+    {
+        const juce::ScopedLock engineScope(engineLock);
+        engineResetPending = initialiseEngineIfNeeded() || engineResetPending;
+    }
+
+#if MH_AUDIO_RATE_ELEMENTARY
+    processElementary(buffer);
+#endif
+
+    if (sessionRecorder.isRecording())
+    {
+        const auto& params = getParameters();
+        for (int i = 0; i < params.size(); ++i)
+            sessionRecorder.recordParameterIfChanged(static_cast<uint32_t>(i), params[i]->getValue());
+
+        sessionRecorder.captureInput(midiMessages);
+    }
+
+    const auto publishChord = [this](const mh::ChordDetector::Chord& chord)
+    {
+        if (!chord_fifo_queue.push(chord))
+        {
+            telemetry.add(mh::telemetry::Counter::chordsDropped);
+            MH_LOG(logger, warn, midi, "Chord FIFO full, dropped a chord change");
+        }
+        telemetry.set(mh::telemetry::Gauge::chordFifo, chord_fifo_queue.getUsedSlots());
+        triggerAsyncUpdate();
+    };
+
+    // Chord recognition doesn't depend on the JS engine, so it runs even while the
+    // runtime is being swapped
+    for (const auto metadata : midiMessages)
+    {
+        const auto* bytes = metadata.data;
+
+        if (metadata.numBytes <= 3)
+            chordDetector.handle(choc::midi::ShortMessage(bytes[0], metadata.numBytes > 1 ? bytes[1] : 0,
+                                                          metadata.numBytes > 2 ? bytes[2] : 0),
+                                 metadata.samplePosition, publishChord);
+    }
+
+    chordDetector.endBlock(buffer.getNumSamples(), publishChord);
+
+    // Only what the filter lets through crosses to the message thread. It runs
+    // on empty blocks too, as values it held back may have come due.
+    if (!runtimeSwapRequired)
+    {
+        midiInputFilter.beginBlock();
+
+        for (const auto metadata : midiMessages)
+            midiInputFilter.add(metadata.data, metadata.numBytes, metadata.samplePosition);
+
+        bool pushed = false;
+        const auto counts = midiInputFilter.endBlock(buffer.getNumSamples(), [&](int, const choc::midi::ShortMessage& m)
+        {
+            if (!midi_in_fifo_queue.push({now, m}))
+            {
+                telemetry.add(mh::telemetry::Counter::midiInDropped);
+                MH_LOG(logger, warn, midi, "MIDI In FIFO full, dropped [ {}, {}, {} ]", m.data[0], m.data[1], m.data[2]);
+                return;
+            }
+
+            pushed = true;
+        });
+
+        telemetry.add(mh::telemetry::Counter::midiInFiltered, counts.dropped);
+        telemetry.add(mh::telemetry::Counter::midiInCoalesced, counts.coalesced);
+
+        if (pushed)
+        {
+            telemetry.set(mh::telemetry::Gauge::midiInFifo, midi_in_fifo_queue.getUsedSlots());
+            triggerAsyncUpdate();
+        }
+    }
+    // We will re-assign to the MIDI buffer inside the process block,
+    // as whatever is assigned at this point, will be sent as MIDI out
+    // from the plug in. With the scripts stopped by the watchdog, incoming
+    // MIDI is left in place, so the instance still passes it through.
+    if (!scriptWatchdog.isTripped())
+        midiMessages.clear();
+
+    // The engine hears about this block's chords and parameters before its
+    // outgoing MIDI is drained below, so whatever it sends lands in this block
+    if (offline)
+    {
+        const juce::ScopedLock engineScope(engineLock);
+        runUpdate();
+        viewBehindRender.store(true);
+    }
+
+    if (schedulerClearRequested.exchange(false))
+        midiScheduler.clear();
+
+    const auto transport = readTransport();
+
+    // A new MPE layout ends whatever the old one left sounding before the
+    // configuration goes out, all at the top of the block
+    if (const auto request = mpeLayoutRequest.exchange(0); request != 0)
+    {
+        mpeAllocator.configure(unpackMpeLayout(request), [&midiMessages](const choc::midi::ShortMessage& message)
+        {
+            midiMessages.addEvent(juce::MidiMessage{message.data, static_cast<int>(message.length())}, 0);
+        });
+    }
+
+    if ( !runtimeSwapRequired && midi_out_fifo_queue.getUsedSlots() > 0 )
+    {
+        OutgoingMIDIEvent m;
+        while (midi_out_fifo_queue.pop(m))
+        {
+            if (!midiScheduler.schedule(m.message, m.timing, transport, m.expression))
+            {
+                telemetry.add(mh::telemetry::Counter::schedulerDropped);
+                MH_LOG(logger, warn, midi, "MIDI Out scheduler full, dropped event");
+            }
+        };
+    }
+
+    const auto emitOut = [this, &midiMessages](const int offset, const choc::midi::ShortMessage& message,
+                                               const mh::NoteExpression& expression)
+    {
+        mpeAllocator.process(message, expression, [&midiMessages, offset](const choc::midi::ShortMessage& routed)
+        {
+            midiMessages.addEvent(juce::MidiMessage{routed.data, static_cast<int>(routed.length())}, offset);
+        });
+    };
+
+    // Emit everything that falls due inside this block at its exact sample offset
+    midiScheduler.process(transport, buffer.getNumSamples(), emitOut);
+
+    progressionPlayer.process(transport, buffer.getNumSamples(),
+                              [&emitOut](const int offset, const choc::midi::ShortMessage& message)
+                              {
+                                  emitOut(offset, message, {});
+                              });
+
+    sessionRecorder.recordBlock(static_cast<uint32_t>(buffer.getNumSamples()), transport, midiMessages);
+
+
+    // Elementary needed a runtime swap
+    if (runtimeSwapRequired)
+    {
+        shouldInitialize.store(true);
+        triggerAsyncUpdate();
+    }
+}
+
+void MindfulMIDI::processElementary(juce::AudioBuffer<float>& buffer)
+{
+    // A newly published runtime takes over here, and the one it replaces goes
+    // back to the message thread, but only once there is room to send it
+    if (pendingRuntime.load(std::memory_order_relaxed) != nullptr && retiredRuntimes.getFreeSlots() > 0)
+    {
+        if (auto* next = pendingRuntime.exchange(nullptr, std::memory_order_acq_rel))
+        {
+            if (renderRuntime != nullptr)
+                retiredRuntimes.push(renderRuntime);
+
+            renderRuntime = next;
+        }
+    }
+
+    // Clear the output buffer to prevent any garbage if our runtime isn't ready
+    if (renderRuntime == nullptr || runtimeSwapRequired || shouldInitialize || preparedBlockSize <= 0)
+    {
+        buffer.clear();
+        return;
+    }
+
+    const auto numSamples = buffer.getNumSamples();
+    const auto numOutputs = std::min(buffer.getNumChannels(), maxElementaryChannels);
+    const auto numInputs = std::min({getTotalNumInputChannels(), buffer.getNumChannels(),
+                                     scratchBuffer.getNumChannels()});
+    const auto chunkSize = std::min(preparedBlockSize, scratchBuffer.getNumSamples());
+
+    for (int start = 0; start < numSamples; start += chunkSize)
+    {
+        const auto n = std::min(chunkSize, numSamples - start);
+
+        for (int ch = 0; ch < numOutputs; ++ch)
+            elementaryOutputs[static_cast<size_t>(ch)] = buffer.getWritePointer(ch, start);
+
+        // The runtime clears its outputs before rendering, so an input that shares
+        // memory with an output has to be read from a copy. JUCE processes in place,
+        // so that is every channel below numOutputs, i.e. all of ours.
+        for (int ch = 0; ch < numInputs; ++ch)
+        {
+            const auto* in = buffer.getReadPointer(ch, start);
+
+            if (ch < numOutputs)
+            {
+                auto* copy = scratchBuffer.getWritePointer(ch);
+                juce::FloatVectorOperations::copy(copy, in, n);
+                in = copy;
+            }
+
+            elementaryInputs[static_cast<size_t>(ch)] = in;
+        }
+
+        renderRuntime->process(
+            elementaryInputs.data(),
+            static_cast<size_t>(numInputs),
+            elementaryOutputs.data(),
+            static_cast<size_t>(numOutputs),
+            static_cast<size_t>(n),
+            nullptr
+        );
+    }
+}
+
+mh::MidiScheduler::Transport MindfulMIDI::readTransport() const
+{
+    mh::MidiScheduler::Transport transport;
+    transport.sampleRate = getSampleRate() > 0 ? getSampleRate() : 44100.0;
+
+    if (auto* playHead = getPlayHead())
+    {
+        if (const auto position = playHead->getPosition())
+        {
+            transport.isPlaying = position->getIsPlaying();
+
+            if (const auto ppq = position->getPpqPosition())
+            {
+                transport.hasPpq = true;
+                transport.ppqPosition = *ppq;
+            }
+
+            if (const auto bpm = position->getBpm())
+                transport.bpm = *bpm;
+
+            if (const auto loop = position->getLoopPoints(); loop && position->getIsLooping())
+            {
+                transport.isLooping = true;
+                transport.loopStartPpq = loop->ppqStart;
+                transport.loopEndPpq = loop->ppqEnd;
+            }
+        }
+    }
+
+    return transport;
+}
+
+void MindfulMIDI::handleResetTableContent()
+{
+    // resetting is itself a version, so it can be undone
+    chordsSoFar.commit(ChordProgression(), "reset");
+    // atomically lock any fifo access in the processBlock as we reset
+    runtimeSwapRequired.store ( true );
+        midi_out_fifo_queue.reset(100);
+        midi_in_fifo_queue.reset(100);
+    runtimeSwapRequired.store ( false );
+    // pending scheduled events belong to the audio thread, so ask it to drop them
+    schedulerClearRequested.store ( true );
+    // update JS contexts
+    refreshChordProgression();
+}
+
+void MindfulMIDI::handleLoadLibrary(const std::string& path)
+{
+    const auto file = path.empty()
+                          ? mh::util::getUserDataDirectory().getChildFile(staticNames::LIBRARY_FILE_NAME)
+                          : juce::File(path);
+
+    if (chordLibrary.open(file))
+    {
+        MH_LOG(logger, info, state, "Chord library opened, {} progressions", chordLibrary.getNumProgressions());
+        seedSuggestions();
+    }
+    else
+    {
+        dispatchError("Library Error", "Could not open chord library " + file.getFullPathName().toStdString());
+    }
+
+    libraryContent.clear();
+    libraryContent.insert_or_assign("numProgressions", static_cast<elem::js::Number>(chordLibrary.getNumProgressions()));
+    dispatchLibraryContent();
+}
+
+void MindfulMIDI::handleQueryLibrary(const std::vector<std::vector<uint8_t>>& chords, const int page, const int pageSize)
+{
+    // Open the default library on first use
+    if (!chordLibrary.isOpen() && chordLibrary.open(mh::util::getUserDataDirectory().getChildFile(staticNames::LIBRARY_FILE_NAME)))
+        seedSuggestions();
+
+    std::vector<mh::chordlib::PackedChord> sequence;
+    sequence.reserve(chords.size());
+    for (const auto& chord : chords)
+        sequence.push_back(mh::chordlib::pack(chord));
+
+    const auto safePageSize = static_cast<size_t>(juce::jlimit(1, 200, pageSize));
+    const auto offset = static_cast<size_t>(std::max(0, page)) * safePageSize;
+    const auto result = chordLibrary.find(sequence, offset, safePageSize);
+
+    // Only the requested page is decoded out of the mapped file
+    elem::js::Array matches;
+    for (const auto& match : result.matches)
+    {
+        elem::js::Array progression;
+        for (const auto& chord : chordLibrary.getProgression(match.progression))
+        {
+            elem::js::Array notes;
+            for (const auto note : mh::chordlib::unpack(chord))
+                notes.push_back(static_cast<elem::js::Number>(note));
+            progression.push_back(notes);
+        }
+
+        elem::js::Object m;
+        m.insert_or_assign("progression", static_cast<elem::js::Number>(match.progression));
+        m.insert_or_assign("position", static_cast<elem::js::Number>(match.position));
+        m.insert_or_assign("transposition", static_cast<elem::js::Number>(match.transposition));
+        m.insert_or_assign("chords", progression);
+        matches.push_back(m);
+    }
+
+    libraryContent.insert_or_assign("numProgressions", static_cast<elem::js::Number>(chordLibrary.getNumProgressions()));
+    libraryContent.insert_or_assign("totalMatches", static_cast<elem::js::Number>(result.totalMatches));
+    libraryContent.insert_or_assign("page", static_cast<elem::js::Number>(std::max(0, page)));
+    libraryContent.insert_or_assign("pageSize", static_cast<elem::js::Number>(safePageSize));
+    libraryContent.insert_or_assign("matches", matches);
+    dispatchLibraryContent();
+}
+
+void MindfulMIDI::handleExportMIDIFile(const std::string& path)
+{
+    if (midiFileJob != nullptr)
+    {
+        dispatchError("MIDI File Error", "A MIDI file import or export is already running");
+        return;
+    }
+
+    // getChildFile resolves relative names and keeps absolute paths as they are
+    const auto file = mh::util::getUserDataDirectory().getChildFile(juce::String(path.empty() ? staticNames::MIDI_FILE_NAME : path));
+    file.getParentDirectory().createDirectory();
+
+    midiFileJob = std::make_unique<MidiFileJob>(MidiFileJob::Operation::exportFile, file, chordsSoFar.getSnapshot(),
+                                                [this] { triggerAsyncUpdate(); });
+    lastDispatchedFilePercent = -1;
+    fileWorkers.addJob(midiFileJob.get(), false);
+}
+
+void MindfulMIDI::handleImportMIDIFile(const std::string& path)
+{
+    if (midiFileJob != nullptr)
+    {
+        dispatchError("MIDI File Error", "A MIDI file import or export is already running");
+        return;
+    }
+
+    // getChildFile resolves relative names and keeps absolute paths as they are
+    const auto file = mh::util::getUserDataDirectory().getChildFile(juce::String(path.empty() ? staticNames::MIDI_FILE_NAME : path));
+
+    midiFileJob = std::make_unique<MidiFileJob>(MidiFileJob::Operation::importFile, file, nullptr,
+                                                [this] { triggerAsyncUpdate(); });
+    lastDispatchedFilePercent = -1;
+    fileWorkers.addJob(midiFileJob.get(), false);
+}
+
+void MindfulMIDI::pollMidiFileJob()
+{
+    if (midiFileJob == nullptr)
+        return;
+
+    if (midiFileJob->finished.load())
+    {
+        fileWorkers.waitForJobToFinish(midiFileJob.get(), -1);
+
+        if (midiFileJob->ok && midiFileJob->operation == MidiFileJob::Operation::importFile)
+        {
+            chordsSoFar.commit(std::move(midiFileJob->imported), "import");
+            refreshChordProgression();
+        }
+
+        dispatchFileProgress(true);
+        midiFileJob.reset();
+        return;
+    }
+
+    const auto percent = static_cast<int>(midiFileJob->progress.load() * 100.0f);
+
+    if (percent != lastDispatchedFilePercent)
+    {
+        lastDispatchedFilePercent = percent;
+        dispatchFileProgress(false);
+    }
+}
+
+void MindfulMIDI::dispatchFileProgress(const bool finished)
+{
+    const mh::telemetry::Stats::Scope timed(telemetry, mh::telemetry::Section::fileProgressDispatch);
+
+    if (midiFileJob == nullptr)
+        return;
+
+    elem::js::Object progress;
+    progress.insert_or_assign("operation", elem::js::String(midiFileJob->operation == MidiFileJob::Operation::exportFile ? "export" : "import"));
+    progress.insert_or_assign("path", midiFileJob->file.getFullPathName().toStdString());
+    progress.insert_or_assign("progress", static_cast<elem::js::Number>(midiFileJob->progress.load()));
+    progress.insert_or_assign("done", finished);
+
+    if (finished)
+    {
+        progress.insert_or_assign("ok", midiFileJob->ok);
+        progress.insert_or_assign("error", midiFileJob->error);
+    }
+
+    const auto expr = serialize(jsFunctions::fileProgressScript, progress, "%");
+
+    if (auto* queue = getViewQueue())
+    {
+        queue->replace(mh::ViewDispatchQueue::Slot::fileProgress, expr);
+    }
+
+    evaluateInEngine(expr, mh::ScriptWatchdog::Script::fileProgress);
+}
+
+void MindfulMIDI::handleBridgeMessage(const std::string& name, const elem::js::Value& args)
+{
+    const juce::ScopedLock engineScope(engineLock);
+    sessionRecorder.recordBridge(name, elem::js::serialize(args));
+
+    const auto text = [&args](const char* key)
+    {
+        return args.isObject() ? args.getWithDefault(key, elem::js::String()) : elem::js::String();
+    };
+
+    const auto number = [&args](const char* key, const elem::js::Number fallback)
+    {
+        return args.isObject() ? args.getWithDefault(key, fallback) : fallback;
+    };
+
+    if (name == bridgeMessages::SEND_MIDI)
+    {
+        const auto timeBase = number("timeBase", 0);
+
+        if (timeBase != std::floor(timeBase) || !mh::MidiScheduler::isTimeBase(static_cast<int>(timeBase)))
+        {
+            MH_LOG(logger, warn, bridge, "Ignored MIDI out with unknown time base {}", timeBase);
+            return;
+        }
+
+        mh::MidiScheduler::Timing timing;
+        timing.base = static_cast<mh::MidiScheduler::TimeBase>(static_cast<int>(timeBase));
+        timing.time = number("time", 0);
+        timing.quantizeBeats = number("quantize", 0);
+
+        mh::NoteExpression expression;
+        expression.pitchBend = static_cast<float>(number("bend", 0));
+        expression.pressure = static_cast<float>(number("pressure", 0));
+        handleMidiOut(text("message"), timing, expression);
+    }
+    else if (name == bridgeMessages::RESET_TABLE_CONTENT)
+    {
+        handleResetTableContent();
+    }
+    else if (name == bridgeMessages::LOAD_LIBRARY)
+    {
+        handleLoadLibrary(text("path"));
+    }
+    else if (name == bridgeMessages::QUERY_LIBRARY)
+    {
+        std::vector<std::vector<uint8_t>> chords;
+        const auto chordsJs = args.isObject() ? args.getWithDefault("chords", elem::js::Array()) : elem::js::Array();
+
+        for (const auto& chordJs : chordsJs)
+        {
+            std::vector<uint8_t> notes;
+            if (chordJs.isArray())
+                for (const auto& note : chordJs.getArray())
+                    if (note.isNumber())
+                        notes.push_back(static_cast<uint8_t>(static_cast<elem::js::Number>(note)));
+            chords.push_back(std::move(notes));
+        }
+
+        handleQueryLibrary(chords, static_cast<int>(number("page", 0)), static_cast<int>(number("pageSize", 20)));
+    }
+    else if (name == bridgeMessages::EXPORT_MIDI_FILE)
+    {
+        handleExportMIDIFile(text("path"));
+    }
+    else if (name == bridgeMessages::IMPORT_MIDI_FILE)
+    {
+        handleImportMIDIFile(text("path"));
+    }
+    else if (name == bridgeMessages::UNDO_CHORDS)
+    {
+        handleUndoChords();
+    }
+    else if (name == bridgeMessages::REDO_CHORDS)
+    {
+        handleRedoChords();
+    }
+    else if (name == bridgeMessages::CHECKOUT_CHORDS)
+    {
+        if (const auto version = number("version", -1); version >= 0)
+            handleCheckoutChords(static_cast<uint32_t>(version));
+    }
+    else if (name == bridgeMessages::CONFIGURE_MPE)
+    {
+        handleConfigureMPE(mpeLayoutFromJs(args));
+    }
+    else if (name == bridgeMessages::CONFIGURE_MIDI_INPUT)
+    {
+        handleConfigureMIDIInput(args);
+    }
+    else if (name == bridgeMessages::CONFIGURE_LOGGING)
+    {
+        handleConfigureLogging(args);
+    }
+    else if (name == bridgeMessages::PLAY_PROGRESSION)
+    {
+        handlePlayProgression(args);
+    }
+    else if (name == bridgeMessages::STOP_PROGRESSION)
+    {
+        handleStopProgression();
+    }
+    else if (name == bridgeMessages::VOICE_LEAD)
+    {
+        handleVoiceLead(args);
+    }
+    else if (name == bridgeMessages::SUGGEST_CHORDS)
+    {
+        handleSuggestChords(static_cast<int>(number("count", static_cast<elem::js::Number>(numSuggestions))));
+    }
+    else if (name == bridgeMessages::LOAD_PROGRAM_BANK)
+    {
+        handleLoadProgramBank(text("path"));
+    }
+    else if (name == bridgeMessages::STORE_PROGRAM)
+    {
+        handleStoreProgram(static_cast<int>(number("index", -1)), text("name"));
+    }
+    else if (name == bridgeMessages::SELECT_PROGRAM)
+    {
+        handleSelectProgram(static_cast<int>(number("index", -1)));
+    }
+    else
+    {
+        MH_LOG(logger, warn, bridge, "Unknown bridge message");
+    }
+}
+
+void MindfulMIDI::handleStartRecording(const std::string& path)
+{
+    handleStopRecording();
+
+    const auto sessions = mh::util::getUserDataDirectory().getChildFile(staticNames::SESSIONS_DIRECTORY);
+    const auto file = path.empty()
+                          ? sessions.getChildFile("session-" + juce::Time::getCurrentTime().formatted("%Y%m%d-%H%M%S")
+                                                  + juce::String(staticNames::SESSION_FILE_EXTENSION))
+                          : sessions.getChildFile(juce::String(path));
+
+    sessionRecorder.prepare(static_cast<size_t>(getParameters().size()));
+
+    if (!sessionRecorder.start(file, getSampleRate() > 0 ? getSampleRate() : 44100.0, getBlockSize()))
+    {
+        dispatchError("Session Recording Error", "Could not write " + file.getFullPathName().toStdString());
+        return;
+    }
+
+    traceDrain = std::make_unique<TraceDrain>(sessionRecorder);
+    MH_LOG(logger, info, state, "Session recording started");
+}
+
+void MindfulMIDI::handleStopRecording()
+{
+    if (!sessionRecorder.isRecording())
+        return;
+
+    traceDrain.reset();
+    sessionRecorder.stop();
+
+    if (const auto dropped = sessionRecorder.getNumDropped(); dropped > 0)
+        MH_LOG(logger, warn, state, "Session recording dropped {} records", dropped);
+
+    MH_LOG(logger, info, state, "Session recording stopped");
+}
+
+elem::js::Object MindfulMIDI::replaySession(const juce::File& traceFile)
+{
+    elem::js::Object report;
+    mh::trace::Reader reader;
+
+    if (!reader.open(traceFile))
+    {
+        report.insert_or_assign("error", reader.getError());
+        return report;
+    }
+
+    const auto sampleRate = reader.getSampleRate();
+    const auto blockSize = reader.getBlockSize();
+
+    // A headless instance: no editor and no host, the trace supplies the rest.
+    // Async updates are run in line after every block, as if the message thread
+    // kept up perfectly.
+    auto headless = std::make_unique<MindfulMIDI>();
+    headless->runsUpdatesInLine = true;
+    ReplayPlayHead playHead;
+    headless->setPlayHead(&playHead);
+    headless->setRateAndBufferSizeDetails(sampleRate, blockSize);
+    headless->prepareToPlay(sampleRate, blockSize);
+    headless->handleUpdateNowIfNeeded();
+
+    juce::AudioBuffer<float> audio(std::max(2, headless->getTotalNumOutputChannels()), std::max(1, blockSize));
+    juce::MidiBuffer midi;
+    midi.ensureSize(4096);
+    std::vector<mh::trace::MidiEvent> produced;
+
+    StageTiming processTiming, updateTiming, bridgeTiming;
+    uint64_t numBlocks = 0, numInput = 0, numOutput = 0, numMismatched = 0, numParameters = 0;
+    elem::js::Array mismatches;
+
+    const auto& params = headless->getParameters();
+    const auto wallStart = std::chrono::steady_clock::now();
+    mh::trace::Record record;
+
+    while (reader.next(record))
+    {
+        switch (record.type)
+        {
+            case mh::trace::RecordType::parameter:
+                if (static_cast<int>(record.parameterIndex) < params.size())
+                    params[static_cast<int>(record.parameterIndex)]->setValueNotifyingHost(record.value);
+                ++numParameters;
+                break;
+
+            case mh::trace::RecordType::bridge:
+                bridgeTiming.measure([&]
+                {
+                    headless->handleBridgeMessage(record.name, elem::js::parseJSON(record.json));
+                });
+                break;
+
+            case mh::trace::RecordType::block:
+            {
+                playHead.transport = record.transport;
+                audio.setSize(audio.getNumChannels(), static_cast<int>(record.numSamples), false, false, true);
+                audio.clear();
+                midi.clear();
+
+                for (const auto& e : record.input)
+                    midi.addEvent(e.bytes.data(), static_cast<int>(e.bytes.size()), e.offset);
+
+                processTiming.measure([&] { headless->processBlock(audio, midi); });
+
+                produced.clear();
+                for (const auto metadata : midi)
+                    produced.push_back({metadata.samplePosition,
+                                        std::vector<uint8_t>(metadata.data, metadata.data + metadata.numBytes)});
+
+                if (produced != record.output)
+                {
+                    if (++numMismatched <= 10)
+                    {
+                        elem::js::Object mismatch;
+                        mismatch.insert_or_assign("block", static_cast<elem::js::Number>(numBlocks));
+                        mismatch.insert_or_assign("expected", describeEvents(record.output));
+                        mismatch.insert_or_assign("actual", describeEvents(produced));
+                        mismatches.push_back(mismatch);
+                    }
+                }
+
+                updateTiming.measure([&] { headless->handleUpdateNowIfNeeded(); });
+
+                ++numBlocks;
+                numInput += record.input.size();
+                numOutput += record.output.size();
+                break;
+            }
+        }
+    }
+
+    headless->releaseResources();
+
+    const auto wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wallStart).count();
+    const auto sessionMs = static_cast<double>(record.micros) * 0.001;
+
+    elem::js::Object stages;
+    stages.insert_or_assign("processBlock", processTiming.toJs());
+    stages.insert_or_assign("asyncUpdate", updateTiming.toJs());
+    stages.insert_or_assign("bridge", bridgeTiming.toJs());
+
+    report.insert_or_assign("ok", reader.getError().empty() && numMismatched == 0);
+    report.insert_or_assign("error", reader.getError());
+    report.insert_or_assign("blocks", static_cast<elem::js::Number>(numBlocks));
+    report.insert_or_assign("inputEvents", static_cast<elem::js::Number>(numInput));
+    report.insert_or_assign("outputEvents", static_cast<elem::js::Number>(numOutput));
+    report.insert_or_assign("parameterChanges", static_cast<elem::js::Number>(numParameters));
+    report.insert_or_assign("mismatchedBlocks", static_cast<elem::js::Number>(numMismatched));
+    report.insert_or_assign("mismatches", mismatches);
+    report.insert_or_assign("sessionMs", sessionMs);
+    report.insert_or_assign("replayMs", wallMs);
+    report.insert_or_assign("stages", stages);
+    return report;
+}
+
+void MindfulMIDI::handleUndoChords()
+{
+    if (chordsSoFar.undo())
+        refreshChordProgression();
+}
+
+void MindfulMIDI::handleRedoChords()
+{
+    if (chordsSoFar.redo())
+        refreshChordProgression();
+}
+
+void MindfulMIDI::handleCheckoutChords(const uint32_t version)
+{
+    if (chordsSoFar.checkout(version))
+        refreshChordProgression();
+}
+
+void MindfulMIDI::handlePlayProgression(const elem::js::Value& options)
+{
+    playbackRequest = options;
+    playbackOptions = playbackOptionsFromJs(options);
+    playbackActive = true;
+    publishPlayback(true);
+}
+
+void MindfulMIDI::handleStopProgression()
+{
+    playbackActive = false;
+    progressionPlayer.publish(nullptr);
+    MH_LOG(logger, info, midi, "Progression playback stopped");
+}
+
+void MindfulMIDI::publishPlayback(const bool restart)
+{
+    if (!playbackActive)
+        return;
+
+    mh::ProgressionPlayer::Builder builder;
+    chordsSoFar.head().forEach([&builder](const ChordNotes& chord)
+    {
+        builder.add(chord.noteNumbers, chord.time);
+    });
+
+    auto arrangement = builder.build(playbackOptions, restart);
+    MH_LOG(logger, info, midi, "Progression playback: {} chords over {} beats", arrangement->chords.size(),
+           arrangement->totalBeats);
+    progressionPlayer.publish(std::move(arrangement));
+}
+
+void MindfulMIDI::handleVoiceLead(const elem::js::Value& args)
+{
+    const auto number = [&args](const char* key, const elem::js::Number fallback)
+    {
+        return args.isObject() ? args.getWithDefault(key, fallback) : fallback;
+    };
+
+    const auto midiNote = [&number](const char* key, const int fallback)
+    {
+        return static_cast<uint8_t>(std::clamp(static_cast<int>(number(key, fallback)), 0, 127));
+    };
+
+    mh::voicing::Constraints constraints;
+    constraints.numVoices = static_cast<uint8_t>(std::clamp(static_cast<int>(number("voices", constraints.numVoices)), 1, 8));
+    constraints.lowest = midiNote("lowest", constraints.lowest);
+    constraints.highest = midiNote("highest", constraints.highest);
+    constraints.maxSpacing = static_cast<uint8_t>(std::clamp(static_cast<int>(number("maxSpacing", constraints.maxSpacing)), 1, 48));
+    constraints.maxBassGap = static_cast<uint8_t>(std::clamp(static_cast<int>(number("maxBassGap", constraints.maxBassGap)), 1, 48));
+    constraints.maxDoubling = static_cast<uint8_t>(std::clamp(static_cast<int>(number("maxDoubling", constraints.maxDoubling)), 1, 8));
+
+    // Symbols such as "Dm7" or "G/B", or pitch class sets as note numbers of
+    // any octave. null or "|" ends a phrase. Without chords the captured
+    // progression is voiced, grouped the way playback groups it.
+    std::vector<mh::voicing::ChordSpec> chords;
+    bool phraseBreak = true;
+
+    const auto addPitchClasses = [&](const auto& notes)
+    {
+        mh::voicing::ChordSpec chord;
+        for (const auto note : notes)
+            chord.pitchClasses |= static_cast<uint16_t>(1u << (static_cast<int>(note) % 12));
+
+        chord.startsPhrase = std::exchange(phraseBreak, false);
+        chords.push_back(chord);
+    };
+
+    const auto chordsJs = args.isObject() ? args.getWithDefault("chords", elem::js::Array()) : elem::js::Array();
+
+    if (chordsJs.empty())
+    {
+        mh::ProgressionPlayer::Builder builder;
+        chordsSoFar.head().forEach([&builder](const ChordNotes& chord)
+        {
+            builder.add(chord.noteNumbers, chord.time);
+        });
+
+        for (size_t i = 0; i < builder.getNumChords(); ++i)
+            addPitchClasses(builder.getChordNotes(i));
+    }
+
+    for (size_t i = 0; i < chordsJs.size(); ++i)
+    {
+        const auto& chordJs = chordsJs[i];
+        const auto symbol = chordJs.isString() ? static_cast<elem::js::String>(chordJs) : elem::js::String();
+
+        if (chordJs.isString() && symbol != "|")
+        {
+            mh::voicing::ChordSpec chord;
+
+            if (!mh::ChordDetector::parseSymbol(symbol, chord.pitchClasses, chord.bass))
+            {
+                dispatchError("Voicing Error", "Chord " + std::to_string(i + 1) + " is not a chord symbol: " + symbol);
+                return;
+            }
+
+            chord.startsPhrase = std::exchange(phraseBreak, false);
+            chords.push_back(chord);
+        }
+        else if (chordJs.isArray())
+        {
+            std::vector<int> notes;
+            for (const auto& note : chordJs.getArray())
+                if (note.isNumber())
+                    notes.push_back(std::clamp(static_cast<int>(static_cast<elem::js::Number>(note)), 0, 127));
+
+            addPitchClasses(notes);
+        }
+        else
+        {
+            phraseBreak = true;
+        }
+    }
+
+    auto job = std::make_unique<VoicingJob>(voicingWorkers, std::move(chords), constraints, [this] { triggerAsyncUpdate(); });
+
+    if (voicingJob != nullptr)
+    {
+        queuedVoicingJob = std::move(job);
+        return;
+    }
+
+    voicingJob = std::move(job);
+    voicingWorkers.addJob(voicingJob.get(), false);
+}
+
+void MindfulMIDI::pollVoicingJob()
+{
+    if (voicingJob == nullptr || !voicingJob->finished.load())
+        return;
+
+    voicingWorkers.waitForJobToFinish(voicingJob.get(), -1);
+
+    const auto& result = voicingJob->result;
+    elem::js::Object voicings;
+    voicings.insert_or_assign("ok", result.ok);
+
+    if (result.ok)
+    {
+        elem::js::Array chords;
+        for (const auto& voicing : result.voicings)
+        {
+            elem::js::Array notes;
+            for (const auto note : voicing)
+                notes.push_back(static_cast<elem::js::Number>(note));
+            chords.push_back(notes);
+        }
+
+        voicings.insert_or_assign("chords", chords);
+        voicings.insert_or_assign("movement", static_cast<elem::js::Number>(result.movement));
+        voicings.insert_or_assign("numPhrases", static_cast<elem::js::Number>(result.numPhrases));
+        voicings.insert_or_assign("numCandidates", static_cast<elem::js::Number>(result.numCandidates));
+        voicings.insert_or_assign("elapsedMs", voicingJob->elapsedMs);
+
+        MH_LOG(logger, info, state, "Voiced {} chords in {} ms, {} semitones of movement", result.voicings.size(),
+               voicingJob->elapsedMs, result.movement);
+    }
+    else
+    {
+        voicings.insert_or_assign("error", result.error);
+        dispatchError("Voicing Error", result.error);
+    }
+
+    tableContent.insert_or_assign(staticNames::VOICINGS, voicings);
+    editorSnapshot.setTableContent(tableContent);
+    dispatchTableContentStateChange();
+
+    voicingJob = std::move(queuedVoicingJob);
+
+    if (voicingJob != nullptr)
+        voicingWorkers.addJob(voicingJob.get(), false);
+}
+
+void MindfulMIDI::refreshChordProgression()
+{
+    publishPlayback(false);
+
+    // Only the chords from the first one that changed are reserialised
+    editorSnapshot.setProgression(chordsSoFar.head());
+
+    elem::js::Object history;
+    history.insert_or_assign("version", static_cast<elem::js::Number>(chordsSoFar.getCurrentVersion()));
+    history.insert_or_assign("numVersions", static_cast<elem::js::Number>(chordsSoFar.getNumVersions()));
+    history.insert_or_assign("canUndo", chordsSoFar.canUndo());
+    history.insert_or_assign("canRedo", chordsSoFar.canRedo());
+    tableContent.insert_or_assign(staticNames::CHORD_HISTORY, history);
+    editorSnapshot.setTableContent(tableContent);
+
+    // notify the JS engine and View ( if its open )
+    // of new chord and chord progression
+    dispatchTableContentStateChange();
+
+    followChordsForSuggestions();
+    dispatchSuggestions(false);
+}
+
+void MindfulMIDI::followChordsForSuggestions()
+{
+    const auto& head = chordsSoFar.head();
+    bool appendedOnly = true;
+
+    ChordProgression::diff(followedChords, head, [&](const size_t begin, size_t)
+    {
+        appendedOnly = appendedOnly && begin >= followedChords.size();
+    });
+
+    if (!appendedOnly)
+    {
+        suggestionEngine.resetSession();
+        followedChords = ChordProgression();
+    }
+
+    for (auto i = followedChords.size(); i < head.size(); ++i)
+        suggestionEngine.observe(head[i].noteNumbers, head[i].time);
+
+    followedChords = head;
+}
+
+void MindfulMIDI::seedSuggestions()
+{
+    // Counting is a pass over the whole library, once per library opened
+    suggestionEngine.clearSeed();
+
+    for (uint32_t i = 0; i < chordLibrary.getNumProgressions(); ++i)
+        suggestionEngine.seed(chordLibrary.getProgression(i));
+
+    MH_LOG(logger, info, state, "Suggestions seeded with {} chords", suggestionEngine.getNumSeedChords());
+    dispatchSuggestions(false);
+}
+
+void MindfulMIDI::handleSuggestChords(const int count)
+{
+    // No count keeps the current one
+    if (count > 0)
+        numSuggestions = static_cast<size_t>(juce::jlimit(1, 24, count));
+
+    dispatchSuggestions(true);
+}
+
+void MindfulMIDI::dispatchSuggestions(const bool force)
+{
+    const mh::telemetry::Stats::Scope timed(telemetry, mh::telemetry::Section::suggestionDispatch);
+
+    auto suggestions = suggestionEngine.suggest(numSuggestions);
+
+    const auto sameRanking = std::equal(suggestions.begin(), suggestions.end(),
+                                        dispatchedSuggestions.begin(), dispatchedSuggestions.end(),
+                                        [](const auto& a, const auto& b) { return a.sameChordAs(b); });
+
+    if (sameRanking && !force)
+        return;
+
+    elem::js::Array context;
+    for (const auto& chord : suggestionEngine.getContext())
+        context.push_back(chord.getName());
+
+    elem::js::Array ranked;
+    for (const auto& suggestion : suggestions)
+    {
+        mh::ChordDetector::Chord chord;
+        chord.root = suggestion.root;
+        chord.bass = suggestion.root;
+        chord.quality = suggestion.quality;
+
+        // Close position from the root above middle C, to audition with
+        mh::chordlib::PackedChord packed;
+        packed.bass = static_cast<uint8_t>(60 + suggestion.root);
+        int bass = -1;
+        mh::ChordDetector::parseSymbol(chord.getName(), packed.pitchClasses, bass);
+
+        elem::js::Array notes;
+        for (const auto note : mh::chordlib::unpack(packed))
+            notes.push_back(static_cast<elem::js::Number>(note));
+
+        elem::js::Object s;
+        s.insert_or_assign("name", chord.getName());
+        s.insert_or_assign("root", static_cast<elem::js::Number>(suggestion.root));
+        s.insert_or_assign("quality", elem::js::String(mh::ChordDetector::getQualitySuffix(suggestion.quality)));
+        s.insert_or_assign("score", static_cast<elem::js::Number>(suggestion.score));
+        s.insert_or_assign("order", static_cast<elem::js::Number>(suggestion.order));
+        s.insert_or_assign("notes", notes);
+        ranked.push_back(s);
+    }
+
+    elem::js::Object payload;
+    payload.insert_or_assign("context", context);
+    payload.insert_or_assign("suggestions", ranked);
+    dispatchedSuggestions = std::move(suggestions);
+
+    const auto expr = serialize(jsFunctions::suggestionsScript, payload, "%");
+
+    if (auto* queue = getViewQueue())
+    {
+        queue->replace(mh::ViewDispatchQueue::Slot::suggestions, expr);
+    }
+
+    evaluateInEngine(expr, mh::ScriptWatchdog::Script::suggestions);
+}
+
+//==============================================================================
+void MindfulMIDI::handleLoadProgramBank(const std::string& path)
+{
+    const auto file = path.empty()
+                          ? mh::util::getUserDataDirectory().getChildFile(staticNames::PROGRAM_BANK_FILE_NAME)
+                          : juce::File(path);
+
+    // Renames queued against the old bank don't carry over
+    {
+        const juce::SpinLock::ScopedLockType lock(programNamesLock);
+        pendingRenames.clear();
+    }
+
+    if (programBank.open(file))
+        MH_LOG(logger, info, state, "Program bank opened, {} programs", programBank.getNumPrograms());
+    else
+        dispatchError("Program Error", "Could not open program bank " + file.getFullPathName().toStdString());
+
+    resetDecodedPrograms();
+    currentProgram.store(0);
+    dispatchProgramList();
+    updateHostDisplay(juce::AudioProcessorListener::ChangeDetails().withProgramChanged(true));
+}
+
+void MindfulMIDI::handleStoreProgram(const int index, const std::string& name)
+{
+    // Storing before any bank was loaded adds to the default one
+    const auto defaultFile = mh::util::getUserDataDirectory().getChildFile(staticNames::PROGRAM_BANK_FILE_NAME);
+    if (!programBank.isOpen() && programBank.open(defaultFile))
+        resetDecodedPrograms();
+
+    const auto file = programBank.isOpen() ? programBank.getFile() : defaultFile;
+    const auto numPrograms = programBank.getNumPrograms();
+    const auto i = index < 0 ? numPrograms : std::min(static_cast<uint32_t>(index), numPrograms);
+
+    mh::ProgramBank::Program program;
+    program.name = name.empty() ? "Program " + std::to_string(i + 1) : name;
+    program.data = elem::js::serialize(captureProgram());
+
+    if (!programBank.store(file, i, program))
+    {
+        dispatchError("Program Error", "Could not store program in " + file.getFullPathName().toStdString());
+        resetDecodedPrograms();
+        dispatchProgramList();
+        return;
+    }
+
+    // Only the stored program has to be decoded again. Jobs already running
+    // might be decoding the old one, so whatever they produce is dropped.
+    ++programBankGeneration;
+    decodedPrograms.resize(programBank.getNumPrograms());
+    decodedPrograms[i].reset();
+    numBankPrograms.store(static_cast<int>(programBank.getNumPrograms()));
+    currentProgram.store(static_cast<int>(i));
+    publishProgramNames();
+
+    MH_LOG(logger, info, state, "Stored program {} of {}, {} bytes", i + 1, programBank.getNumPrograms(),
+           program.data.size());
+
+    dispatchProgramList();
+    updateHostDisplay(juce::AudioProcessorListener::ChangeDetails().withProgramChanged(true));
+}
+
+void MindfulMIDI::handleSelectProgram(const int index)
+{
+    setCurrentProgram(index);
+    updateHostDisplay(juce::AudioProcessorListener::ChangeDetails().withProgramChanged(true));
+}
+
+void MindfulMIDI::dispatchProgramList()
+{
+    elem::js::Array names;
+    for (uint32_t i = 0; i < programBank.getNumPrograms(); ++i)
+        names.push_back(elem::js::String(programBank.getName(i)));
+
+    elem::js::Object programs;
+    programs.insert_or_assign("names", names);
+    programs.insert_or_assign("current", static_cast<elem::js::Number>(currentProgram.load()));
+    programs.insert_or_assign("file", programBank.getFile().getFullPathName().toStdString());
+
+    tableContent.insert_or_assign(staticNames::PROGRAMS, programs);
+    editorSnapshot.setTableContent(tableContent);
+    dispatchTableContentStateChange();
+}
+
+void MindfulMIDI::resetDecodedPrograms()
+{
+    ++programBankGeneration;
+    decodedPrograms.assign(programBank.getNumPrograms(), nullptr);
+    numBankPrograms.store(static_cast<int>(programBank.getNumPrograms()));
+    programToApply = -1;
+    publishProgramNames();
+}
+
+void MindfulMIDI::publishProgramNames()
+{
+    auto names = std::make_shared<const std::vector<std::string>>([this]
+    {
+        std::vector<std::string> result;
+        result.reserve(programBank.getNumPrograms());
+
+        for (uint32_t i = 0; i < programBank.getNumPrograms(); ++i)
+            result.push_back(programBank.getName(i));
+
+        return result;
+    }());
+
+    // A rename still queued shows until it is written
+    const juce::SpinLock::ScopedLockType lock(programNamesLock);
+    if (!pendingRenames.empty())
+    {
+        auto renamed = std::make_shared<std::vector<std::string>>(*names);
+        for (const auto& [index, name] : pendingRenames)
+            if (index < renamed->size())
+                (*renamed)[index] = name;
+        names = std::move(renamed);
+    }
+    programNames.swap(names);
+}
+
+void MindfulMIDI::applyPendingRenames()
+{
+    std::vector<std::pair<uint32_t, std::string>> renames;
+    {
+        const juce::SpinLock::ScopedLockType lock(programNamesLock);
+        renames.swap(pendingRenames);
+    }
+
+    if (renames.empty())
+        return;
+
+    for (const auto& [index, name] : renames)
+    {
+        if (!programBank.rename(index, name))
+            MH_LOG(logger, warn, state, "Program {} could not be renamed", index + 1);
+    }
+
+    // The data didn't change, so the decoded programs still stand
+    publishProgramNames();
+    dispatchProgramList();
+    updateHostDisplay(juce::AudioProcessorListener::ChangeDetails().withProgramChanged(true));
+}
+
+elem::js::Object MindfulMIDI::captureProgram() const
+{
+    elem::js::Object parameters;
+    for (const auto* p : floatParams)
+        parameters.insert_or_assign(p->paramID.toStdString(), static_cast<elem::js::Number>(p->get()));
+
+    elem::js::Object program;
+    program.insert_or_assign(staticNames::PARAMETERS, parameters);
+    program.insert_or_assign(staticNames::CHORD_PROGRESSION, mh::util::wrapChordsToJsValue(chordsSoFar.head()));
+
+    if (mpeLayout.isEnabled())
+        program.insert_or_assign(staticNames::MPE_LAYOUT, mpeLayoutToJs(mpeLayout));
+
+    if (const auto settings = midiInputFilter.getSettings(); !(settings == mh::MidiInputFilter::Settings{}))
+        program.insert_or_assign(staticNames::MIDI_INPUT_FILTER, midiInputSettingsToJs(settings));
+
+    if (playbackRequest.isObject())
+        program.insert_or_assign(staticNames::PLAYBACK_OPTIONS, playbackRequest);
+
+    return program;
+}
+
+std::unique_ptr<MindfulMIDI::Program> MindfulMIDI::decodeProgram(const std::string& data) const
+{
+    // Worker thread. Only reads what stays fixed after construction.
+    auto program = std::make_unique<Program>();
+
+    try
+    {
+        const auto parsed = elem::js::parseJSON(data);
+
+        if (!parsed.isObject())
+            return program;
+
+        const auto& o = parsed.getObject();
+
+        if (const auto parameters = o.find(staticNames::PARAMETERS); parameters != o.end() && parameters->second.isObject())
+        {
+            for (const auto& [paramId, value] : parameters->second.getObject())
+            {
+                const auto param = parameterMap.find(paramId);
+                if (param != parameterMap.end() && value.isNumber())
+                    program->parameters.emplace_back(param->second, static_cast<float>(static_cast<elem::js::Number>(value)));
+            }
+        }
+
+        if (const auto chords = o.find(staticNames::CHORD_PROGRESSION); chords != o.end())
+        {
+            program->chords = mh::util::unwrapChordsFromJsValue(chords->second);
+            program->hasChords = true;
+        }
+
+        // Programs saved without zones or a filter play without them
+        const auto mpe = o.find(staticNames::MPE_LAYOUT);
+        program->mpeLayout = mpe != o.end() ? mpeLayoutFromJs(mpe->second) : mh::MpeAllocator::Layout{};
+
+        const auto filter = o.find(staticNames::MIDI_INPUT_FILTER);
+        program->inputFilter = filter != o.end() ? midiInputSettingsFromJs(filter->second, {}) : mh::MidiInputFilter::Settings{};
+
+        if (const auto playback = o.find(staticNames::PLAYBACK_OPTIONS); playback != o.end() && playback->second.isObject())
+        {
+            program->playback = playbackOptionsFromJs(playback->second);
+            program->playbackRequest = playback->second;
+            program->hasPlayback = true;
+        }
+
+        program->valid = true;
+    }
+    catch (...)
+    {
+        program->valid = false;
+    }
+
+    return program;
+}
+
+void MindfulMIDI::applyProgram(const Program& program)
+{
+    for (const auto& [param, value] : program.parameters)
+        param->setValueNotifyingHost(param->convertTo0to1(value));
+
+    if (!(program.mpeLayout == mpeLayout))
+        handleConfigureMPE(program.mpeLayout);
+
+    midiInputFilter.configure(program.inputFilter);
+
+    // Playback carries on if it is running, with the program's options and chords
+    if (program.hasPlayback)
+    {
+        playbackOptions = program.playback;
+        playbackRequest = program.playbackRequest;
+    }
+
+    // The progression was built when the program was decoded, so this is a
+    // single commit, undoable like any other edit
+    if (program.hasChords)
+        chordsSoFar.commit(program.chords, "program");
+
+    refreshChordProgression();
+    dispatchProgramList();
+}
+
+void MindfulMIDI::startProgramJob(const uint32_t index)
+{
+    programJob = std::make_unique<ProgramJob>(index, programBankGeneration, std::string(programBank.getData(index)),
+                                              [this](const std::string& data) -> std::shared_ptr<const Program>
+                                              {
+                                                  return decodeProgram(data);
+                                              },
+                                              [this] { triggerAsyncUpdate(); });
+    programWorkers.addJob(programJob.get(), false);
+}
+
+void MindfulMIDI::pollPrograms()
+{
+    applyPendingRenames();
 
-    // Clear the output buffer to prevent any garbage if our runtime isn't ready
-    // buffer.clear();
-
-    // Process the elementary runtime
-    // if (elementaryRuntime != nullptr && !runtimeSwapRequired)
-    // {
-    //     elementaryRuntime->process(
-    //         const_cast<const float**>(scratchBuffer.getArrayOfWritePointers()),
-    //         getTotalNumInputChannels(),
-    //         const_cast<float**>(buffer.getArrayOfWritePointers()),
-    //         buffer.getNumChannels(),
-    //         buffer.getNumSamples(),
-    //         nullptr
-    //     );
-    // }
-
-    // not sure if this needs to be handled with a runtimeSwapRequired flag
-    if (!runtimeSwapRequired && !midiMessages.isEmpty() )
+    if (programJob != nullptr && programJob->finished.load())
     {
-        for (const auto metadata : midiMessages)
+        programWorkers.waitForJobToFinish(programJob.get(), -1);
+
+        if (programJob->generation == programBankGeneration && programJob->index < decodedPrograms.size())
         {
-            const auto bytes = metadata.getMessage().getRawData();
-            const auto m = choc::midi::ShortMessage(bytes[0], bytes[1], bytes[2]);
-            midi_in_fifo_queue.push({now, m});
+            decodedPrograms[programJob->index] = programJob->program;
+
+            if (!programJob->program->valid)
+                MH_LOG(logger, error, state, "Program {} could not be decoded", programJob->index + 1);
         }
-        triggerAsyncUpdate();
+
+        programJob.reset();
     }
-    // We will re-assign to the MIDI buffer inside the process block,
-    // as whatever is assigned at this point, will be sent as MIDI out
-    // from the plug in
-    midiMessages.clear();
 
-    if ( !runtimeSwapRequired && midi_out_fifo_queue.getUsedSlots() > 0 )
+    if (const auto request = programRequest.exchange(-1); request >= 0)
+        programToApply = request;
+
+    if (programToApply >= 0)
     {
-        OutgoingMIDIEvent m;
-        while (midi_out_fifo_queue.pop(m))
+        const auto index = static_cast<size_t>(programToApply);
+
+        if (index >= decodedPrograms.size())
         {
-            juce::MidiMessage messageOut{m.message.data, m.message.length()};
-            midiMessages.addEvent(messageOut, m.index);
-        };
+            programToApply = -1;
+        }
+        else if (const auto program = decodedPrograms[index])
+        {
+            programToApply = -1;
+
+            if (program->valid)
+                applyProgram(*program);
+            else
+                dispatchError("Program Error", "Program " + std::to_string(index + 1) + " could not be decoded");
+        }
+        else
+        {
+            // Decoded as soon as the worker is free, and applied when it is done
+            if (programJob == nullptr)
+                startProgramJob(static_cast<uint32_t>(index));
+            return;
+        }
     }
 
+    // With nothing asked for, the programs either side of the current one are
+    // decoded ahead, so stepping through the bank finds them ready
+    if (programJob != nullptr)
+        return;
 
-    // Elementary needed a runtime swap
-    if (runtimeSwapRequired)
+    for (const auto offset : {1, -1, 2})
     {
-        shouldInitialize.store(true);
-        triggerAsyncUpdate();
+        const auto index = currentProgram.load() + offset;
+
+        if (index >= 0 && static_cast<size_t>(index) < decodedPrograms.size() && decodedPrograms[static_cast<size_t>(index)] == nullptr)
+        {
+            startProgramJob(static_cast<uint32_t>(index));
+            return;
+        }
     }
 }
 
-void MindfulMIDI::handleResetTableContent()
+void MindfulMIDI::handleConfigureMPE(const mh::MpeAllocator::Layout& requested)
 {
-    tableContent.erase(staticNames::CHORD_PROGRESSION);
-    chordsSoFar.clear();
-    // atomically lock any fifo access in the processBlock as we reset
-    runtimeSwapRequired.store ( true );
-        midi_out_fifo_queue.reset(100);
-        midi_in_fifo_queue.reset(100);
-    runtimeSwapRequired.store ( false );
-    // update JS contexts
-    dispatchTableContentStateChange();
+    // Saved and compared against programs as the allocator will run it
+    mpeLayout = mh::MpeAllocator::clamp(requested);
+    mpeLayoutRequest.store(packMpeLayout(mpeLayout));
+
+    MH_LOG(logger, info, midi, "MPE zones: lower {} members, upper {}, bend range {}", mpeLayout.lowerMembers,
+           mpeLayout.upperMembers, mpeLayout.memberBendRange);
+}
+
+void MindfulMIDI::handleConfigureMIDIInput(const elem::js::Value& args)
+{
+    const auto settings = midiInputSettingsFromJs(args, midiInputFilter.getSettings());
+    midiInputFilter.configure(settings);
+
+    MH_LOG(logger, info, midi, "MIDI input: drop mask {}, coalesce {}, max rate {} Hz", settings.dropMask,
+           settings.coalesce ? 1 : 0, settings.maxRateHz);
+}
+
+void MindfulMIDI::handleConfigureLogging(const elem::js::Value& args)
+{
+    const auto settings = logSettingsFromJs(args, logDrain->getSettings());
+    logDrain->configure(settings, mh::util::getUserDataDirectory().getChildFile(staticNames::LOG_DIRECTORY));
+
+    MH_LOG(logger, info, general, "Logging: level {}, category mask {}, sinks {}", static_cast<int>(settings.level),
+           settings.categoryMask, settings.sinks);
 }
-void MindfulMIDI::handleMidiOut(const std::string& _msg, int index)
+
+void MindfulMIDI::handleMidiOut(const std::string& _msg, const mh::MidiScheduler::Timing& timing,
+                                const mh::NoteExpression& expression)
 {
     // Split the string into three-two digit strings and parse from hex to unit8 bytes
     const juce::String msg(_msg);
@@ -307,34 +2185,41 @@ void MindfulMIDI::handleMidiOut(const std::string& _msg, int index)
             wrappedNN.push_back(static_cast<elem::js::Number>(nn));
         }
         tableContent.insert_or_assign( staticNames::NOTE_NUMBERS, wrappedNN );
-        // add the current chord to the current chord progression in tableContent state
-        // TODO: reset the chord progression from JS
+        // add the current chord to the current chord progression as a new version
         ChordNotes chordNote;
         chordNote.noteNumbers = noteNumbers;
-        chordsSoFar.push_back(chordNote);
+        chordNote.time = (juce::Time::getMillisecondCounterHiRes() - createdAtMs) * 0.001;
+        chordsSoFar.commit(chordsSoFar.head().push_back(chordNote));
 
-        if (midi_out_fifo_queue.push({messageOut, index}))
+        if (midi_out_fifo_queue.push({messageOut, timing, expression}))
+        {
+            MH_LOG(logger, info, midi, "MIDI Out > [ {}, {}, {} ]", noteNumbers[0], noteNumbers[1], noteNumbers[2]);
+        }
+        else
         {
-            dispatchLogToUI("MIDI Out > [ " + std::to_string(noteNumbers[0]) + ","
-                + std::to_string(noteNumbers[1]) + ","
-                + std::to_string(noteNumbers[2]) + " ]");
+            telemetry.add(mh::telemetry::Counter::midiOutDropped);
+            MH_LOG(logger, warn, midi, "MIDI Out FIFO full, dropped [ {}, {}, {} ]",
+                   noteNumbers[0], noteNumbers[1], noteNumbers[2]);
         }
+        telemetry.set(mh::telemetry::Gauge::midiOutFifo, midi_out_fifo_queue.getUsedSlots());
 
-        elem::js::Value wrappedChordProgression = mh::util::wrapChordsToJsValue(chordsSoFar);
-        tableContent.insert_or_assign( staticNames::CHORD_PROGRESSION, wrappedChordProgression  );
-        // notify the JS engine and View ( if its open )
-        // of new chord and chord progression
-        dispatchTableContentStateChange();
+        refreshChordProgression();
     }
     else
     {
-        dispatchLogToUI("MIDI Error: Message was not a 3 byte message.");
+        MH_LOG(logger, error, midi, "MIDI Error: Message was not a 3 byte message.");
     }
 }
 
 void MindfulMIDI::parameterValueChanged(int parameterIndex, float newValue)
 {
     // Mark the updated parameter value in the dirty list
+    // Fast path: graph nodes bound to this parameter pick the new value up on the
+    // next block, without waiting for the message thread or JS
+    const auto index = static_cast<size_t>(parameterIndex);
+    if (index < floatParams.size())
+        paramBindings.set(index, floatParams[index]->convertFrom0to1(newValue));
+
     auto& pr = *std::next(paramReadouts.begin(), parameterIndex);
     pr.store({newValue, true});
     triggerAsyncUpdate();
@@ -347,20 +2232,68 @@ void MindfulMIDI::parameterGestureChanged(int, bool)
 
 //==============================================================================
 void MindfulMIDI::handleAsyncUpdate()
+{
+    // Our turn comes when the scheduler has time for it, which with many
+    // instances open may be a tick or two later
+    if (runsUpdatesInLine)
+        runScheduledUpdate();
+    else
+        dispatchScheduler->submit(*this);
+}
+
+bool MindfulMIDI::isInForeground() const
+{
+    const auto* view = getActiveEditor();
+    return view != nullptr && view->isShowing();
+}
+
+void MindfulMIDI::runScheduledUpdate()
+{
+    const juce::ScopedLock engineScope(engineLock);
+
+    // While the host renders offline, processBlock runs the update itself and
+    // the view only has to catch up with what it did
+    if (!engineOnRenderThread.load())
+        runUpdate();
+
+    dispatchRenderedStateToView();
+}
+
+bool MindfulMIDI::initialiseEngineIfNeeded()
 {
     // First things first, we check the flag to identify if we should initialize the Elementary
     // runtime and engine.
-    if (shouldInitialize.exchange(false))
-    {
-        elementaryRuntime = std::make_unique<elem::Runtime<float>>(lastKnownSampleRate, lastKnownBlockSize);
-        initJavaScriptEngine();
-        runtimeSwapRequired.store(false);
-    }
+    if (!shouldInitialize.exchange(false))
+        return false;
+
+    // Node types have to be in place before the audio thread can see the runtime
+    auto runtime = std::make_unique<elem::Runtime<float>>(lastKnownSampleRate, lastKnownBlockSize);
+    registerNativeNodeTypes(*runtime);
+    publishRuntime(std::move(runtime));
+    initJavaScriptEngine();
+    runtimeSwapRequired.store(false);
+    return true;
+}
+
+void MindfulMIDI::runUpdate()
+{
+    telemetry.add(mh::telemetry::Counter::asyncUpdates);
+
+    const bool engineReset = initialiseEngineIfNeeded() || std::exchange(engineResetPending, false);
+    const bool everyBlock = engineOnRenderThread.load();
+
+    if (chordsRestored.exchange(false))
+        refreshChordProgression();
 
     // Next we iterate over the current parameter values to update our local state
     // object, which we in turn dispatch into the JavaScript engine
     auto& params = getParameters();
 
+    // Parameters read by `mh::param` nodes already reached the runtime directly, so
+    // the embedded engine only needs to hear about changes it might render from
+    bool anyParameterChanged = false;
+    bool onlyBoundParametersChanged = true;
+
     // Reduce over the changed parameters to resolve our updated processor state
     for (size_t i = 0; i < paramReadouts.size(); ++i)
     {
@@ -379,17 +2312,69 @@ void MindfulMIDI::handleAsyncUpdate()
                 auto paramId = pf->paramID.toStdString();
                 state.insert_or_assign(paramId, static_cast<elem::js::Number>(pr.value));
             }
+
+            anyParameterChanged = true;
+            onlyBoundParametersChanged = onlyBoundParametersChanged && paramBindings.isBound(i);
         }
     }
 
-    dispatchStateChange();
-    dispatchTableContentStateChange();
+    pollMidiFileJob();
+    pollVoicingJob();
+    pollPrograms();
+
+    // Offline this runs for every block, so the state only goes out when it changed
+    if (!everyBlock || anyParameterChanged || engineReset)
+        dispatchStateChange(!(anyParameterChanged && onlyBoundParametersChanged));
+    // A fresh engine has to hear about the table even if nothing changed
+    dispatchTableContentStateChange(engineReset);
     dispatchMIDItoJS();
+    dispatchChordToJS();
+}
+
+void MindfulMIDI::publishRuntime(std::unique_ptr<elem::Runtime<float>> runtime)
+{
+    collectRetiredRuntimes();
+
+#if MH_AUDIO_RATE_ELEMENTARY
+    // The last one published is still pending if the audio thread never picked
+    // it up, in which case it was never rendered and can go straight away
+    auto* skipped = pendingRuntime.exchange(runtime.get(), std::memory_order_acq_rel);
+
+    if (elementaryRuntime != nullptr && elementaryRuntime.get() != skipped)
+        replacedRuntimes.push_back(std::move(elementaryRuntime));
+#endif
+
+    elementaryRuntime = std::move(runtime);
+}
+
+void MindfulMIDI::collectRetiredRuntimes()
+{
+    elem::Runtime<float>* retired = nullptr;
+
+    while (retiredRuntimes.pop(retired))
+    {
+        std::erase_if(replacedRuntimes, [retired](const auto& runtime)
+        {
+            return runtime.get() == retired;
+        });
+    }
+}
+
+void MindfulMIDI::registerNativeNodeTypes(elem::Runtime<float>& runtime)
+{
+    // `mh::param` reads host parameters directly, see ParamNode.h
+    runtime.registerNodeType("mh::param", [this](elem::NodeId const id, double const sampleRate, int const blockSize)
+    {
+        return std::make_shared<mh::ParamNode<float>>(id, sampleRate, blockSize, paramBindings);
+    });
 }
 
 void MindfulMIDI::initJavaScriptEngine()
 {
-    jsEngine = choc::javascript::createQuickJSContext();
+    jsEngine = quickJS.createContext();
+
+    // A fresh engine gets a fresh start
+    scriptWatchdog.rearm();
 
     // initialise the fifos for midi messages
     midi_in_fifo_queue.reset(100);
@@ -398,7 +2383,35 @@ void MindfulMIDI::initJavaScriptEngine()
     // Install some native interop functions in our JavaScript environment
     jsEngine.registerFunction(staticNames::NATIVE_MESSAGE_FUNCTION_NAME, [this](choc::javascript::ArgumentList args)
     {
-        auto const batch = elem::js::parseJSON(args[0]->toString());
+        if (args.numArgs == 0 || !args[0]->isString())
+            return choc::value::Value();
+
+        // Packed batches decode straight into the instruction array; JSON is
+        // still accepted, see dsp/main.js
+        const auto message = args[0]->getString();
+        elem::js::Array batch;
+
+        if (mh::instructions::isPacked(message))
+        {
+            if (std::string error; !mh::instructions::unpack(message, batch, error))
+            {
+                dispatchError("Instruction Batch Error", error);
+                return choc::value::Value();
+            }
+        }
+        else
+        {
+            auto parsed = elem::js::parseJSON(std::string(message));
+
+            if (!parsed.isArray())
+            {
+                dispatchError("Instruction Batch Error", "Expected an array of instructions");
+                return choc::value::Value();
+            }
+
+            batch = parsed.getArray();
+        }
+
         auto const rc = elementaryRuntime->applyInstructions(batch);
 
         if (rc != elem::ReturnCode::Ok())
@@ -411,41 +2424,40 @@ void MindfulMIDI::initJavaScriptEngine()
 
     jsEngine.registerFunction(staticNames::LOG_FUNCTION_NAME, [this](choc::javascript::ArgumentList args)
     {
-        // Forward logs to the editor if it's available; then logs show up in one place.
-        //
-        // If not available, we fall back to std out.
-        if (auto* editor = dynamic_cast<WebViewEditor*>(getActiveEditor()))
-        {
-            const auto* kDispatchScript = R"script(
-(function() {
-  console.log(...JSON.parse(%));
-  return true;
-})();
-)script";
-            auto v = choc::value::createEmptyArray();
+        // The console shim passes a '[embedded:<level>]' tag first. Console output goes
+        // through the logger like everything else, so it lands in the editor console
+        // when open and stdout otherwise.
+        auto level = mh::logging::Level::info;
 
-            for (size_t i = 0; i < args.numArgs; ++i)
-            {
-                v.addArrayElement(*args[i]);
-            }
+        if (args.numArgs > 0 && args[0]->isString())
+        {
+            const auto tag = args[0]->getString();
 
-            auto expr = juce::String(kDispatchScript).replace("%", elem::js::serialize(choc::json::toString(v))).
-                                                      toStdString();
-            editor->getWebViewPtr()->evaluateJavascript(expr);
+            if (tag == "[embedded:warn]")
+                level = mh::logging::Level::warn;
+            else if (tag == "[embedded:error]")
+                level = mh::logging::Level::error;
         }
-        else
+
+        if (!logger.isEnabled(level, mh::logging::Category::engine))
+            return choc::value::Value();
+
+        std::string text;
+
+        for (size_t i = 0; i < args.numArgs; ++i)
         {
-            for (size_t i = 0; i < args.numArgs; ++i)
-            {
-                DBG(choc::json::toString(*args[i]));
-            }
+            if (i > 0)
+                text += ' ';
+
+            text += args[i]->isString() ? std::string(args[i]->getString()) : choc::json::toString(*args[i]);
         }
 
+        logger.writeText(level, mh::logging::Category::engine, text);
         return choc::value::Value();
     });
 
     // A simple shim to write various console operations to our native __log__ handler
-    jsEngine.evaluateExpression(R"shim(
+    evaluateInEngine(R"shim(
 (function() {
   if (typeof globalThis.console === 'undefined') {
     globalThis.console = {
@@ -461,7 +2473,7 @@ void MindfulMIDI::initJavaScriptEngine()
     };
   }
 })();
-    )shim");
+    )shim", mh::ScriptWatchdog::Script::dspMain);
 
     // Load and evaluate our Elementary js main file
 #if ELEM_DEV_LOCALHOST
@@ -475,7 +2487,8 @@ void MindfulMIDI::initJavaScriptEngine()
 
     auto dspEntryFileContents = dspEntryFile.loadFileAsString().toStdString();
 #endif
-    jsEngine.evaluateExpression(dspEntryFileContents);
+    if (!evaluateInEngine(dspEntryFileContents, mh::ScriptWatchdog::Script::dspMain))
+        return;
 
     // Re-hydrate from current state
     const auto* kHydrateScript = jsFunctions::hydrateScript;
@@ -483,11 +2496,13 @@ void MindfulMIDI::initJavaScriptEngine()
     auto expr = juce::String(kHydrateScript).replace("%", elem::js::serialize(
                                                          elem::js::serialize(elementaryRuntime->snapshot())))
                                             .toStdString();
-    jsEngine.evaluateExpression(expr);
+    evaluateInEngine(expr, mh::ScriptWatchdog::Script::hydrate);
 }
 
-void MindfulMIDI::dispatchStateChange()
+void MindfulMIDI::dispatchStateChange(const bool includeEngine)
 {
+    const mh::telemetry::Stats::Scope timed(telemetry, mh::telemetry::Section::stateDispatch);
+
     const auto* kDispatchScript = jsFunctions::receiveStateChangeScript;
 
     // Need the double serialize here to correctly form the string script. The first
@@ -495,94 +2510,212 @@ void MindfulMIDI::dispatchStateChange()
     // the % character in the above block and produce a valid javascript expression.
 
     state.insert_or_assign(staticNames::SAMPLE_RATE, lastKnownSampleRate);
+    editorSnapshot.setState(state);
 
-    const auto expr = juce::String(kDispatchScript).replace("%", elem::js::serialize(elem::js::serialize(state))).
-                                                    toStdString();
+    const auto expr = mh::EditorSnapshot::withPayload(kDispatchScript, editorSnapshot.getStateLiteral());
 
-    // First we try to dispatch to the UI if it's available
-    if (const auto* editor = dynamic_cast<WebViewEditor*>(getActiveEditor()))
+    // First we try to dispatch to the UI if it's available. Each state carries
+    // every parameter, so an unsent one is simply replaced
+    if (auto* queue = getViewQueue())
     {
-        editor->getWebViewPtr()->evaluateJavascript(expr);
+        queue->replace(mh::ViewDispatchQueue::Slot::state, expr);
     }
 
     // Next we dispatch to the embedded engine which will evaluate JavaScript
-    // here on the main thread
-    jsEngine.evaluateExpression(expr);
+    // here on the main thread, unless the change only touched parameters the
+    // graph already reads natively
+    if (includeEngine)
+        evaluateInEngine(expr, mh::ScriptWatchdog::Script::stateChange);
 }
 
-void MindfulMIDI::dispatchTableContentStateChange()
+void MindfulMIDI::dispatchTableContentStateChange(const bool force)
 {
+    const mh::telemetry::Stats::Scope timed(telemetry, mh::telemetry::Section::tableContentDispatch);
+
+    // Called on every async update, so only send the table when it changed
+    if (!editorSnapshot.takeTableContentChanged() && !force)
+        return;
+
     const auto* kDispatchScript = jsFunctions::receiveTableContentChangeScript;
-    elem::js::Object wrappedTableContent;
-    wrappedTableContent.insert_or_assign(staticNames::TABLE_CONTENT, tableContent);
+    const auto expr = mh::EditorSnapshot::withPayload(kDispatchScript, editorSnapshot.getTableContentLiteral());
+
+    // First we try to dispatch to the UI if it's available
+    if (auto* queue = getViewQueue())
+    {
+        queue->replace(mh::ViewDispatchQueue::Slot::tableContent, expr);
+    }
+    // Next we dispatch to the embedded engine which will evaluate JavaScript
+    // here on the main thread
+    evaluateInEngine(expr, mh::ScriptWatchdog::Script::tableContent);
+}
+
+mh::ViewDispatchQueue* MindfulMIDI::getViewQueue() const
+{
+    // The offline render thread reaches the dispatchers too, but the view is
+    // the message thread's; it catches up in dispatchRenderedStateToView
+    if (!juce::MessageManager::existsAndIsCurrentThread())
+        return nullptr;
+
+    if (const auto* view = dynamic_cast<WebViewEditor*>(getActiveEditor()))
+        return &view->getDispatchQueue();
+
+    return nullptr;
+}
+
+void MindfulMIDI::dispatchRenderedStateToView()
+{
+    if (!viewBehindRender.exchange(false))
+        return;
+
+    auto* queue = getViewQueue();
+
+    if (queue == nullptr)
+        return;
+
+    state.insert_or_assign(staticNames::SAMPLE_RATE, lastKnownSampleRate);
+    editorSnapshot.setState(state);
+
+    queue->replace(mh::ViewDispatchQueue::Slot::state,
+                   mh::EditorSnapshot::withPayload(jsFunctions::receiveStateChangeScript, editorSnapshot.getStateLiteral()));
+    queue->replace(mh::ViewDispatchQueue::Slot::tableContent,
+                   mh::EditorSnapshot::withPayload(jsFunctions::receiveTableContentChangeScript,
+                                                   editorSnapshot.getTableContentLiteral()));
+}
+
+void MindfulMIDI::dispatchEditorSnapshot()
+{
+    const mh::telemetry::Stats::Scope timed(telemetry, mh::telemetry::Section::snapshotDispatch);
+
+    auto* queue = getViewQueue();
+
+    if (queue == nullptr)
+        return;
+
+    // State is a handful of parameters, so it is cheap to bring up to date here
+    state.insert_or_assign(staticNames::SAMPLE_RATE, lastKnownSampleRate);
+    editorSnapshot.setState(state);
+
+    std::string payload = "{ state: ";
+    payload += editorSnapshot.getStateLiteral();
+    payload += ", tableContent: ";
+    payload += editorSnapshot.getTableContentLiteral();
+    payload += ", midi: ";
+    payload += editorSnapshot.getRecentMidiLiteral();
+    payload += " }";
+
+    // The page just loaded, so whatever was queued for the previous one is stale
+    queue->restart(mh::EditorSnapshot::withPayload(jsFunctions::editorSnapshotScript, payload));
+}
+
+void MindfulMIDI::dispatchLibraryContent()
+{
+    const mh::telemetry::Stats::Scope timed(telemetry, mh::telemetry::Section::libraryDispatch);
 
-    const auto expr = serialize(kDispatchScript, wrappedTableContent, "%");
+    const auto* kDispatchScript = jsFunctions::receiveLibraryContentScript;
+    elem::js::Object wrappedLibraryContent;
+    wrappedLibraryContent.insert_or_assign(staticNames::LIBRARY_CONTENT, libraryContent);
+
+    const auto expr = serialize(kDispatchScript, wrappedLibraryContent, "%");
 
     // First we try to dispatch to the UI if it's available
-    if (const auto* editor = dynamic_cast<WebViewEditor*>(getActiveEditor()))
+    if (auto* queue = getViewQueue())
     {
-        editor->getWebViewPtr()->evaluateJavascript(expr);
+        queue->replace(mh::ViewDispatchQueue::Slot::libraryContent, expr);
     }
     // Next we dispatch to the embedded engine which will evaluate JavaScript
     // here on the main thread
-    jsEngine.evaluateExpression(expr);
+    evaluateInEngine(expr, mh::ScriptWatchdog::Script::libraryContent);
 }
 
 //= Extended logging , so we can post debug messages directly in
-//= the plugin UI.
-void MindfulMIDI::dispatchLogToUI(const std::string& text) const
+//= the plugin UI. Called by the log drain with a batch of formatted lines.
+bool MindfulMIDI::dispatchLogBatchToUI(const std::vector<std::string>& lines) const
 {
-    const auto* kDispatchScript = jsFunctions::logToViewScript;
-    if (const auto* editor = dynamic_cast<WebViewEditor*>(getActiveEditor()))
+    // Lines join the editor's log batch, see createEditor for how it is sent.
+    // While the view is behind they go to stdout instead.
+    if (auto* queue = getViewQueue(); queue != nullptr && !queue->isBehind())
     {
-        const auto wrappedText = choc::value::createString(text);
-        const auto expr = serialize(kDispatchScript, wrappedText, "%");
-        editor->getWebViewPtr()->evaluateJavascript(expr);
+        for (const auto& line : lines)
+            queue->append(mh::ViewDispatchQueue::Batch::log, line);
+        return true;
     }
+    return false;
 }
 
 //= MIDI out to WebView and jsContext
 void MindfulMIDI::dispatchMIDItoJS()
 {
+    const mh::telemetry::Stats::Scope timed(telemetry, mh::telemetry::Section::midiDispatch);
+
     const uint32_t midiCount = midi_in_fifo_queue.getUsedSlots();
 
-    elem::js::Array vec;
+    // Raw notes only feed the editor's MIDI monitor; the engine hears about
+    // incoming harmony through dispatchChordToJS
+    auto* queue = getViewQueue();
+
+    if (midiCount == 0)
+        return;
+
+    // A view that is behind gets the newest notes once it catches up, not a backlog
+    if (queue != nullptr && queue->isBehind())
+        queue = nullptr;
 
-    if (midiCount > 0)
+    IncomingMIDIEvent m;
+    while (midi_in_fifo_queue.pop(m))
     {
-        IncomingMIDIEvent m;
-        while (midi_in_fifo_queue.pop(m))
-        {
-            vec.push_back(elem::js::Value(m.message.toHexString()));
-        };
-    }
+        auto hex = m.message.toHexString();
+        editorSnapshot.addIncomingMidi(hex);
 
-    const auto serializedMidi = elem::js::serialize(vec);
+        // Without an editor the snapshot keeps the recent history for when one
+        // opens. Messages merge into the editor's MIDI batch, see createEditor
+        if (queue != nullptr)
+            queue->append(mh::ViewDispatchQueue::Batch::midi, std::move(hex));
+    };
+}
 
-    const auto* kDispatchScript = jsFunctions::midi2jsScript;
+void MindfulMIDI::dispatchChordToJS()
+{
+    const mh::telemetry::Stats::Scope timed(telemetry, mh::telemetry::Section::chordDispatch);
 
-    // Need the double serialize here to correctly form the string script. The first
-    // serialize produces the payload we want, the second serialize ensures we can replace
-    // the % character in the above script block and produce a valid javascript expression.
-    const auto expr = juce::String(kDispatchScript).replace("%", elem::js::serialize(
-                                                                elem::js::serialize(serializedMidi))).
-                                                    toStdString();
+    mh::ChordDetector::Chord chord;
+    bool any = false;
 
-    // First we try to dispatch to the UI if it's available, because running this step will
-    // just involve placing a message in a queue.
-    if (const auto* editor = dynamic_cast<WebViewEditor*>(getActiveEditor()))
+    // Only the latest change matters if several queued up since the last update
+    while (chord_fifo_queue.pop(chord))
+        any = true;
+
+    if (!any)
+        return;
+
+    elem::js::Array notes;
+    for (const auto n : chord.getNotes())
+        notes.push_back(static_cast<elem::js::Number>(n));
+
+    elem::js::Object detected;
+    detected.insert_or_assign("name", chord.getName());
+    detected.insert_or_assign("root", chord.isChord() ? static_cast<elem::js::Number>(chord.root) : elem::js::Value());
+    detected.insert_or_assign("quality", elem::js::String(mh::ChordDetector::getQualitySuffix(chord.quality)));
+    detected.insert_or_assign("inversion", chord.inversion == mh::ChordDetector::otherBass
+                                               ? elem::js::Value()
+                                               : elem::js::Value(static_cast<elem::js::Number>(chord.inversion)));
+    detected.insert_or_assign("bass", static_cast<elem::js::Number>(chord.bass));
+    detected.insert_or_assign("notes", notes);
+
+    const auto expr = serialize(jsFunctions::chordDetectedScript, detected, "%");
+
+    if (auto* queue = getViewQueue())
     {
-        editor->getWebViewPtr()->evaluateJavascript(expr);
+        queue->replace(mh::ViewDispatchQueue::Slot::chord, expr);
     }
 
-    // Next we dispatch to the local engine which will evaluate any necessary JavaScript synchronously
-    // here on the main thread
-    jsEngine.evaluateExpression(expr);
+    evaluateInEngine(expr, mh::ScriptWatchdog::Script::chord);
 }
 
 
 void MindfulMIDI::dispatchError(std::string const& name, std::string const& message)
 {
+    const mh::telemetry::Stats::Scope timed(telemetry, mh::telemetry::Section::errorDispatch);
+
     const auto* kDispatchScript = jsFunctions::errorScript;
 
     // Need the serialize here to correctly form the string script.
@@ -591,14 +2724,167 @@ void MindfulMIDI::dispatchError(std::string const& name, std::string const& mess
 
     // First we try to dispatch to the UI if it's available, because running this step will
     // just involve placing a message in a queue.
-    if (auto* editor = dynamic_cast<WebViewEditor*>(getActiveEditor()))
+    if (auto* queue = getViewQueue())
     {
-        editor->getWebViewPtr()->evaluateJavascript(expr);
+        queue->push(expr);
     }
 
     // Next we dispatch to the local engine which will evaluate any necessary JavaScript synchronously
     // here on the main thread
-    jsEngine.evaluateExpression(expr);
+    evaluateInEngine(expr, mh::ScriptWatchdog::Script::error);
+}
+
+bool MindfulMIDI::evaluateInEngine(const std::string& expr, const mh::ScriptWatchdog::Script script)
+{
+    if (scriptWatchdog.isTripped() && !resumeScriptsIfCooledDown())
+        return false;
+
+    const mh::telemetry::Stats::Scope timed(telemetry, mh::telemetry::Section::evaluateExpression);
+    telemetry.add(mh::telemetry::Counter::engineEvaluations);
+    telemetry.add(mh::telemetry::Counter::engineScriptBytes, expr.size());
+
+    std::string failure;
+
+    {
+        const mh::ScriptWatchdog::Call call(scriptWatchdog, script);
+
+        try
+        {
+            jsEngine.evaluateExpression(expr);
+        }
+        catch (const std::exception& e)
+        {
+            failure = e.what();
+        }
+    }
+
+    if (scriptWatchdog.wasInterrupted())
+    {
+        handleScriptOverrun();
+        return false;
+    }
+
+    if (!failure.empty())
+    {
+        logger.writeText(mh::logging::Level::error, mh::logging::Category::engine,
+                         std::string(mh::ScriptWatchdog::toString(script)) + ": " + failure);
+        return false;
+    }
+
+    return true;
+}
+
+void MindfulMIDI::handleScriptOverrun()
+{
+    // Off first, so reporting the error doesn't run any more script
+    scriptWatchdog.trip();
+
+    const auto elapsedMs = std::chrono::duration<double, std::milli>(scriptWatchdog.getLastElapsed()).count();
+    const auto cooldownSeconds = std::chrono::duration<double>(scriptWatchdog.getCooldown()).count();
+    const auto message = std::string(mh::ScriptWatchdog::toString(scriptWatchdog.getLastScript())) + " was stopped after "
+                         + juce::String(elapsedMs, 1).toStdString() + " ms, " + scriptWatchdog.getInterruptReason()
+                         + ". Scripts are off for " + juce::String(cooldownSeconds, 0).toStdString()
+                         + " s and incoming MIDI passes straight through until then.";
+
+    MH_LOG(logger, error, engine, "Script stopped after {} ms, scripts are off for {} s", elapsedMs, cooldownSeconds);
+    dispatchError("Script Budget Exceeded", message);
+}
+
+bool MindfulMIDI::resumeScriptsIfCooledDown()
+{
+    if (!scriptWatchdog.rearmIfCooledDown())
+        return false;
+
+    // Reaches the view through the editor console sink, and the engine stats
+    // drop their resumesInMs
+    MH_LOG(logger, info, engine, "Scripts are back on after {} s off", std::chrono::duration<double>(scriptWatchdog.getCooldown()).count());
+    return true;
+}
+
+//= Telemetry, once a second from the StatsReporter
+void MindfulMIDI::dispatchStats()
+{
+    auto* queue = getViewQueue();
+
+    if (queue == nullptr && statsDump == nullptr)
+        return;
+
+    elem::js::Object view;
+
+    if (queue != nullptr)
+    {
+        const auto viewStats = queue->getStats();
+        telemetry.set(mh::telemetry::Gauge::viewQueued, viewStats.queued);
+        telemetry.set(mh::telemetry::Gauge::viewInFlight, viewStats.inFlight);
+
+        view.insert_or_assign("sent", static_cast<elem::js::Number>(viewStats.sent));
+        view.insert_or_assign("acknowledged", static_cast<elem::js::Number>(viewStats.acknowledged));
+        view.insert_or_assign("coalesced", static_cast<elem::js::Number>(viewStats.coalesced));
+        view.insert_or_assign("dropped", static_cast<elem::js::Number>(viewStats.dropped));
+        view.insert_or_assign("timedOut", static_cast<elem::js::Number>(viewStats.timedOut));
+        view.insert_or_assign("scriptBytes", static_cast<elem::js::Number>(viewStats.bytesSent));
+    }
+
+    // QuickJS walks its whole heap for this, so it is only done here, once a
+    // second, and under engineLock since an offline render may be running scripts
+    {
+        const juce::ScopedLock engineScope(engineLock);
+        const auto heap = quickJS.getMemoryUsage();
+        telemetry.set(mh::telemetry::Gauge::engineHeapBytes, static_cast<uint64_t>(heap.usedBytes));
+        telemetry.set(mh::telemetry::Gauge::engineHeapObjects, static_cast<uint64_t>(heap.objects));
+    }
+
+    auto stats = telemetry.snapshot();
+    stats.insert_or_assign("instance", static_cast<elem::js::Number>(instanceId));
+    stats.insert_or_assign("time", juce::Time::getCurrentTime().toISO8601(true).toStdString());
+    stats.insert_or_assign("logDropped", static_cast<elem::js::Number>(logger.getNumDropped()));
+    stats.insert_or_assign("view", view);
+    stats.insert_or_assign("engine", scriptWatchdog.snapshot());
+
+    // Shared by every instance in the process
+    const auto& schedulerStats = dispatchScheduler->getStats();
+    elem::js::Object scheduler;
+    scheduler.insert_or_assign("instances", static_cast<elem::js::Number>(dispatchScheduler->getNumClients()));
+    scheduler.insert_or_assign("ticks", static_cast<elem::js::Number>(schedulerStats.ticks));
+    scheduler.insert_or_assign("updates", static_cast<elem::js::Number>(schedulerStats.updates));
+    scheduler.insert_or_assign("deferred", static_cast<elem::js::Number>(schedulerStats.deferred));
+    scheduler.insert_or_assign("overdue", static_cast<elem::js::Number>(schedulerStats.overdue));
+    scheduler.insert_or_assign("lastTickMs", schedulerStats.lastTickMs);
+    scheduler.insert_or_assign("maxTickMs", schedulerStats.maxTickMs);
+    stats.insert_or_assign("scheduler", scheduler);
+
+    if (statsDump != nullptr)
+    {
+        statsDump->writeText(elem::js::serialize(stats) + "\n", false, false, nullptr);
+        statsDump->flush();
+    }
+
+    if (queue != nullptr)
+        queue->replace(mh::ViewDispatchQueue::Slot::stats, serialize(jsFunctions::statsScript, stats, "%"));
+}
+
+void MindfulMIDI::handleDumpStats(const std::string& path)
+{
+    statsDump.reset();
+
+    if (path.empty())
+        return;
+
+    // Appends, so a dump can be resumed across sessions
+    const auto file = mh::util::getUserDataDirectory().getChildFile(staticNames::TELEMETRY_DIRECTORY)
+                          .getChildFile(juce::String(path)).withFileExtension(staticNames::TELEMETRY_FILE_EXTENSION);
+    file.getParentDirectory().createDirectory();
+
+    auto stream = std::make_unique<juce::FileOutputStream>(file);
+
+    if (stream->failedToOpen())
+    {
+        dispatchError("Telemetry Error", "Could not write " + file.getFullPathName().toStdString());
+        return;
+    }
+
+    statsDump = std::move(stream);
+    MH_LOG(logger, info, state, "Telemetry dump started");
 }
 
 /*▮▮js▮▮▮▮▮▮frontend▮▮▮▮▮▮backend▮▮▮▮▮▮messaging▮▮▮▮▮▮
@@ -622,7 +2908,22 @@ std::string MindfulMIDI::serialize(const std::string& function, const choc::valu
 //==============================================================================
 void MindfulMIDI::getStateInformation(juce::MemoryBlock& destData)
 {
-    auto serialized = elem::js::serialize(state);
+    // The progression is read from the published snapshot, which is always a
+    // complete version no matter what the message thread is doing to the history
+    auto saved = state;
+    if (const auto snapshot = chordsSoFar.getSnapshot())
+        saved.insert_or_assign(staticNames::CHORD_PROGRESSION, mh::util::wrapChordsToJsValue(snapshot->data));
+
+    if (mpeLayout.isEnabled())
+        saved.insert_or_assign(staticNames::MPE_LAYOUT, mpeLayoutToJs(mpeLayout));
+
+    if (const auto settings = midiInputFilter.getSettings(); !(settings == mh::MidiInputFilter::Settings{}))
+        saved.insert_or_assign(staticNames::MIDI_INPUT_FILTER, midiInputSettingsToJs(settings));
+
+    if (const auto settings = logDrain->getSettings(); !(settings == mh::logging::LogDrain::Settings{}))
+        saved.insert_or_assign(staticNames::LOGGING, logSettingsToJs(settings));
+
+    auto serialized = elem::js::serialize(saved);
     destData.replaceAll((void*)serialized.c_str(), serialized.size());
 }
 
@@ -633,8 +2934,32 @@ void MindfulMIDI::setStateInformation(const void* data, int sizeInBytes)
         auto str = std::string(static_cast<const char*>(data), sizeInBytes);
         auto parsed = elem::js::parseJSON(str);
         auto o = parsed.getObject();
+
+        // State saved without zones plays without them
+        const auto mpe = o.find(staticNames::MPE_LAYOUT);
+        if (mpe != o.end() || mpeLayout.isEnabled())
+            handleConfigureMPE(mpe != o.end() ? mpeLayoutFromJs(mpe->second) : mh::MpeAllocator::Layout{});
+
+        // Likewise the input filter goes back to its defaults
+        const auto filter = o.find(staticNames::MIDI_INPUT_FILTER);
+        midiInputFilter.configure(filter != o.end() ? midiInputSettingsFromJs(filter->second, {})
+                                                    : mh::MidiInputFilter::Settings{});
+
+        // And logging, which the host may have restored before anything was logged
+        const auto logging = o.find(staticNames::LOGGING);
+        logDrain->configure(logging != o.end() ? logSettingsFromJs(logging->second, {}) : mh::logging::LogDrain::Settings{},
+                            mh::util::getUserDataDirectory().getChildFile(staticNames::LOG_DIRECTORY));
+
         for (auto& i : o)
         {
+            if (i.first == staticNames::CHORD_PROGRESSION)
+            {
+                chordsSoFar.commit(mh::util::unwrapChordsFromJsValue(i.second), "restored");
+                chordsRestored.store(true);
+                triggerAsyncUpdate();
+                continue;
+            }
+
             std::map<std::string, elem::js::Value>::iterator it;
             it = state.find(i.first);
             if (it != state.end())
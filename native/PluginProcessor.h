@@ -11,13 +11,35 @@
 #include <choc_SingleReaderSingleWriterFIFO.h>
 #include <elem/Runtime.h>
 
+#include "ChordDetector.h"
+#include "ChordLibrary.h"
+#include "DispatchScheduler.h"
+#include "EditorSnapshot.h"
+#include "ViewDispatchQueue.h"
+#include "Logger.h"
+#include "MidiFileStream.h"
+#include "MidiInputFilter.h"
+#include "MidiScheduler.h"
+#include "MpeAllocator.h"
+#include "ParamNode.h"
+#include "PersistentVector.h"
+#include "ProgramBank.h"
+#include "ProgressionPlayer.h"
+#include "QuickJSRuntime.h"
+#include "ScriptWatchdog.h"
+#include "SessionTrace.h"
+#include "SuggestionEngine.h"
+#include "Telemetry.h"
+#include "VoiceLeading.h"
+
 // Forward Declarations
 class WebViewEditor;
 
 //==============================================================================
 class MindfulMIDI final : public juce::AudioProcessor,
                           public juce::AudioProcessorParameter::Listener,
-                          private juce::AsyncUpdater
+                          private juce::AsyncUpdater,
+                          private mh::DispatchScheduler::Client
 
 {
 public:
@@ -37,7 +59,8 @@ public:
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
     void handleResetTableContent();
-    void handleMidiOut(const std::string& _msg, int index);
+    void handleMidiOut(const std::string& _msg, const mh::MidiScheduler::Timing& timing,
+                       const mh::NoteExpression& expression = {});
 
     //==============================================================================
     const juce::String getName() const override;
@@ -62,6 +85,10 @@ public:
     /** Implement the AsyncUpdater interface. */
     void handleAsyncUpdate() override;
     //==============================================================================
+    /** Implement the DispatchScheduler::Client interface. */
+    void runScheduledUpdate() override;
+    bool isInForeground() const override;
+    //==============================================================================
     /** Internal helper for initializing the embedded JS engine. */
     void initJavaScriptEngine();
     static std::string serialize(const std::string& function, const elem::js::Object& data,
@@ -69,10 +96,18 @@ public:
     static std::string serialize(const std::string& function, const choc::value::Value& data,
                           const juce::String& replacementChar = "%");
     //=== Dispatchers
-    void dispatchStateChange();
-    void dispatchTableContentStateChange();
+    void dispatchStateChange(bool includeEngine = true);
+    void dispatchTableContentStateChange(bool force = false);
+    void dispatchEditorSnapshot();
     void dispatchError(std::string const& name, std::string const& message);
-    void dispatchLogToUI( std::string const& text ) const;
+    bool dispatchLogBatchToUI(const std::vector<std::string>& lines) const;
+
+    //=== Logging
+    // Level, categories, sinks and rate come from the configureLogging bridge
+    // message and are saved with the plugin state. The file sink writes to
+    // logs/ under the user data directory.
+    mh::logging::Logger& getLogger() noexcept { return logger; }
+    void handleConfigureLogging(const elem::js::Value& args);
 
     //=== MIDI business
     void dispatchMIDItoJS( );
@@ -81,16 +116,119 @@ public:
     struct ChordNotes
     {
         std::vector<uint8_t> noteNumbers ={ 0, 0, 0 };
+        double time = 0; // seconds since the instance was created, or since the start of an imported file
+        bool operator==(const ChordNotes&) const = default;
     };
     struct TableContent
     {
         std::vector<ChordNotes> chordProgression = {};
     };
 
-    std::vector<ChordNotes> chordsSoFar;
+    // Every edit to the progression is a new version sharing structure with the
+    // last, so undo, redo and branching cost O(log n) rather than a deep copy
+    using ChordProgression = mh::PersistentVector<ChordNotes>;
+    mh::VersionHistory<ChordNotes> chordsSoFar;
+
+    //=== Chord progression library
+    // Paged results of the last query live next to tableContent and are
+    // dispatched through __receiveLibraryContent__
+    mh::ChordLibrary chordLibrary;
+    elem::js::Object libraryContent;
+
+    void handleLoadLibrary(const std::string& path);
+    void handleQueryLibrary(const std::vector<std::vector<uint8_t>>& chords, int page, int pageSize);
+    void dispatchLibraryContent();
+
+    //=== Standard MIDI File import / export of the chord log, run on a worker
+    // thread with progress dispatched through __receiveFileProgress__
+    void handleExportMIDIFile(const std::string& path);
+    void handleImportMIDIFile(const std::string& path);
+    void dispatchFileProgress(bool finished);
+
+    void handleUndoChords();
+    void handleRedoChords();
+    void handleCheckoutChords(uint32_t version);
+    void refreshChordProgression();
+
+    //=== Progression playback on the audio thread, following the host playhead.
+    // While it runs every edit to the progression is republished, carrying on
+    // from the current position rather than starting over.
+    mh::ProgressionPlayer progressionPlayer;
+    mh::ProgressionPlayer::Options playbackOptions;
+    elem::js::Value playbackRequest; // the options as given, stored with programs
+    bool playbackActive = false;
+    void handlePlayProgression(const elem::js::Value& options);
+    void handleStopProgression();
+    void publishPlayback(bool restart);
+
+    //=== Voice leading
+    // Voicings for a progression of chord symbols or pitch class sets are solved
+    // on the voicing workers and land in tableContent under "voicings". A request
+    // made while one is solving waits for it, and only the latest one is kept.
+    void handleVoiceLead(const elem::js::Value& args);
+
+    //=== Next chord suggestions
+    // The engine follows the chord log as it grows and replays it after any other
+    // edit. Suggestions go out through __receiveSuggestions__, only when the
+    // ranking changed, so new counts that keep the same order cost nothing.
+    mh::SuggestionEngine suggestionEngine;
+    ChordProgression followedChords;
+    std::vector<mh::SuggestionEngine::Suggestion> dispatchedSuggestions;
+    size_t numSuggestions = 5;
+    void handleSuggestChords(int count);
+    void seedSuggestions();
+    void followChordsForSuggestions();
+    void dispatchSuggestions(bool force);
+
+    //=== Program bank
+    // A program is a set of parameter values, a chord progression and the
+    // playback, MPE and MIDI input settings, kept in one bank file. Programs
+    // are decoded on a worker the first time they are needed, into immutable
+    // snapshots that stay cached, so switching back to one costs nothing. The
+    // host may select from any thread: the choice is recorded and applied on
+    // the next update, and of many made in between only the last one.
+    mh::ProgramBank programBank;
+    void handleLoadProgramBank(const std::string& path);
+    void handleStoreProgram(int index, const std::string& name);
+    void handleSelectProgram(int index);
+    void dispatchProgramList();
+
+    // The host asks for names from its own threads while the message thread
+    // may be remapping the bank, so it reads a copy published under the lock.
+    // Renames are queued the same way and written to the bank on the next update.
+    mutable juce::SpinLock programNamesLock;
+    std::shared_ptr<const std::vector<std::string>> programNames;
+    std::vector<std::pair<uint32_t, std::string>> pendingRenames;
+    void publishProgramNames();
+    void applyPendingRenames();
+
+    //=== Editor bridge
+    // Every editor message that changes processor state comes through here, so a
+    // session recording can capture it and a replay can feed it back
+    void handleBridgeMessage(const std::string& name, const elem::js::Value& args);
+
+    //=== Session record / replay
+    // A recording captures blocks, parameters and bridge messages to a trace file.
+    // replaySession runs one through a headless instance at full speed, compares
+    // the MIDI output and reports per stage timing. It is only for the
+    // MindfulMIDIReplay harness, which runs it in a process of its own with a
+    // temporary user data directory, see ReplayMain.cpp.
+    void handleStartRecording(const std::string& path);
+    void handleStopRecording();
+    static elem::js::Object replaySession(const juce::File& traceFile);
+
+    //=== Telemetry
+    // Counters, gauges and dispatcher timings for this instance, sent once a second
+    // through __receiveStats__ and, while a dump file is set, appended to it as
+    // one JSON object per line. An empty path stops the dump.
+    void handleDumpStats(const std::string& path);
+    void dispatchStats();
+    mh::telemetry::Stats& getStats() noexcept { return telemetry; }
 
     //=== State
     elem::js::Object state;
+    // The chord progression is not kept here, editorSnapshot serialises it
+    // incrementally from chordsSoFar
     elem::js::Object tableContent;
 
 private:
@@ -105,17 +243,139 @@ private:
 
     struct OutgoingMIDIEvent
     {
-        //MIDIClock::time_point time;
         choc::midi::ShortMessage message;
-        int index = 0;
+        mh::MidiScheduler::Timing timing;
+        mh::NoteExpression expression;
     };
     choc::fifo::SingleReaderSingleWriterFIFO<IncomingMIDIEvent> midi_in_fifo_queue;
     choc::fifo::SingleReaderSingleWriterFIFO<OutgoingMIDIEvent> midi_out_fifo_queue;
 
-
+    // Incoming MIDI is thinned out before it reaches midi_in_fifo_queue. The
+    // settings are kept by the filter itself and can change at any time.
+    mh::MidiInputFilter midiInputFilter;
+    void handleConfigureMIDIInput(const elem::js::Value& args);
+
+    // Incoming notes are recognised on the audio thread and only chord changes
+    // cross to the message thread, see dispatchChordToJS
+    mh::ChordDetector chordDetector;
+    choc::fifo::SingleReaderSingleWriterFIFO<mh::ChordDetector::Chord> chord_fifo_queue;
+    void dispatchChordToJS();
+
+    // Outgoing events leave the FIFO into the scheduler, which owns their timing
+    mh::MidiScheduler midiScheduler;
+    std::atomic<bool> schedulerClearRequested{false};
+    mh::MidiScheduler::Transport readTransport() const;
+
+    // Scheduled events pass through here on their way out, which spreads notes
+    // over MPE member channels once zones are configured. The layout is set on
+    // the message thread and handed to the audio thread packed in one word.
+    mh::MpeAllocator mpeAllocator;
+    mh::MpeAllocator::Layout mpeLayout;
+    std::atomic<uint32_t> mpeLayoutRequest{0};
+    void handleConfigureMPE(const mh::MpeAllocator::Layout& requested);
+
+
+
+    //=== MIDI files
+    using MidiFileJob = mh::smf::FileJob<ChordNotes>;
+    juce::ThreadPool fileWorkers { 1 };
+    std::unique_ptr<MidiFileJob> midiFileJob;
+    int lastDispatchedFilePercent = -1;
+    const double createdAtMs = juce::Time::getMillisecondCounterHiRes();
+    void pollMidiFileJob();
+
+    //=== Voice leading workers
+    using VoicingJob = mh::voicing::Job;
+    juce::ThreadPool voicingWorkers { juce::jlimit(1, 4, juce::SystemStats::getNumCpus() - 1) };
+    std::unique_ptr<VoicingJob> voicingJob;
+    std::unique_ptr<VoicingJob> queuedVoicingJob;
+    void pollVoicingJob();
+
+    //=== Program decoding
+    // A program decoded from the bank, ready to apply without parsing anything
+    struct Program
+    {
+        bool valid = false;
+        std::vector<std::pair<juce::AudioParameterFloat*, float>> parameters;
+        ChordProgression chords;
+        bool hasChords = false;
+        mh::MpeAllocator::Layout mpeLayout;
+        mh::MidiInputFilter::Settings inputFilter;
+        mh::ProgressionPlayer::Options playback;
+        elem::js::Value playbackRequest;
+        bool hasPlayback = false;
+    };
+    using ProgramJob = mh::ProgramJob<Program>;
+    juce::ThreadPool programWorkers { 1 };
+    std::unique_ptr<ProgramJob> programJob;
+    std::vector<std::shared_ptr<const Program>> decodedPrograms; // one per program in the bank
+    uint32_t programBankGeneration = 0; // decoded under an older one are discarded
+    std::atomic<int> numBankPrograms{0};
+    std::atomic<int> currentProgram{0};
+    std::atomic<int> programRequest{-1};
+    int programToApply = -1;
+    std::unique_ptr<Program> decodeProgram(const std::string& data) const;
+    elem::js::Object captureProgram() const;
+    void applyProgram(const Program& program);
+    void startProgramJob(uint32_t index);
+    void pollPrograms();
+    void resetDecodedPrograms();
+
+    //=== Editor hydration
+    // Kept current as state, table content and incoming MIDI change, and handed
+    // to a newly opened editor in one dispatch when it reports ready
+    mh::EditorSnapshot editorSnapshot;
+    std::atomic<bool> chordsRestored{false};
+
+    // The open editor's outbound queue, or nullptr without one
+    mh::ViewDispatchQueue* getViewQueue() const;
+
+    //=== Session recording
+    mh::trace::Recorder sessionRecorder;
+    struct TraceDrain;
+    std::unique_ptr<TraceDrain> traceDrain;
+
+    //=== Logging
+    mh::logging::Logger logger;
+    std::unique_ptr<mh::logging::LogDrain> logDrain;
+
+    //=== Telemetry
+    mh::telemetry::Stats telemetry;
+    const uint32_t instanceId;
+    struct StatsReporter;
+    std::unique_ptr<StatsReporter> statsReporter;
+    std::unique_ptr<juce::FileOutputStream> statsDump;
 
     //=== JS Engine
+    // Declared before jsEngine, which it creates
+    mh::QuickJSRuntime quickJS;
     choc::javascript::Context jsEngine;
+    // Every evaluation goes through here to be counted, timed and held to the
+    // watchdog's budget. An aborted script turns the engine off for a cooldown,
+    // leaving the instance as MIDI thru until the next evaluation after it.
+    mh::ScriptWatchdog scriptWatchdog;
+    bool evaluateInEngine(const std::string& expr, mh::ScriptWatchdog::Script script);
+    void handleScriptOverrun();
+    bool resumeScriptsIfCooledDown();
+
+    //=== Message thread scheduling
+    // Updates from every instance in the process take turns on the shared
+    // scheduler, see DispatchScheduler.h. A headless replay runs its own in line.
+    juce::SharedResourcePointer<mh::DispatchScheduler> dispatchScheduler;
+    bool runsUpdatesInLine = false;
+
+    //=== Offline rendering
+    // When the host renders offline, processBlock runs the update in line for
+    // every block instead of leaving it to the message loop, so bounces are
+    // deterministic and run as fast as the CPU allows. engineLock keeps the
+    // message thread out of the engine and the state it feeds meanwhile.
+    juce::CriticalSection engineLock;
+    std::atomic<bool> engineOnRenderThread{false};
+    std::atomic<bool> viewBehindRender{false};
+    bool engineResetPending = false;
+    bool initialiseEngineIfNeeded();
+    void runUpdate();
+    void dispatchRenderedStateToView();
 
     //=== Audio Engine
     std::atomic<bool> runtimeSwapRequired{false};
@@ -123,9 +383,42 @@ private:
     double lastKnownSampleRate = 0;
     int lastKnownBlockSize = 0;
     juce::AudioBuffer<float> scratchBuffer;
+
+    // Denormalised parameter values for `mh::param` nodes in the Elementary graph.
+    // Indexed like getParameters(); written straight from parameterValueChanged.
+    // Declared before the runtime so it outlives the nodes that reference it.
+    mh::ParamBindings paramBindings;
+    std::vector<juce::AudioParameterFloat*> floatParams;
+    void registerNativeNodeTypes(elem::Runtime<float>& runtime);
+
+    // The message thread owns the runtimes and talks to the newest one. The audio
+    // thread renders whichever it last adopted from pendingRuntime, and hands the
+    // one that replaced back through retiredRuntimes to be freed here, as
+    // ProgressionPlayer does with its arrangements.
     std::unique_ptr<elem::Runtime<float>> elementaryRuntime;
+    std::vector<std::unique_ptr<elem::Runtime<float>>> replacedRuntimes; // may still be rendering
+    std::atomic<elem::Runtime<float>*> pendingRuntime{nullptr};
+    choc::fifo::SingleReaderSingleWriterFIFO<elem::Runtime<float>*> retiredRuntimes;
+    elem::Runtime<float>* renderRuntime = nullptr; // audio thread
+    void publishRuntime(std::unique_ptr<elem::Runtime<float>> runtime);
+    void collectRetiredRuntimes();
+
+    // Audio rate Elementary processing. The runtime clears its outputs before it
+    // renders, so an input channel that is also an output has to be read from a
+    // copy in scratch; only input channels past the outputs are read in place.
+    // JUCE hands processBlock one buffer for both, so with this plugin's stereo
+    // in and out every input channel is copied and no copy is saved over the
+    // original design, only its allocation. Scratch is sized in prepareToPlay;
+    // blocks larger than the prepared size are processed in chunks rather than
+    // reallocating.
+    static constexpr int maxElementaryChannels = 32;
+    std::array<const float*, maxElementaryChannels> elementaryInputs{};
+    std::array<float*, maxElementaryChannels> elementaryOutputs{};
+    int preparedBlockSize = 0;
+    void processElementary(juce::AudioBuffer<float>& buffer);
     std::map<std::string, juce::AudioParameterFloat*> parameterMap;
 
+
     //==============================================================================
     // A simple "dirty list" abstraction here for propagating realtime parameter
     // value changes
@@ -150,6 +443,48 @@ namespace staticNames
     inline std::string LOG_FUNCTION_NAME = "__log__";
     inline std::string NOTE_NUMBERS = "noteNumbers";
     inline std::string CHORD_PROGRESSION = "chordProgression";
+    inline std::string CHORD_HISTORY = "chordHistory";
+    inline std::string LIBRARY_CONTENT = "libraryContent";
+    inline std::string LIBRARY_FILE_NAME = "library.mhcl";
+    inline std::string MIDI_FILE_NAME = "chords.mid";
+    inline std::string SESSIONS_DIRECTORY = "sessions";
+    inline std::string SESSION_FILE_EXTENSION = ".mhtrace";
+    inline std::string TELEMETRY_DIRECTORY = "telemetry";
+    inline std::string TELEMETRY_FILE_EXTENSION = ".jsonl";
+    inline std::string MPE_LAYOUT = "mpeLayout";
+    inline std::string MIDI_INPUT_FILTER = "midiInputFilter";
+    inline std::string LOGGING = "logging";
+    inline std::string LOG_DIRECTORY = "logs";
+    inline std::string VOICINGS = "voicings";
+    inline std::string PROGRAMS = "programs";
+    inline std::string PROGRAM_BANK_FILE_NAME = "programs.mhpb";
+    inline std::string PARAMETERS = "parameters";
+    inline std::string PLAYBACK_OPTIONS = "playbackOptions";
+}
+
+
+// Editor bridge messages, as named by the front end
+namespace bridgeMessages
+{
+    inline std::string SEND_MIDI = "sendMIDI";
+    inline std::string RESET_TABLE_CONTENT = "resetTableContent";
+    inline std::string LOAD_LIBRARY = "loadLibrary";
+    inline std::string QUERY_LIBRARY = "queryLibrary";
+    inline std::string EXPORT_MIDI_FILE = "exportMIDIFile";
+    inline std::string IMPORT_MIDI_FILE = "importMIDIFile";
+    inline std::string UNDO_CHORDS = "undoChords";
+    inline std::string REDO_CHORDS = "redoChords";
+    inline std::string CHECKOUT_CHORDS = "checkoutChords";
+    inline std::string CONFIGURE_MPE = "configureMPE";
+    inline std::string CONFIGURE_MIDI_INPUT = "configureMIDIInput";
+    inline std::string CONFIGURE_LOGGING = "configureLogging";
+    inline std::string PLAY_PROGRESSION = "playProgression";
+    inline std::string STOP_PROGRESSION = "stopProgression";
+    inline std::string VOICE_LEAD = "voiceLead";
+    inline std::string SUGGEST_CHORDS = "suggestChords";
+    inline std::string LOAD_PROGRAM_BANK = "loadProgramBank";
+    inline std::string STORE_PROGRAM = "storeProgram";
+    inline std::string SELECT_PROGRAM = "selectProgram";
 }
 
 
@@ -165,6 +500,44 @@ namespace jsFunctions
     })();
     )script";
 
+    inline auto chordDetectedScript = R"script(
+(function() {
+  if (typeof globalThis.__receiveChord__ !== 'function')
+    return false;
+
+  globalThis.__receiveChord__(%);
+  return true;
+})();
+)script";
+
+    inline auto statsScript = R"script(
+(function() {
+  if (typeof globalThis.__receiveStats__ !== 'function')
+    return false;
+
+  globalThis.__receiveStats__(%);
+  return true;
+})();
+)script";
+
+
+    inline auto editorSnapshotScript = R"script(
+(function() {
+  const snapshot = %;
+
+  if (typeof globalThis.__receiveStateChange__ === 'function')
+    globalThis.__receiveStateChange__(snapshot.state);
+
+  if (typeof globalThis.__receiveTableContent__ === 'function')
+    globalThis.__receiveTableContent__(snapshot.tableContent);
+
+  if (typeof globalThis.__receiveMIDI__ === 'function' && snapshot.midi !== '[]')
+    globalThis.__receiveMIDI__(snapshot.midi);
+
+  return true;
+})();
+)script";
+
     inline auto hydrateScript = R"script(
 (function() {
   if (typeof globalThis.__receiveHydrationData__ !== 'function')
@@ -198,12 +571,13 @@ namespace jsFunctions
 })();
 )script";
 
-    inline auto logToViewScript = R"script(
+    inline auto logBatchToViewScript = R"script(
 (function() {
     if (typeof globalThis.__receiveLog__ !== 'function')
         return false;
 
-    globalThis.__receiveLog__(%);
+    for (const line of %)
+        globalThis.__receiveLog__(line);
     return true;
     })();
 )script";
@@ -226,6 +600,36 @@ inline auto receiveStateChangeScript =     R"script(
   globalThis.__receiveTableContent__(%);
   return true;
 })();
+)script";
+
+    inline auto receiveLibraryContentScript =     R"script(
+(function() {
+  if (typeof globalThis.__receiveLibraryContent__ !== 'function')
+    return false;
+
+  globalThis.__receiveLibraryContent__(%);
+  return true;
+})();
+)script";
+
+    inline auto suggestionsScript =     R"script(
+(function() {
+  if (typeof globalThis.__receiveSuggestions__ !== 'function')
+    return false;
+
+  globalThis.__receiveSuggestions__(%);
+  return true;
+})();
+)script";
+
+    inline auto fileProgressScript =     R"script(
+(function() {
+  if (typeof globalThis.__receiveFileProgress__ !== 'function')
+    return false;
+
+  globalThis.__receiveFileProgress__(%);
+  return true;
+})();
 )script";
 
     inline auto vfsKeysScript = R"script(
@@ -0,0 +1,197 @@
+#include "ProgramBank.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace mh
+{
+    struct ProgramBank::FileHeader
+    {
+        char magic[4] = {'M', 'H', 'P', 'B'};
+        uint32_t version = 1;
+        uint32_t numPrograms = 0;
+        uint32_t reserved = 0;
+        uint64_t entriesOffset = 0;
+        uint64_t dataOffset = 0;
+    };
+
+    struct ProgramBank::Entry
+    {
+        char name[maxNameLength + 1] = {};
+        uint64_t offset = 0; // from dataOffset
+        uint64_t size = 0;
+    };
+
+    static constexpr uint32_t bankVersion = 1;
+
+    static uint64_t align8(const uint64_t offset) noexcept
+    {
+        return (offset + 7u) & ~uint64_t(7);
+    }
+
+    //==============================================================================
+    bool ProgramBank::open(const juce::File& bankFile)
+    {
+        close();
+
+        auto mapped = std::make_unique<juce::MemoryMappedFile>(bankFile, juce::MemoryMappedFile::readOnly);
+        const auto* base = static_cast<const char*>(mapped->getData());
+        const auto size = static_cast<uint64_t>(mapped->getSize());
+
+        if (base == nullptr || size < sizeof(FileHeader))
+            return false;
+
+        const auto* h = reinterpret_cast<const FileHeader*>(base);
+
+        if (std::memcmp(h->magic, "MHPB", 4) != 0 || h->version != bankVersion)
+            return false;
+
+        if (h->entriesOffset > size || h->numPrograms > (size - h->entriesOffset) / sizeof(Entry)
+            || h->dataOffset > size)
+            return false;
+
+        // Every program's data must lie inside the mapping before we hand out views of it
+        const auto* e = reinterpret_cast<const Entry*>(base + h->entriesOffset);
+        const auto dataSize = size - h->dataOffset;
+
+        for (uint32_t i = 0; i < h->numPrograms; ++i)
+            if (e[i].offset > dataSize || e[i].size > dataSize - e[i].offset)
+                return false;
+
+        mapping = std::move(mapped);
+        file = bankFile;
+        header = h;
+        entries = e;
+        return true;
+    }
+
+    void ProgramBank::close()
+    {
+        header = nullptr;
+        entries = nullptr;
+        mapping.reset();
+        file = juce::File();
+    }
+
+    uint32_t ProgramBank::getNumPrograms() const noexcept
+    {
+        return header != nullptr ? header->numPrograms : 0;
+    }
+
+    std::string ProgramBank::getName(const uint32_t index) const
+    {
+        if (index >= getNumPrograms())
+            return {};
+
+        const auto& name = entries[index].name;
+        return {name, strnlen(name, sizeof(name))};
+    }
+
+    std::string_view ProgramBank::getData(const uint32_t index) const noexcept
+    {
+        if (index >= getNumPrograms())
+            return {};
+
+        const auto* data = static_cast<const char*>(mapping->getData()) + header->dataOffset + entries[index].offset;
+        return {data, static_cast<size_t>(entries[index].size)};
+    }
+
+    //==============================================================================
+    std::vector<ProgramBank::Program> ProgramBank::readAll() const
+    {
+        std::vector<Program> programs;
+        programs.reserve(getNumPrograms());
+
+        for (uint32_t i = 0; i < getNumPrograms(); ++i)
+            programs.push_back({getName(i), std::string(getData(i))});
+
+        return programs;
+    }
+
+    bool ProgramBank::replaceWith(const juce::File destination, const std::vector<Program>& programs)
+    {
+        // The mapping has to go before the file under it can be replaced. The
+        // destination is a copy, as it may be this bank's own file, which close() clears.
+        juce::TemporaryFile temp(destination);
+
+        if (!write(temp.getFile(), programs))
+            return false;
+
+        close();
+
+        // Whatever is at the destination now, the old bank or the new one, is reopened
+        const auto replaced = temp.overwriteTargetFileWithTemporary();
+        return open(destination) && replaced;
+    }
+
+    bool ProgramBank::store(const juce::File& destination, const uint32_t index, const Program& program)
+    {
+        auto programs = destination == file ? readAll() : std::vector<Program>();
+
+        if (index > programs.size())
+            return false;
+
+        if (index == programs.size())
+            programs.push_back(program);
+        else
+            programs[index] = program;
+
+        return replaceWith(destination, programs);
+    }
+
+    bool ProgramBank::rename(const uint32_t index, const std::string& name)
+    {
+        if (index >= getNumPrograms())
+            return false;
+
+        auto programs = readAll();
+        programs[index].name = name;
+        return replaceWith(file, programs);
+    }
+
+    bool ProgramBank::write(const juce::File& destination, const std::vector<Program>& programs)
+    {
+        FileHeader h;
+        h.version = bankVersion;
+        h.numPrograms = static_cast<uint32_t>(programs.size());
+        h.entriesOffset = align8(sizeof(FileHeader));
+        h.dataOffset = align8(h.entriesOffset + programs.size() * sizeof(Entry));
+
+        std::vector<Entry> index(programs.size());
+        uint64_t offset = 0;
+
+        for (size_t i = 0; i < programs.size(); ++i)
+        {
+            const auto& name = programs[i].name;
+            std::memcpy(index[i].name, name.data(), std::min(name.size(), maxNameLength));
+            index[i].offset = offset;
+            index[i].size = programs[i].data.size();
+            offset = align8(offset + programs[i].data.size());
+        }
+
+        destination.deleteFile();
+        juce::FileOutputStream out(destination);
+
+        if (!out.openedOk())
+            return false;
+
+        const auto padTo = [&out](const uint64_t position)
+        {
+            while (static_cast<uint64_t>(out.getPosition()) < position)
+                out.writeByte(0);
+        };
+
+        out.write(&h, sizeof(h));
+        padTo(h.entriesOffset);
+        out.write(index.data(), index.size() * sizeof(Entry));
+
+        for (size_t i = 0; i < programs.size(); ++i)
+        {
+            padTo(h.dataOffset + index[i].offset);
+            out.write(programs[i].data.data(), programs[i].data.size());
+        }
+
+        out.flush();
+        return out.getStatus().wasOk();
+    }
+} // namespace mh
@@ -0,0 +1,113 @@
+#ifndef PROGRAMBANK_H
+#define PROGRAMBANK_H
+
+#include <juce_core/juce_core.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mh
+{
+    //==============================================================================
+    // A bank of programs in a single memory-mapped file. Opening it reads only
+    // the header and the index, which holds every program's name, so a host can
+    // list hundreds of programs without any of them being touched. A program's
+    // data is paged in when it is first asked for; what it holds is up to the
+    // caller, the bank only stores it.
+    //
+    // Layout (little endian, 8 byte aligned sections):
+    //   FileHeader
+    //   Entry[numPrograms]   name, offset and size of each program's data
+    //   data                 every program's data back to back
+    //
+    // The bank is read only once open. Storing a program writes the whole bank
+    // aside and swaps it in, so a failed write leaves the old one in place.
+    class ProgramBank
+    {
+    public:
+        static constexpr size_t maxNameLength = 63;
+
+        struct Program
+        {
+            std::string name;
+            std::string data;
+        };
+
+        ProgramBank() = default;
+
+        bool open(const juce::File& file);
+        void close();
+        bool isOpen() const noexcept { return header != nullptr; }
+        juce::File getFile() const { return file; }
+
+        uint32_t getNumPrograms() const noexcept;
+        std::string getName(uint32_t index) const;
+
+        // Points into the mapping, valid until the bank is closed or stored to
+        std::string_view getData(uint32_t index) const noexcept;
+
+        // Replaces program `index`, or appends one when it is getNumPrograms(),
+        // in `destination`, which is this bank's file or a new one, and opens it
+        bool store(const juce::File& destination, uint32_t index, const Program& program);
+        bool rename(uint32_t index, const std::string& name);
+
+        static bool write(const juce::File& destination, const std::vector<Program>& programs);
+
+    private:
+        struct FileHeader;
+        struct Entry;
+
+        std::vector<Program> readAll() const;
+        bool replaceWith(juce::File destination, const std::vector<Program>& programs);
+
+        juce::File file;
+        std::unique_ptr<juce::MemoryMappedFile> mapping;
+        const FileHeader* header = nullptr;
+        const Entry* entries = nullptr;
+    };
+
+    //==============================================================================
+    // Decodes one program on a worker. The data is copied out of the bank when the
+    // job is made, so the bank can be stored to or replaced while it runs. What it
+    // decodes to is up to the caller, as the data is. `notify` is called from the
+    // worker once the program is ready.
+    template <typename Decoded>
+    class ProgramJob final : public juce::ThreadPoolJob
+    {
+    public:
+        using Decoder = std::function<std::shared_ptr<const Decoded>(const std::string& data)>;
+
+        ProgramJob(const uint32_t i, const uint32_t g, std::string d, Decoder dec, std::function<void()> n)
+            : juce::ThreadPoolJob("Program"), index(i), generation(g), data(std::move(d)), decode(std::move(dec)),
+              notify(std::move(n))
+        {
+        }
+
+        JobStatus runJob() override
+        {
+            program = decode(data);
+            finished.store(true);
+            notify();
+            return jobHasFinished;
+        }
+
+        const uint32_t index;
+        const uint32_t generation; // the owner's count of bank changes when the job was made
+        std::atomic<bool> finished { false };
+
+        // Only read by the owner after `finished`
+        std::shared_ptr<const Decoded> program;
+
+    private:
+        const std::string data;
+        const Decoder decode;
+        const std::function<void()> notify;
+    };
+} // namespace mh
+
+#endif //PROGRAMBANK_H
@@ -0,0 +1,140 @@
+#include "ProgressionPlayer.h"
+
+namespace mh
+{
+    namespace
+    {
+        // Sorted and deduplicated, inverted and transposed, then clipped to the MIDI range
+        std::vector<int> voice(const std::vector<uint8_t>& notes, const ProgressionPlayer::Voicing& voicing)
+        {
+            std::vector<int> voiced(notes.begin(), notes.end());
+            std::sort(voiced.begin(), voiced.end());
+            voiced.erase(std::unique(voiced.begin(), voiced.end()), voiced.end());
+
+            if (voiced.empty())
+                return voiced;
+
+            for (int i = 0; i < voicing.inversion; ++i)
+            {
+                voiced.push_back(voiced.front() + 12);
+                voiced.erase(voiced.begin());
+            }
+
+            for (int i = 0; i > voicing.inversion; --i)
+            {
+                voiced.insert(voiced.begin(), voiced.back() - 12);
+                voiced.pop_back();
+            }
+
+            for (auto& note : voiced)
+                note += 12 * voicing.octave;
+
+            voiced.erase(std::remove_if(voiced.begin(), voiced.end(), [](const int n) { return n < 0 || n > 127; }),
+                         voiced.end());
+            std::sort(voiced.begin(), voiced.end());
+            voiced.erase(std::unique(voiced.begin(), voiced.end()), voiced.end());
+            return voiced;
+        }
+    }
+
+    //==============================================================================
+    void ProgressionPlayer::Builder::add(const std::vector<uint8_t>& bytes, const double timeSeconds)
+    {
+        if (bytes.size() == 3 && bytes[0] >= 0x80)
+        {
+            // A raw message, of which only note-ons make chords
+            if ((bytes[0] & 0xF0) != 0x90 || bytes[2] == 0)
+                return;
+
+            if (groups.empty() || !groups.back().open || timeSeconds - groups.back().time > groupSeconds)
+                groups.push_back({timeSeconds, {}, 0, true});
+
+            auto& group = groups.back();
+            group.notes.push_back(static_cast<uint8_t>(bytes[1] & 0x7F));
+            group.velocity = std::max(group.velocity, static_cast<uint8_t>(bytes[2] & 0x7F));
+            return;
+        }
+
+        // A chord as a list of note numbers
+        groups.push_back({timeSeconds, bytes, 0, false});
+    }
+
+    std::unique_ptr<ProgressionPlayer::Arrangement> ProgressionPlayer::Builder::build(const Options& options,
+                                                                                      const bool restart) const
+    {
+        auto arrangement = std::make_unique<Arrangement>();
+        arrangement->loop = options.loop;
+        arrangement->alignBeats = std::max(0.0, options.alignBeats);
+        arrangement->channel = static_cast<uint8_t>(options.channel & 0x0F);
+        arrangement->restart = restart;
+
+        const auto gate = std::clamp(options.gate, 0.05, 1.0);
+        const auto end = std::min(options.to, groups.size());
+        double position = 0;
+        size_t step = 0;
+
+        for (auto i = options.from; i < end; ++i)
+        {
+            const auto& group = groups[i];
+            const auto voiced = voice(group.notes, options.voicings.empty()
+                                                       ? Voicing{}
+                                                       : options.voicings[step % options.voicings.size()]);
+            if (voiced.empty())
+                continue;
+
+            const auto beats = options.durations.empty()
+                                   ? 4.0
+                                   : std::clamp(options.durations[step % options.durations.size()], 1.0 / 64.0, 1024.0);
+
+            Chord chord;
+            chord.numNotes = static_cast<uint8_t>(std::min(voiced.size(), maxNotes));
+            std::copy_n(voiced.begin(), chord.numNotes, chord.notes.begin());
+
+            const auto velocity = options.velocities.empty()
+                                      ? (group.velocity > 0 ? group.velocity : 100)
+                                      : options.velocities[step % options.velocities.size()];
+            chord.velocity = static_cast<uint8_t>(std::clamp<int>(velocity, 1, 127));
+
+            chord.start = position;
+            chord.noteOff = position + beats * gate;
+            position += beats;
+
+            arrangement->chords.push_back(chord);
+            ++step;
+        }
+
+        arrangement->totalBeats = position;
+        return arrangement;
+    }
+
+    //==============================================================================
+    ProgressionPlayer::ProgressionPlayer()
+    {
+        retired.reset(16);
+    }
+
+    ProgressionPlayer::~ProgressionPlayer()
+    {
+        collectRetired();
+        delete pending.exchange(nullptr);
+        delete current;
+    }
+
+    void ProgressionPlayer::publish(std::unique_ptr<Arrangement> arrangement)
+    {
+        collectRetired();
+
+        if (arrangement == nullptr)
+            arrangement = std::make_unique<Arrangement>();
+
+        // One the audio thread never picked up can go straight away
+        delete pending.exchange(arrangement.release(), std::memory_order_acq_rel);
+    }
+
+    void ProgressionPlayer::collectRetired()
+    {
+        Arrangement* arrangement = nullptr;
+        while (retired.pop(arrangement))
+            delete arrangement;
+    }
+} // namespace mh
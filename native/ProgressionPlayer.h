@@ -0,0 +1,350 @@
+#ifndef PROGRESSIONPLAYER_H
+#define PROGRESSIONPLAYER_H
+
+#include <choc_MIDI.h>
+#include <choc_SingleReaderSingleWriterFIFO.h>
+
+#include "MidiScheduler.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace mh
+{
+    //==============================================================================
+    // Plays the captured chord progression on the audio thread, locked to the
+    // host playhead: positions come from the host PPQ and tempo every block, so
+    // playback follows relocations, tempo changes and loop points, and every
+    // chord lands on its exact sample at any buffer size.
+    //
+    // The message thread turns the progression into an Arrangement, with the
+    // per-chord durations, voicings and velocities already applied, and
+    // publishes it. The audio thread adopts the newest one at the top of a block
+    // and hands the old one back to be deleted on the message thread, so an edit
+    // during playback never blocks or allocates on the audio thread.
+    class ProgressionPlayer
+    {
+    public:
+        static constexpr size_t maxNotes = 16;
+
+        struct Voicing
+        {
+            int8_t inversion = 0; // > 0 moves the lowest notes up an octave, < 0 the highest down
+            int8_t octave = 0;
+        };
+
+        struct Options
+        {
+            // Chords [from, to) of the progression
+            size_t from = 0;
+            size_t to = std::numeric_limits<size_t>::max();
+
+            // Patterns, each cycled over the chords. No velocities plays them as captured.
+            std::vector<double> durations;  // beats
+            std::vector<Voicing> voicings;
+            std::vector<uint8_t> velocities;
+
+            double gate = 0.95;     // fraction of each chord's duration it is held for
+            bool loop = true;
+            double alignBeats = 4;  // start on the next multiple of this many beats, 0 ties beat 0 to the song start
+            uint8_t channel = 0;
+        };
+
+        struct Chord
+        {
+            std::array<uint8_t, maxNotes> notes{};
+            uint8_t numNotes = 0;
+            uint8_t velocity = 100;
+            double start = 0; // beats from the top of the arrangement
+            double noteOff = 0;
+        };
+
+        // Immutable once published
+        struct Arrangement
+        {
+            std::vector<Chord> chords; // ordered by start
+            double totalBeats = 0;
+            bool loop = true;
+            double alignBeats = 4;
+            uint8_t channel = 0;
+            bool restart = true; // from the top, rather than carrying on from the current position
+        };
+
+        //==============================================================================
+        // Message thread. Groups a captured log into chords, the way the MIDI file
+        // export does: note-ons sent within `groupSeconds` of each other are one
+        // chord, and note lists (imports) are a chord each.
+        class Builder
+        {
+        public:
+            explicit Builder(double groupSeconds = 0.03) : groupSeconds(groupSeconds) {}
+
+            void add(const std::vector<uint8_t>& bytes, double timeSeconds);
+            std::unique_ptr<Arrangement> build(const Options& options, bool restart) const;
+
+            size_t getNumChords() const noexcept { return groups.size(); }
+            const std::vector<uint8_t>& getChordNotes(const size_t index) const { return groups[index].notes; }
+
+        private:
+            struct Group
+            {
+                double time = 0;
+                std::vector<uint8_t> notes;
+                uint8_t velocity = 0;
+                bool open = true;
+            };
+
+            const double groupSeconds;
+            std::vector<Group> groups;
+        };
+
+        ProgressionPlayer();
+        ~ProgressionPlayer();
+
+        // Message thread. Replaces whatever is playing; nullptr stops.
+        void publish(std::unique_ptr<Arrangement> arrangement);
+
+        //==============================================================================
+        // Audio thread. Calls emit(sampleOffset, message) for every note the block
+        // starts or ends, in time order.
+        template <typename EmitFn>
+        void process(const MidiScheduler::Transport& transport, const int numSamples, EmitFn&& emit) noexcept
+        {
+            if (numSamples <= 0)
+                return;
+
+            Block<EmitFn> block{*this, emit, numSamples - 1};
+            adoptPending(block);
+
+            if (current == nullptr || current->chords.empty() || current->totalBeats <= 0 || !transport.hasGrid())
+            {
+                block.releaseAll(0);
+                wasRunning = false;
+                return;
+            }
+
+            const auto samplesPerBeat = transport.samplesPerBeat();
+            const auto ppq = transport.ppqPosition;
+            const auto blockBeats = numSamples / samplesPerBeat;
+
+            if (!anchored)
+            {
+                const auto align = current->alignBeats;
+                anchorPpq = align > 0 ? std::ceil(ppq / align - 1.0e-9) * align : 0.0;
+                anchored = true;
+            }
+
+            // Started, relocated, or the host wrapped its loop without telling us.
+            // The slack absorbs hosts that round their positions.
+            if (!wasRunning || std::abs(ppq - expectedPpq) > std::max(4.0 / samplesPerBeat, 1.0e-3))
+            {
+                block.releaseAll(0);
+                needsLocate = true;
+            }
+
+            wasRunning = true;
+            expectedPpq = ppq + blockBeats;
+
+            // A block crossing the end of the host loop carries on from its start
+            if (transport.isLooping && transport.loopEndPpq > transport.loopStartPpq
+                && ppq < transport.loopEndPpq && expectedPpq > transport.loopEndPpq)
+            {
+                const auto wrapSample = (transport.loopEndPpq - ppq) * samplesPerBeat;
+                block.render(ppq, transport.loopEndPpq, 0, samplesPerBeat);
+
+                block.releaseAll(block.toOffset(wrapSample));
+                needsLocate = true;
+
+                expectedPpq = transport.loopStartPpq + (expectedPpq - transport.loopEndPpq);
+                block.render(transport.loopStartPpq, expectedPpq, wrapSample, samplesPerBeat);
+                return;
+            }
+
+            block.render(ppq, expectedPpq, 0, samplesPerBeat);
+        }
+
+        bool isPlaying() const noexcept { return playing.load(std::memory_order_relaxed); }
+
+    private:
+        // One block's worth of rendering, so the emit function doesn't have to be
+        // threaded through every step
+        template <typename EmitFn>
+        struct Block
+        {
+            ProgressionPlayer& player;
+            EmitFn& emit;
+            const int lastSample;
+
+            int toOffset(const double sample) const noexcept
+            {
+                return std::clamp(static_cast<int>(std::floor(sample)), 0, lastSample);
+            }
+
+            void releaseAll(const int offset) noexcept
+            {
+                auto& p = player;
+
+                for (uint8_t i = 0; i < p.numSounding; ++i)
+                    emit(offset, choc::midi::ShortMessage(static_cast<uint8_t>(0x80 | p.soundingChannel), p.sounding[i], 0));
+
+                p.numSounding = 0;
+            }
+
+            void start(const Chord& chord, const int offset) noexcept
+            {
+                auto& p = player;
+                releaseAll(offset);
+
+                p.soundingChannel = p.current->channel;
+                p.soundingOff = chord.noteOff;
+
+                for (uint8_t i = 0; i < chord.numNotes; ++i)
+                {
+                    emit(offset, choc::midi::ShortMessage(static_cast<uint8_t>(0x90 | p.soundingChannel), chord.notes[i], chord.velocity));
+                    p.sounding[p.numSounding++] = chord.notes[i];
+                }
+            }
+
+            // Host positions [from, to), the first of them at `firstSample` in the block
+            void render(const double from, const double to, const double firstSample, const double samplesPerBeat) noexcept
+            {
+                const auto& arrangement = *player.current;
+                const auto total = arrangement.totalBeats;
+
+                auto a = from - player.anchorPpq;
+                auto b = to - player.anchorPpq;
+                auto sample = firstSample;
+
+                if (b <= 0)
+                    return;
+
+                // Starting exactly on beat 0 later in this block
+                if (a < 0)
+                {
+                    sample += -a * samplesPerBeat;
+                    a = 0;
+                    player.needsLocate = false;
+                }
+
+                if (!arrangement.loop)
+                {
+                    if (a >= total)
+                    {
+                        releaseAll(toOffset(sample));
+                        return;
+                    }
+
+                    span(a, std::min(b, total), sample, samplesPerBeat);
+
+                    if (b >= total)
+                        releaseAll(toOffset(sample + (total - a) * samplesPerBeat));
+                    return;
+                }
+
+                // Looping, the span is split wherever it passes the end of the arrangement
+                const auto cycle = std::floor(a / total);
+                a -= cycle * total;
+                b -= cycle * total;
+
+                while (a < b)
+                {
+                    const auto end = std::min(b, total);
+                    span(a, end, sample, samplesPerBeat);
+                    sample += (end - a) * samplesPerBeat;
+
+                    if (end < b)
+                        releaseAll(toOffset(sample));
+
+                    a = 0;
+                    b -= total;
+                }
+            }
+
+            // Arrangement positions [a, b), with a at `sample`, inside one cycle
+            void span(const double a, const double b, const double sample, const double samplesPerBeat) noexcept
+            {
+                auto& p = player;
+                const auto& chords = p.current->chords;
+                const auto at = [&](const double position) { return toOffset(sample + (position - a) * samplesPerBeat); };
+
+                const auto next = std::lower_bound(chords.begin(), chords.end(), a,
+                                                   [](const Chord& c, const double position) { return c.start < position; });
+
+                // Coming in part way through a chord plays it from here
+                if (std::exchange(p.needsLocate, false) && next != chords.begin())
+                {
+                    const auto& previous = *std::prev(next);
+                    if (a < previous.noteOff)
+                        start(previous, at(a));
+                }
+
+                if (p.numSounding > 0 && p.soundingOff < b && (next == chords.end() || p.soundingOff < next->start))
+                    releaseAll(at(std::max(a, p.soundingOff)));
+
+                for (auto chord = next; chord != chords.end() && chord->start < b; ++chord)
+                {
+                    start(*chord, at(chord->start));
+
+                    // Held to the next chord, starting that one releases it
+                    const auto following = std::next(chord);
+                    if (chord->noteOff < b && (following == chords.end() || chord->noteOff < following->start))
+                        releaseAll(at(chord->noteOff));
+                }
+            }
+        };
+
+        template <typename EmitFn>
+        void adoptPending(Block<EmitFn>& block) noexcept
+        {
+            // Only swap when the old arrangement can be handed back
+            if (pending.load(std::memory_order_relaxed) == nullptr || retired.getFreeSlots() == 0)
+                return;
+
+            auto* next = pending.exchange(nullptr, std::memory_order_acq_rel);
+
+            if (next == nullptr)
+                return;
+
+            block.releaseAll(0);
+
+            if (next->chords.empty() || next->restart || current == nullptr || current->chords.empty())
+                anchored = false;
+
+            if (current != nullptr)
+                retired.push(current);
+
+            current = next;
+            needsLocate = true;
+            playing.store(!current->chords.empty(), std::memory_order_relaxed);
+        }
+
+        void collectRetired();
+
+        // An empty arrangement stands for stopped, so nullptr only ever means nothing pending
+        std::atomic<Arrangement*> pending{nullptr};
+        choc::fifo::SingleReaderSingleWriterFIFO<Arrangement*> retired;
+        std::atomic<bool> playing{false};
+
+        // Audio thread
+        Arrangement* current = nullptr;
+        double anchorPpq = 0;
+        double expectedPpq = 0;
+        bool anchored = false;
+        bool wasRunning = false;
+        bool needsLocate = true;
+
+        std::array<uint8_t, maxNotes> sounding{};
+        uint8_t numSounding = 0;
+        uint8_t soundingChannel = 0;
+        double soundingOff = 0;
+    };
+} // namespace mh
+
+#endif //PROGRESSIONPLAYER_H
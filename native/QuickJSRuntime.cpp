@@ -0,0 +1,60 @@
+#include "QuickJSRuntime.h"
+
+#include <choc_javascript_QuickJS.h>
+
+namespace mh
+{
+    namespace quickjs = choc::javascript::quickjs;
+
+    namespace
+    {
+        quickjs::JSRuntime* toRuntime(void* runtime) noexcept
+        {
+            return static_cast<quickjs::JSRuntime*>(runtime);
+        }
+    }
+
+    choc::javascript::Context QuickJSRuntime::createContext()
+    {
+        auto context = std::make_unique<quickjs::QuickJSContext>();
+        runtime = context->runtime;
+
+        // A handler set before carries over to the new runtime
+        if (interruptHandler != nullptr)
+            setInterruptHandler(interruptHandler, interruptUserData);
+
+        return choc::javascript::Context(std::move(context));
+    }
+
+    void QuickJSRuntime::setInterruptHandler(const InterruptHandler handler, void* userData)
+    {
+        interruptHandler = handler;
+        interruptUserData = userData;
+
+        if (runtime == nullptr)
+            return;
+
+        quickjs::JS_SetInterruptHandler(toRuntime(runtime), [](quickjs::JSRuntime*, void* opaque)
+        {
+            const auto& self = *static_cast<const QuickJSRuntime*>(opaque);
+            return self.interruptHandler != nullptr && self.interruptHandler(self.interruptUserData) ? 1 : 0;
+        }, this);
+    }
+
+    QuickJSRuntime::MemoryUsage QuickJSRuntime::getMemoryUsage() const
+    {
+        if (runtime == nullptr)
+            return {};
+
+        quickjs::JSMemoryUsage usage{};
+        quickjs::JS_ComputeMemoryUsage(toRuntime(runtime), &usage);
+
+        MemoryUsage result;
+        result.allocatedBytes = usage.malloc_size;
+        result.usedBytes = usage.memory_used_size;
+        result.objects = usage.obj_count;
+        result.strings = usage.str_count;
+        result.functions = usage.js_func_count + usage.c_func_count;
+        return result;
+    }
+} // namespace mh
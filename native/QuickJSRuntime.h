@@ -0,0 +1,53 @@
+#ifndef QUICKJSRUNTIME_H
+#define QUICKJSRUNTIME_H
+
+#include <choc_javascript.h>
+
+#include <cstdint>
+
+namespace mh
+{
+    //==============================================================================
+    // choc keeps the QuickJS runtime under its javascript::Context out of reach,
+    // and the watchdog has to install an interrupt handler on it and telemetry
+    // reads its heap. This creates the context the way choc's
+    // createQuickJSContext() does, but holds on to the runtime before the Context
+    // takes it over.
+    //
+    // The handle refers to the runtime of the last context created, and is only
+    // valid for as long as that context is. This is the only translation unit
+    // that includes the QuickJS implementation.
+    class QuickJSRuntime
+    {
+    public:
+        struct MemoryUsage
+        {
+            int64_t allocatedBytes = 0; // by the runtime's allocator, including its own bookkeeping
+            int64_t usedBytes = 0;      // by the JS heap
+            int64_t objects = 0;
+            int64_t strings = 0;
+            int64_t functions = 0;
+        };
+
+        // Polled while a script runs, returning true aborts it
+        using InterruptHandler = bool (*)(void* userData);
+
+        QuickJSRuntime() = default;
+        QuickJSRuntime(const QuickJSRuntime&) = delete;
+        QuickJSRuntime& operator=(const QuickJSRuntime&) = delete;
+
+        choc::javascript::Context createContext();
+
+        void setInterruptHandler(InterruptHandler handler, void* userData);
+        MemoryUsage getMemoryUsage() const;
+
+        bool isValid() const noexcept { return runtime != nullptr; }
+
+    private:
+        void* runtime = nullptr; // a JSRuntime, which only QuickJSRuntime.cpp knows
+        InterruptHandler interruptHandler = nullptr;
+        void* interruptUserData = nullptr;
+    };
+} // namespace mh
+
+#endif //QUICKJSRUNTIME_H
@@ -0,0 +1,50 @@
+// Replays a session trace through a headless MindfulMIDI and prints the report
+// as JSON. It runs in a process of its own, so the instance gets its own
+// dispatch scheduler and message thread, and it reads and writes a temporary
+// user data directory that is removed afterwards, never the user's programs,
+// library or logs. Without --assets there is no dsp/main.js, so only what the
+// processor does natively is replayed.
+//
+//   MindfulMIDIReplay <trace> [--assets=<dist directory>]
+//
+// Exits with 0 when every block produced the MIDI that was recorded.
+
+#include "PluginProcessor.h"
+#include "Helpers.h"
+
+#include <iostream>
+
+int main(int argc, char* argv[])
+{
+    // The processor's async updates and timers need a message manager, though
+    // the replay runs updates in line and never dispatches
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    const juce::ArgumentList args(argc, argv);
+
+    if (args.size() < 1 || args[0].isOption())
+    {
+        std::cerr << "Usage: MindfulMIDIReplay <trace> [--assets=<dist directory>]" << std::endl;
+        return 2;
+    }
+
+    const auto traceFile = args[0].resolveAsFile();
+    const auto assets = args.containsOption("--assets")
+                            ? juce::File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--assets"))
+                            : juce::File();
+
+    const auto userData = juce::File::getSpecialLocation(juce::File::tempDirectory)
+                              .getNonexistentChildFile("MindfulMIDIReplay", "", false);
+    userData.createDirectory();
+    mh::util::overrideDirectories(assets, userData);
+
+    auto report = MindfulMIDI::replaySession(traceFile);
+    report.insert_or_assign("path", traceFile.getFullPathName().toStdString());
+
+    userData.deleteRecursively();
+
+    std::cout << elem::js::serialize(report) << std::endl;
+
+    const auto ok = report.find("ok");
+    return ok != report.end() && ok->second.isBool() && static_cast<bool>(ok->second) ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+#include "ScriptWatchdog.h"
+
+#include <algorithm>
+
+namespace mh
+{
+    namespace
+    {
+        elem::js::Number toMs(const ScriptWatchdog::Clock::duration d)
+        {
+            return std::chrono::duration<double, std::milli>(d).count();
+        }
+    }
+
+    const char* ScriptWatchdog::toString(const Script script)
+    {
+        switch (script)
+        {
+            case Script::dspMain: return "main";
+            case Script::hydrate: return "__receiveHydrationData__";
+            case Script::stateChange: return "__receiveStateChange__";
+            case Script::tableContent: return "__receiveTableContent__";
+            case Script::libraryContent: return "__receiveLibraryContent__";
+            case Script::chord: return "__receiveChord__";
+            case Script::fileProgress: return "__receiveFileProgress__";
+            case Script::error: return "__receiveError__";
+            case Script::suggestions: return "__receiveSuggestions__";
+            case Script::numScripts: break;
+        }
+        return "unknown";
+    }
+
+    ScriptWatchdog::ScriptWatchdog()
+        : ScriptWatchdog(Budget{})
+    {
+    }
+
+    ScriptWatchdog::ScriptWatchdog(const Budget b)
+        : budget(b), windowStart(Clock::now())
+    {
+    }
+
+    void ScriptWatchdog::begin(const Script script) noexcept
+    {
+        // A native function can evaluate more script, e.g. dispatchError from
+        // __postNativeMessage__. That runs inside the outer call and its budget.
+        if (depth++ > 0)
+            return;
+
+        running = script;
+        interrupted = nullptr;
+        callStart = Clock::now();
+
+        if (callStart - windowStart >= std::chrono::seconds(1))
+        {
+            windowStart = callStart;
+            windowUsed = {};
+        }
+
+        if (script == Script::dspMain)
+        {
+            callDeadline = windowDeadline = callStart + budget.startup;
+            return;
+        }
+
+        callDeadline = callStart + budget.perCall;
+        windowDeadline = callStart + std::max(Clock::duration{}, budget.perSecond - windowUsed);
+    }
+
+    void ScriptWatchdog::end() noexcept
+    {
+        if (--depth > 0)
+            return;
+
+        lastElapsed = Clock::now() - callStart;
+        windowUsed += lastElapsed;
+
+        auto& t = timings[static_cast<size_t>(running)];
+        ++t.calls;
+        t.total += lastElapsed;
+        t.max = std::max(t.max, lastElapsed);
+
+        if (interrupted != nullptr)
+            ++t.interrupted;
+        else
+            tripsInARow = 0;
+    }
+
+    void ScriptWatchdog::trip() noexcept
+    {
+        trippedAt = Clock::now();
+        ++trips;
+
+        // 1, 2, 4... times the base cooldown
+        const auto doublings = std::min<uint32_t>(tripsInARow++, 16);
+        cooldown = std::min(budget.cooldown * (1 << doublings), budget.maxCooldown);
+
+        tripped.store(true);
+    }
+
+    bool ScriptWatchdog::rearmIfCooledDown() noexcept
+    {
+        if (!isTripped() || Clock::now() - trippedAt < cooldown)
+            return false;
+
+        // tripsInARow is kept, so a script that trips straight away waits longer
+        windowStart = Clock::now();
+        windowUsed = {};
+        tripped.store(false);
+        return true;
+    }
+
+    void ScriptWatchdog::rearm() noexcept
+    {
+        tripsInARow = 0;
+        windowStart = Clock::now();
+        windowUsed = {};
+        tripped.store(false);
+    }
+
+    bool ScriptWatchdog::shouldInterrupt() noexcept
+    {
+        const auto now = Clock::now();
+
+        if (now >= callDeadline)
+            interrupted = "over the time allowed for one call";
+        else if (now >= windowDeadline)
+            interrupted = "over the time allowed per second";
+
+        return interrupted != nullptr;
+    }
+
+    elem::js::Object ScriptWatchdog::snapshot() const
+    {
+        elem::js::Object scripts;
+
+        for (size_t i = 0; i < timings.size(); ++i)
+        {
+            const auto& t = timings[i];
+
+            if (t.calls == 0)
+                continue;
+
+            elem::js::Object s;
+            s.insert_or_assign("calls", static_cast<elem::js::Number>(t.calls));
+            s.insert_or_assign("totalMs", toMs(t.total));
+            s.insert_or_assign("maxMs", toMs(t.max));
+            s.insert_or_assign("meanMs", toMs(t.total) / static_cast<elem::js::Number>(t.calls));
+            s.insert_or_assign("interrupted", static_cast<elem::js::Number>(t.interrupted));
+            scripts.insert_or_assign(toString(static_cast<Script>(i)), s);
+        }
+
+        elem::js::Object result;
+        result.insert_or_assign("tripped", isTripped());
+        result.insert_or_assign("trips", static_cast<elem::js::Number>(trips));
+
+        if (isTripped())
+            result.insert_or_assign("resumesInMs", std::max(0.0, toMs(cooldown - (Clock::now() - trippedAt))));
+
+        result.insert_or_assign("perCallMs", toMs(budget.perCall));
+        result.insert_or_assign("perSecondMs", toMs(budget.perSecond));
+        result.insert_or_assign("scripts", scripts);
+        return result;
+    }
+} // namespace mh
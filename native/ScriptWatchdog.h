@@ -0,0 +1,130 @@
+#ifndef SCRIPTWATCHDOG_H
+#define SCRIPTWATCHDOG_H
+
+#include <elem/Value.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace mh
+{
+    //==============================================================================
+    // Puts a time limit on the embedded JS engine. Every evaluation is bracketed
+    // by a Call, and the QuickJS interrupt handler asks shouldInterrupt() while a
+    // script runs, which aborts it once the call has used its own budget or what
+    // is left of the budget for the current second. A runaway loop in dsp/main.js
+    // then costs the message thread a fraction of a second instead of hanging it.
+    //
+    // An aborted call trips the watchdog, and scripts stay off for a cooldown
+    // that doubles with every trip in a row, so a handler that keeps running
+    // over costs less each time. The first call to go through afterwards
+    // resets it. A rebuilt engine starts afresh.
+    //
+    // Time is also kept per script, i.e. per __receive*__ callback, so a slow
+    // handler shows up in the stats by name.
+    //
+    // Message thread only, apart from isTripped().
+    class ScriptWatchdog
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        enum class Script : uint8_t
+        {
+            dspMain = 0,
+            hydrate,
+            stateChange,
+            tableContent,
+            libraryContent,
+            chord,
+            fileProgress,
+            error,
+            suggestions,
+            numScripts
+        };
+
+        static const char* toString(Script script);
+
+        struct Budget
+        {
+            Clock::duration perCall = std::chrono::milliseconds(250);
+            Clock::duration perSecond = std::chrono::milliseconds(400);
+            // Loading dsp/main.js builds the whole graph, so it gets longer, outside the per second budget
+            Clock::duration startup = std::chrono::seconds(2);
+            // At least the one second window, so the budget is whole again when scripts resume
+            Clock::duration cooldown = std::chrono::seconds(1);
+            Clock::duration maxCooldown = std::chrono::seconds(30);
+        };
+
+        ScriptWatchdog();
+        explicit ScriptWatchdog(Budget budget);
+
+        class Call
+        {
+        public:
+            Call(ScriptWatchdog& w, const Script script) : watchdog(w) { watchdog.begin(script); }
+            ~Call() { watchdog.end(); }
+
+        private:
+            ScriptWatchdog& watchdog;
+        };
+
+        // From the interrupt handler, while a Call is running
+        bool shouldInterrupt() noexcept;
+
+        // Whether the last call was aborted, and why
+        bool wasInterrupted() const noexcept { return interrupted != nullptr; }
+        const char* getInterruptReason() const noexcept { return interrupted; }
+        Script getLastScript() const noexcept { return running; }
+        Clock::duration getLastElapsed() const noexcept { return lastElapsed; }
+
+        // Once tripped the processor stops running scripts until rearmIfCooledDown()
+        // lets them resume, or rearm() does so at once for a rebuilt engine
+        void trip() noexcept;
+        bool rearmIfCooledDown() noexcept; // true when it rearmed
+        void rearm() noexcept;
+        bool isTripped() const noexcept { return tripped.load(std::memory_order_relaxed); }
+        Clock::duration getCooldown() const noexcept { return cooldown; }
+
+        elem::js::Object snapshot() const;
+
+    private:
+        void begin(Script script) noexcept;
+        void end() noexcept;
+
+        struct Timing
+        {
+            uint64_t calls = 0;
+            uint64_t interrupted = 0;
+            Clock::duration total{};
+            Clock::duration max{};
+        };
+
+        const Budget budget;
+
+        Script running = Script::dspMain;
+        Clock::time_point callStart;
+        Clock::time_point callDeadline;
+        Clock::time_point windowDeadline;
+        Clock::duration lastElapsed{};
+        const char* interrupted = nullptr;
+        int depth = 0;
+
+        // Budget per second, over one second windows
+        Clock::time_point windowStart;
+        Clock::duration windowUsed{};
+
+        Clock::time_point trippedAt;
+        Clock::duration cooldown{};
+        uint32_t tripsInARow = 0;
+        uint64_t trips = 0;
+
+        std::array<Timing, static_cast<size_t>(Script::numScripts)> timings;
+        std::atomic<bool> tripped{false};
+    };
+} // namespace mh
+
+#endif //SCRIPTWATCHDOG_H
@@ -0,0 +1,399 @@
+#include "SessionTrace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+namespace mh
+{
+    namespace trace
+    {
+        namespace
+        {
+            constexpr char magic[4] = {'M', 'H', 'T', 'R'};
+            constexpr uint32_t formatVersion = 1;
+            constexpr size_t frameHeaderSize = 8; // u32 payload size, u32 generation
+
+            constexpr uint8_t flagIsPlaying = 1;
+            constexpr uint8_t flagHasPpq = 2;
+
+            int64_t nowTicks() noexcept
+            {
+                return std::chrono::steady_clock::now().time_since_epoch().count();
+            }
+        }
+
+        // Appends to a fixed buffer, remembering rather than overrunning when full
+        struct Recorder::ByteWriter
+        {
+            uint8_t* data;
+            size_t capacity;
+            size_t size = 0;
+            bool overflow = false;
+
+            void put(const void* source, const size_t n) noexcept
+            {
+                if (overflow || size + n > capacity)
+                {
+                    overflow = true;
+                    return;
+                }
+
+                std::memcpy(data + size, source, n);
+                size += n;
+            }
+
+            template <typename T>
+            void value(const T v) noexcept
+            {
+                put(&v, sizeof(T));
+            }
+        };
+
+        //==============================================================================
+        Recorder::Recorder(const size_t ringBytes)
+            : ring(ringBytes), inputScratch(size_t(1) << 15), frameScratch(size_t(1) << 16)
+        {
+        }
+
+        void Recorder::prepare(const size_t numParameters)
+        {
+            jassert(!isRecording());
+            lastParameterValues.assign(numParameters, std::numeric_limits<float>::quiet_NaN());
+        }
+
+        bool Recorder::start(const juce::File& destination, const double sampleRate, const int blockSize)
+        {
+            stop();
+
+            destination.getParentDirectory().createDirectory();
+            destination.deleteFile();
+            auto stream = std::make_unique<juce::FileOutputStream>(destination);
+
+            if (stream->failedToOpen())
+                return false;
+
+            stream->write(magic, sizeof(magic));
+            stream->write(&formatVersion, sizeof(formatVersion));
+            stream->write(&sampleRate, sizeof(sampleRate));
+            stream->write(&blockSize, sizeof(blockSize));
+
+            file = destination;
+            out = std::move(stream);
+
+            // Anything the audio thread framed for an earlier recording is skipped
+            generation.fetch_add(1);
+            readPosition.store(writePosition.load(std::memory_order_acquire), std::memory_order_release);
+            dropped.store(0);
+
+            // The first block records every parameter
+            std::fill(lastParameterValues.begin(), lastParameterValues.end(), std::numeric_limits<float>::quiet_NaN());
+            startTicks.store(nowTicks());
+
+            recording.store(true, std::memory_order_release);
+            return true;
+        }
+
+        void Recorder::stop()
+        {
+            if (!recording.exchange(false))
+                return;
+
+            drain();
+            out->flush();
+            out.reset();
+        }
+
+        uint64_t Recorder::elapsedMicros() const noexcept
+        {
+            using namespace std::chrono;
+            const auto elapsed = steady_clock::duration(nowTicks() - startTicks.load(std::memory_order_relaxed));
+            return static_cast<uint64_t>(duration_cast<microseconds>(elapsed).count());
+        }
+
+        //==============================================================================
+        void Recorder::pushFrame(const uint8_t* payload, const size_t size) noexcept
+        {
+            const auto frameSize = frameHeaderSize + size;
+            const auto w = writePosition.load(std::memory_order_relaxed);
+            const auto r = readPosition.load(std::memory_order_acquire);
+
+            if (frameSize > ring.size() - (w - r))
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            const uint32_t header[2] = {static_cast<uint32_t>(size), generation.load(std::memory_order_relaxed)};
+            const auto* bytes = reinterpret_cast<const uint8_t*>(header);
+
+            const auto copyIn = [this](uint64_t position, const uint8_t* source, size_t n)
+            {
+                const auto start = static_cast<size_t>(position % ring.size());
+                const auto first = std::min(n, ring.size() - start);
+                std::memcpy(ring.data() + start, source, first);
+                std::memcpy(ring.data(), source + first, n - first);
+            };
+
+            copyIn(w, bytes, frameHeaderSize);
+            copyIn(w + frameHeaderSize, payload, size);
+            writePosition.store(w + frameSize, std::memory_order_release);
+        }
+
+        void Recorder::readRing(const uint64_t position, void* destination, const size_t size) const noexcept
+        {
+            auto* dest = static_cast<uint8_t*>(destination);
+            const auto start = static_cast<size_t>(position % ring.size());
+            const auto first = std::min(size, ring.size() - start);
+            std::memcpy(dest, ring.data() + start, first);
+            std::memcpy(dest + first, ring.data(), size - first);
+        }
+
+        void Recorder::drain()
+        {
+            auto r = readPosition.load(std::memory_order_relaxed);
+            const auto w = writePosition.load(std::memory_order_acquire);
+            const auto current = generation.load();
+
+            std::vector<uint8_t> payload;
+
+            while (r < w)
+            {
+                uint32_t header[2];
+                readRing(r, header, sizeof(header));
+
+                if (header[1] == current && out != nullptr)
+                {
+                    payload.resize(header[0]);
+                    readRing(r + frameHeaderSize, payload.data(), payload.size());
+                    out->write(payload.data(), payload.size());
+                }
+
+                r += frameHeaderSize + header[0];
+            }
+
+            readPosition.store(r, std::memory_order_release);
+        }
+
+        void Recorder::recordBridge(const std::string& name, const std::string& json)
+        {
+            if (!isRecording())
+                return;
+
+            // Everything the audio thread did up to now goes first
+            drain();
+
+            const auto type = static_cast<uint8_t>(RecordType::bridge);
+            const auto micros = elapsedMicros();
+            const auto nameLength = static_cast<uint16_t>(std::min<size_t>(name.size(), 0xFFFF));
+            const auto jsonLength = static_cast<uint32_t>(json.size());
+
+            out->write(&type, sizeof(type));
+            out->write(&micros, sizeof(micros));
+            out->write(&nameLength, sizeof(nameLength));
+            out->write(name.data(), nameLength);
+            out->write(&jsonLength, sizeof(jsonLength));
+            out->write(json.data(), jsonLength);
+        }
+
+        //==============================================================================
+        void Recorder::recordParameterIfChanged(const uint32_t index, const float normalisedValue) noexcept
+        {
+            if (!isRecording() || index >= lastParameterValues.size() || lastParameterValues[index] == normalisedValue)
+                return;
+
+            lastParameterValues[index] = normalisedValue;
+
+            uint8_t frame[32];
+            ByteWriter w{frame, sizeof(frame)};
+            w.value(static_cast<uint8_t>(RecordType::parameter));
+            w.value(elapsedMicros());
+            w.value(index);
+            w.value(normalisedValue);
+            pushFrame(frame, w.size);
+        }
+
+        void Recorder::captureInput(const juce::MidiBuffer& input) noexcept
+        {
+            ByteWriter w{inputScratch.data(), inputScratch.size()};
+            inputCount = 0;
+
+            for (const auto metadata : input)
+            {
+                if (metadata.numBytes > 0xFF)
+                    continue;
+
+                const auto before = w.size;
+                w.value(static_cast<int32_t>(metadata.samplePosition));
+                w.value(static_cast<uint8_t>(metadata.numBytes));
+                w.put(metadata.data, static_cast<size_t>(metadata.numBytes));
+
+                if (w.overflow || inputCount == 0xFFFF)
+                {
+                    w.size = before;
+                    break;
+                }
+
+                ++inputCount;
+            }
+
+            inputScratchSize = w.size;
+        }
+
+        void Recorder::recordBlock(const uint32_t numSamples, const MidiScheduler::Transport& transport,
+                                   const juce::MidiBuffer& output) noexcept
+        {
+            if (!isRecording())
+                return;
+
+            ByteWriter w{frameScratch.data(), frameScratch.size()};
+            w.value(static_cast<uint8_t>(RecordType::block));
+            w.value(elapsedMicros());
+            w.value(numSamples);
+            w.value(static_cast<uint8_t>((transport.isPlaying ? flagIsPlaying : 0) | (transport.hasPpq ? flagHasPpq : 0)));
+            w.value(transport.ppqPosition);
+            w.value(transport.bpm);
+            w.value(inputCount);
+            w.put(inputScratch.data(), inputScratchSize);
+
+            if (w.overflow)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            const auto outputCountAt = w.size;
+            uint16_t outputCount = 0;
+            w.value(outputCount);
+
+            for (const auto metadata : output)
+            {
+                if (metadata.numBytes > 0xFF)
+                    continue;
+
+                const auto before = w.size;
+                w.value(static_cast<int32_t>(metadata.samplePosition));
+                w.value(static_cast<uint8_t>(metadata.numBytes));
+                w.put(metadata.data, static_cast<size_t>(metadata.numBytes));
+
+                if (w.overflow || outputCount == 0xFFFF)
+                {
+                    w.size = before;
+                    w.overflow = false;
+                    break;
+                }
+
+                ++outputCount;
+            }
+
+            std::memcpy(frameScratch.data() + outputCountAt, &outputCount, sizeof(outputCount));
+            pushFrame(frameScratch.data(), w.size);
+            inputCount = 0;
+            inputScratchSize = 0;
+        }
+
+        //==============================================================================
+        bool Reader::open(const juce::File& source)
+        {
+            auto stream = std::make_unique<juce::FileInputStream>(source);
+
+            if (stream->failedToOpen())
+            {
+                error = "Could not open " + source.getFullPathName().toStdString();
+                return false;
+            }
+
+            in = std::make_unique<juce::BufferedInputStream>(stream.release(), 1 << 16, true);
+
+            char id[4];
+            uint32_t version = 0;
+
+            if (in->read(id, 4) != 4 || std::memcmp(id, magic, 4) != 0
+                || in->read(&version, sizeof(version)) != sizeof(version) || version != formatVersion)
+            {
+                error = "Not a session trace, or from a different version";
+                return false;
+            }
+
+            in->read(&sampleRate, sizeof(sampleRate));
+            in->read(&blockSize, sizeof(blockSize));
+            return true;
+        }
+
+        bool Reader::readEvents(std::vector<MidiEvent>& events)
+        {
+            uint16_t count = 0;
+            if (in->read(&count, sizeof(count)) != sizeof(count))
+                return false;
+
+            events.resize(count);
+
+            for (auto& e : events)
+            {
+                uint8_t size = 0;
+                if (in->read(&e.offset, sizeof(e.offset)) != sizeof(e.offset) || in->read(&size, 1) != 1)
+                    return false;
+
+                e.bytes.resize(size);
+                if (in->read(e.bytes.data(), size) != size)
+                    return false;
+            }
+
+            return true;
+        }
+
+        bool Reader::next(Record& record)
+        {
+            if (in == nullptr)
+                return false;
+
+            uint8_t type = 0;
+            if (in->read(&type, 1) != 1 || in->read(&record.micros, sizeof(record.micros)) != sizeof(record.micros))
+                return false;
+
+            record.type = static_cast<RecordType>(type);
+
+            switch (record.type)
+            {
+                case RecordType::block:
+                {
+                    uint8_t flags = 0;
+                    in->read(&record.numSamples, sizeof(record.numSamples));
+                    in->read(&flags, 1);
+                    in->read(&record.transport.ppqPosition, sizeof(double));
+                    in->read(&record.transport.bpm, sizeof(double));
+                    record.transport.isPlaying = (flags & flagIsPlaying) != 0;
+                    record.transport.hasPpq = (flags & flagHasPpq) != 0;
+                    record.transport.sampleRate = sampleRate;
+
+                    if (!readEvents(record.input) || !readEvents(record.output))
+                    {
+                        error = "Trace ends inside a block";
+                        return false;
+                    }
+                    return true;
+                }
+
+                case RecordType::parameter:
+                    in->read(&record.parameterIndex, sizeof(record.parameterIndex));
+                    return in->read(&record.value, sizeof(record.value)) == sizeof(record.value);
+
+                case RecordType::bridge:
+                {
+                    uint16_t nameLength = 0;
+                    uint32_t jsonLength = 0;
+                    in->read(&nameLength, sizeof(nameLength));
+                    record.name.resize(nameLength);
+                    in->read(record.name.data(), nameLength);
+                    in->read(&jsonLength, sizeof(jsonLength));
+                    record.json.resize(jsonLength);
+                    return in->read(record.json.data(), static_cast<int>(jsonLength)) == static_cast<int>(jsonLength);
+                }
+            }
+
+            error = "Unknown record type " + std::to_string(type);
+            return false;
+        }
+    } // namespace trace
+} // namespace mh
@@ -0,0 +1,139 @@
+#ifndef SESSIONTRACE_H
+#define SESSIONTRACE_H
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "MidiScheduler.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mh
+{
+    namespace trace
+    {
+        //==============================================================================
+        // A session trace is a compact binary log of everything that drives the
+        // processor: each audio block with its transport, incoming and outgoing MIDI,
+        // host parameter changes and editor bridge messages, in the order they took
+        // effect. Replaying one through a headless processor reproduces a live session
+        // without the DAW, see MindfulMIDI::replaySession and ReplayMain.cpp.
+        //
+        // File layout, native byte order (traces are for the machine that made them):
+        //   "MHTR" u32 version f64 sampleRate i32 blockSize
+        //   then records of u8 type, u64 microseconds since recording started:
+        //     block      u32 numSamples, u8 flags, f64 ppq, f64 bpm, input events, output events
+        //                where events are u16 count then { i32 offset, u8 size, bytes }
+        //     parameter  u32 index, f32 normalised value
+        //     bridge     u16 name length, name, u32 JSON length, JSON arguments
+        enum class RecordType : uint8_t
+        {
+            block = 1,
+            parameter,
+            bridge
+        };
+
+        struct MidiEvent
+        {
+            int32_t offset = 0;
+            std::vector<uint8_t> bytes;
+
+            bool operator==(const MidiEvent&) const = default;
+        };
+
+        struct Record
+        {
+            RecordType type = RecordType::block;
+            uint64_t micros = 0;
+
+            uint32_t numSamples = 0;
+            MidiScheduler::Transport transport;
+            std::vector<MidiEvent> input;
+            std::vector<MidiEvent> output;
+
+            uint32_t parameterIndex = 0;
+            float value = 0;
+
+            std::string name;
+            std::string json;
+        };
+
+        //==============================================================================
+        // Audio thread records are framed into a preallocated single producer ring
+        // and written to disk when the message thread drains it, so recording never
+        // blocks or allocates in processBlock. Bridge messages are written straight
+        // from the message thread, after draining, so they land between the blocks
+        // that ran before and after them.
+        class Recorder
+        {
+        public:
+            explicit Recorder(size_t ringBytes = size_t(1) << 20);
+
+            // Message thread
+            void prepare(size_t numParameters);
+            bool start(const juce::File& destination, double sampleRate, int blockSize);
+            void stop();
+            void drain();
+            void recordBridge(const std::string& name, const std::string& json);
+            juce::File getFile() const { return file; }
+            uint64_t getNumDropped() const noexcept { return dropped.load(std::memory_order_relaxed); }
+
+            bool isRecording() const noexcept { return recording.load(std::memory_order_acquire); }
+
+            // Audio thread
+            void recordParameterIfChanged(uint32_t index, float normalisedValue) noexcept;
+            void captureInput(const juce::MidiBuffer& input) noexcept;
+            void recordBlock(uint32_t numSamples, const MidiScheduler::Transport& transport,
+                             const juce::MidiBuffer& output) noexcept;
+
+        private:
+            struct ByteWriter;
+
+            uint64_t elapsedMicros() const noexcept;
+            void pushFrame(const uint8_t* payload, size_t size) noexcept;
+            void readRing(uint64_t position, void* destination, size_t size) const noexcept;
+
+            std::vector<uint8_t> ring;
+            std::atomic<uint64_t> writePosition{0};
+            std::atomic<uint64_t> readPosition{0};
+            std::atomic<uint32_t> generation{0};
+            std::atomic<bool> recording{false};
+            std::atomic<uint64_t> dropped{0};
+            std::atomic<int64_t> startTicks{0};
+
+            std::vector<uint8_t> inputScratch;
+            size_t inputScratchSize = 0;
+            uint16_t inputCount = 0;
+            std::vector<uint8_t> frameScratch;
+            std::vector<float> lastParameterValues;
+
+            juce::File file;
+            std::unique_ptr<juce::FileOutputStream> out;
+        };
+
+        //==============================================================================
+        class Reader
+        {
+        public:
+            bool open(const juce::File& source);
+            bool next(Record& record);
+
+            double getSampleRate() const noexcept { return sampleRate; }
+            int getBlockSize() const noexcept { return blockSize; }
+            const std::string& getError() const noexcept { return error; }
+
+        private:
+            bool readEvents(std::vector<MidiEvent>& events);
+
+            std::unique_ptr<juce::InputStream> in;
+            double sampleRate = 44100.0;
+            int blockSize = 512;
+            std::string error;
+        };
+    } // namespace trace
+} // namespace mh
+
+#endif //SESSIONTRACE_H
@@ -0,0 +1,294 @@
+#include "SuggestionEngine.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace mh
+{
+    namespace
+    {
+        constexpr uint8_t rootOf(const uint8_t token) noexcept { return static_cast<uint8_t>(token >> 4); }
+
+        constexpr uint8_t relativeTo(const uint8_t token, const uint8_t root) noexcept
+        {
+            return static_cast<uint8_t>((((rootOf(token) + 12 - root) % 12) << 4) | (token & 0x0F));
+        }
+
+        // How much the session counts against the seed where both know a context
+        constexpr float sessionShare = 0.75f;
+
+        void setNote(std::array<uint64_t, 2>& notes, const uint8_t note) noexcept
+        {
+            notes[(note >> 6) & 1] |= uint64_t(1) << (note & 63);
+        }
+    }
+
+    //==============================================================================
+    uint32_t SuggestionEngine::Model::key(const Token* context, const size_t order) noexcept
+    {
+        const auto root = rootOf(context[order - 1]);
+        auto k = static_cast<uint32_t>(order) << 24;
+
+        for (size_t i = 0; i < order; ++i)
+            k |= static_cast<uint32_t>(relativeTo(context[i], root)) << (8 * i);
+
+        return k;
+    }
+
+    void SuggestionEngine::Model::add(const Token* context, const size_t length, const Token next)
+    {
+        for (size_t order = 1; order <= std::min(length, maxOrder); ++order)
+        {
+            const auto* c = context + length - order;
+            const auto relative = relativeTo(next, rootOf(c[order - 1]));
+            auto& table = tables[key(c, order)];
+            auto& entries = table.entries;
+
+            auto i = static_cast<size_t>(std::find_if(entries.begin(), entries.end(), [relative](const Entry& e)
+            {
+                return e.next == relative;
+            }) - entries.begin());
+
+            if (i == entries.size())
+                entries.push_back({relative, 0});
+
+            ++entries[i].count;
+            ++table.total;
+
+            for (; i > 0 && entries[i - 1].count < entries[i].count; --i)
+                std::swap(entries[i - 1], entries[i]);
+        }
+    }
+
+    bool SuggestionEngine::Model::knows(const Token* context, const size_t order) const
+    {
+        const auto found = tables.find(key(context, order));
+        return found != tables.end() && found->second.total > 0;
+    }
+
+    void SuggestionEngine::Model::accumulate(const Token* context, const size_t order, const float weight,
+                                             Scores& scores) const
+    {
+        const auto found = tables.find(key(context, order));
+
+        if (found == tables.end() || found->second.total == 0)
+            return;
+
+        const auto& table = found->second;
+        const auto scale = weight / static_cast<float>(table.total);
+
+        for (const auto& entry : table.entries)
+        {
+            scores.score[entry.next] += scale * static_cast<float>(entry.count);
+            scores.order[entry.next] = static_cast<uint8_t>(order);
+        }
+    }
+
+    //==============================================================================
+    void SuggestionEngine::History::push(const Token token) noexcept
+    {
+        if (length == maxOrder)
+        {
+            std::copy(tokens.begin() + 1, tokens.end(), tokens.begin());
+            --length;
+        }
+
+        tokens[length++] = token;
+    }
+
+    bool SuggestionEngine::tokenFor(const std::array<uint64_t, 2>& notes, Token& token) noexcept
+    {
+        const auto chord = ChordDetector::identify(notes);
+
+        if (!chord.isChord())
+            return false;
+
+        token = static_cast<Token>((chord.root << 4) | static_cast<uint8_t>(chord.quality));
+        return true;
+    }
+
+    void SuggestionEngine::count(Model& model, History& history, const std::array<uint64_t, 2>& notes)
+    {
+        Token token = 0;
+
+        if (!tokenFor(notes, token))
+        {
+            history.cut();
+            return;
+        }
+
+        model.add(history.tokens.data(), history.length, token);
+        history.push(token);
+    }
+
+    //==============================================================================
+    SuggestionEngine::SuggestionEngine(const double g)
+        : groupSeconds(g)
+    {
+    }
+
+    void SuggestionEngine::observe(const std::vector<uint8_t>& bytes, const double timeSeconds)
+    {
+        if (bytes.size() == 3 && bytes[0] >= 0x80)
+        {
+            // A raw message, of which only note-ons make chords
+            if ((bytes[0] & 0xF0) != 0x90 || bytes[2] == 0)
+                return;
+
+            if (!groupOpen || timeSeconds - groupTime > groupSeconds)
+            {
+                closeGroup();
+                group = {};
+                groupTime = timeSeconds;
+                groupOpen = true;
+            }
+
+            setNote(group, bytes[1] & 0x7F);
+            return;
+        }
+
+        // A chord as a list of note numbers
+        closeGroup();
+
+        std::array<uint64_t, 2> notes{};
+        for (const auto note : bytes)
+            setNote(notes, note & 0x7F);
+
+        count(session, sessionHistory, notes);
+    }
+
+    void SuggestionEngine::closeGroup()
+    {
+        if (!std::exchange(groupOpen, false))
+            return;
+
+        count(session, sessionHistory, group);
+    }
+
+    void SuggestionEngine::resetSession()
+    {
+        session.clear();
+        sessionHistory.cut();
+        groupOpen = false;
+    }
+
+    void SuggestionEngine::seed(const std::vector<chordlib::PackedChord>& progression)
+    {
+        History history;
+
+        for (const auto& chord : progression)
+        {
+            std::array<uint64_t, 2> notes{};
+            for (const auto note : chordlib::unpack(chord))
+                setNote(notes, note);
+
+            count(seeded, history, notes);
+        }
+
+        numSeedChords += progression.size();
+    }
+
+    void SuggestionEngine::clearSeed()
+    {
+        seeded.clear();
+        numSeedChords = 0;
+    }
+
+    //==============================================================================
+    SuggestionEngine::History SuggestionEngine::getCurrentContext() const
+    {
+        // The chord still being played is the end of the context, though it isn't
+        // counted until the next one starts
+        auto context = sessionHistory;
+        Token open = 0;
+
+        if (groupOpen)
+        {
+            if (tokenFor(group, open))
+                context.push(open);
+            else
+                context.cut();
+        }
+
+        return context;
+    }
+
+    std::vector<SuggestionEngine::Suggestion> SuggestionEngine::suggest(const size_t k) const
+    {
+        const auto context = getCurrentContext();
+        std::vector<Suggestion> result;
+
+        if (context.length == 0 || k == 0)
+            return result;
+
+        Scores scores;
+        float totalWeight = 0;
+
+        // Shorter contexts first, so each chord ends up with the longest that predicted it
+        for (size_t order = 1; order <= context.length; ++order)
+        {
+            const auto* c = context.tokens.data() + context.length - order;
+            const auto inSession = session.knows(c, order);
+            const auto inSeed = seeded.knows(c, order);
+
+            if (!inSession && !inSeed)
+                continue;
+
+            const auto weight = static_cast<float>(1u << (order - 1));
+            const auto share = !inSeed ? 1.0f : (!inSession ? 0.0f : sessionShare);
+            totalWeight += weight;
+
+            if (inSession)
+                session.accumulate(c, order, weight * share, scores);
+
+            if (inSeed)
+                seeded.accumulate(c, order, weight * (1.0f - share), scores);
+        }
+
+        if (totalWeight == 0)
+            return result;
+
+        const auto root = rootOf(context.tokens[context.length - 1]);
+
+        for (size_t t = 0; t < numTokens; ++t)
+        {
+            if (scores.score[t] <= 0)
+                continue;
+
+            Suggestion s;
+            s.root = static_cast<uint8_t>((rootOf(static_cast<Token>(t)) + root) % 12);
+            s.quality = static_cast<ChordDetector::Quality>(t & 0x0F);
+            s.score = scores.score[t] / totalWeight;
+            s.order = scores.order[t];
+            result.push_back(s);
+        }
+
+        const auto better = [](const Suggestion& a, const Suggestion& b)
+        {
+            return a.score != b.score ? a.score > b.score
+                                      : (a.root != b.root ? a.root < b.root : a.quality < b.quality);
+        };
+
+        const auto keep = std::min(k, result.size());
+        std::partial_sort(result.begin(), result.begin() + static_cast<long>(keep), result.end(), better);
+        result.resize(keep);
+        return result;
+    }
+
+    std::vector<ChordDetector::Chord> SuggestionEngine::getContext() const
+    {
+        const auto context = getCurrentContext();
+        std::vector<ChordDetector::Chord> chords;
+
+        for (size_t i = 0; i < context.length; ++i)
+        {
+            ChordDetector::Chord chord;
+            chord.root = rootOf(context.tokens[i]);
+            chord.bass = chord.root;
+            chord.quality = static_cast<ChordDetector::Quality>(context.tokens[i] & 0x0F);
+            chords.push_back(chord);
+        }
+
+        return chords;
+    }
+} // namespace mh
@@ -0,0 +1,140 @@
+#ifndef SUGGESTIONENGINE_H
+#define SUGGESTIONENGINE_H
+
+#include "ChordDetector.h"
+#include "ChordLibrary.h"
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace mh
+{
+    //==============================================================================
+    // Suggests the next chord from n-gram counts over the chords written so far,
+    // optionally backed by counts from a library of progressions.
+    //
+    // Chords are recognised as root and quality and counted relative to the root
+    // of the last chord of their context, so ii V I in any key counts towards the
+    // same n-grams and a suggestion learnt in C applies in F#. Contexts of one to
+    // maxOrder chords are counted, and a query mixes them, longer ones weighing
+    // more, so a long context that has been seen wins while a new one still gets
+    // an answer from its last chord.
+    //
+    // Counts only ever go up as chords are added, so the log is followed
+    // incrementally; anything else (undo, import) resets the session and replays.
+    // Message thread only.
+    class SuggestionEngine
+    {
+    public:
+        static constexpr size_t maxOrder = 3;
+
+        struct Suggestion
+        {
+            uint8_t root = 0;
+            ChordDetector::Quality quality = ChordDetector::Quality::none;
+            float score = 0;   // 0..1, summing to at most 1 over every possible chord
+            uint8_t order = 0; // longest context that predicted it
+
+            bool sameChordAs(const Suggestion& other) const noexcept
+            {
+                return root == other.root && quality == other.quality;
+            }
+        };
+
+        explicit SuggestionEngine(double groupSeconds = 0.03);
+
+        //==============================================================================
+        // One entry of the chord log, grouped into chords the way playback groups
+        // it: note-ons within `groupSeconds` of each other are one chord, and note
+        // lists (imports) are a chord each.
+        void observe(const std::vector<uint8_t>& bytes, double timeSeconds);
+        void resetSession();
+
+        // One progression of a library, counted apart from the session
+        void seed(const std::vector<chordlib::PackedChord>& progression);
+        void clearSeed();
+        size_t getNumSeedChords() const noexcept { return numSeedChords; }
+
+        //==============================================================================
+        // The best `k` next chords after the current context, best first
+        std::vector<Suggestion> suggest(size_t k) const;
+
+        // The context suggestions follow, oldest first, the chord still being
+        // played included
+        std::vector<ChordDetector::Chord> getContext() const;
+
+    private:
+        // Root in the high nibble, quality in the low one. The root is absolute
+        // in the history and relative to the last context chord in the tables.
+        using Token = uint8_t;
+        static constexpr size_t numTokens = 12 << 4;
+
+        struct Scores
+        {
+            std::array<float, numTokens> score{};
+            std::array<uint8_t, numTokens> order{};
+        };
+
+        class Model
+        {
+        public:
+            void add(const Token* context, size_t length, Token next);
+            void clear() { tables.clear(); }
+
+            bool knows(const Token* context, size_t order) const;
+
+            // Adds the weighted probability of every next chord after this context
+            void accumulate(const Token* context, size_t order, float weight, Scores& scores) const;
+
+        private:
+            struct Entry
+            {
+                Token next = 0;
+                uint32_t count = 0;
+            };
+
+            // Entries are kept most counted first, a bump moving one up past those it overtakes
+            struct Table
+            {
+                uint32_t total = 0;
+                std::vector<Entry> entries;
+            };
+
+            static uint32_t key(const Token* context, size_t order) noexcept;
+
+            std::unordered_map<uint32_t, Table> tables;
+        };
+
+        // The last few chords of a stream, with a stream of unrecognised chords
+        // or a reset cutting the context
+        struct History
+        {
+            std::array<Token, maxOrder> tokens{};
+            size_t length = 0;
+
+            void push(Token token) noexcept;
+            void cut() noexcept { length = 0; }
+        };
+
+        History getCurrentContext() const;
+
+        static bool tokenFor(const std::array<uint64_t, 2>& notes, Token& token) noexcept;
+        static void count(Model& model, History& history, const std::array<uint64_t, 2>& notes);
+        void closeGroup();
+
+        const double groupSeconds;
+
+        Model session;
+        History sessionHistory;
+        std::array<uint64_t, 2> group{};
+        double groupTime = 0;
+        bool groupOpen = false;
+
+        Model seeded;
+        size_t numSeedChords = 0;
+    };
+} // namespace mh
+
+#endif //SUGGESTIONENGINE_H
@@ -0,0 +1,152 @@
+#include "Telemetry.h"
+
+#include <algorithm>
+
+namespace mh
+{
+    namespace telemetry
+    {
+        namespace
+        {
+            void storeMax(std::atomic<uint64_t>& target, const uint64_t value) noexcept
+            {
+                auto current = target.load(std::memory_order_relaxed);
+                while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+                {
+                }
+            }
+
+            elem::js::Number toMs(const uint64_t ns)
+            {
+                return static_cast<elem::js::Number>(ns) * 1e-6;
+            }
+        }
+
+        const char* toString(const Counter counter)
+        {
+            switch (counter)
+            {
+                case Counter::asyncUpdates: return "asyncUpdates";
+                case Counter::midiInDropped: return "midiInDropped";
+                case Counter::midiInFiltered: return "midiInFiltered";
+                case Counter::midiInCoalesced: return "midiInCoalesced";
+                case Counter::midiOutDropped: return "midiOutDropped";
+                case Counter::chordsDropped: return "chordsDropped";
+                case Counter::schedulerDropped: return "schedulerDropped";
+                case Counter::engineEvaluations: return "engineEvaluations";
+                case Counter::engineScriptBytes: return "engineScriptBytes";
+                case Counter::numCounters: break;
+            }
+            return "unknown";
+        }
+
+        const char* toString(const Gauge gauge)
+        {
+            switch (gauge)
+            {
+                case Gauge::midiInFifo: return "midiInFifo";
+                case Gauge::midiOutFifo: return "midiOutFifo";
+                case Gauge::chordFifo: return "chordFifo";
+                case Gauge::viewQueued: return "viewQueued";
+                case Gauge::viewInFlight: return "viewInFlight";
+                case Gauge::engineHeapBytes: return "engineHeapBytes";
+                case Gauge::engineHeapObjects: return "engineHeapObjects";
+                case Gauge::numGauges: break;
+            }
+            return "unknown";
+        }
+
+        const char* toString(const Section section)
+        {
+            switch (section)
+            {
+                case Section::stateDispatch: return "stateDispatch";
+                case Section::tableContentDispatch: return "tableContentDispatch";
+                case Section::snapshotDispatch: return "snapshotDispatch";
+                case Section::libraryDispatch: return "libraryDispatch";
+                case Section::fileProgressDispatch: return "fileProgressDispatch";
+                case Section::midiDispatch: return "midiDispatch";
+                case Section::chordDispatch: return "chordDispatch";
+                case Section::errorDispatch: return "errorDispatch";
+                case Section::suggestionDispatch: return "suggestionDispatch";
+                case Section::evaluateExpression: return "evaluateExpression";
+                case Section::numSections: break;
+            }
+            return "unknown";
+        }
+
+        //==============================================================================
+        Stats::Stats()
+            : createdAt(Clock::now()), previousSnapshotAt(createdAt)
+        {
+        }
+
+        void Stats::set(const Gauge gauge, const uint64_t value) noexcept
+        {
+            auto& g = gauges[static_cast<size_t>(gauge)];
+            g.value.store(value, std::memory_order_relaxed);
+            storeMax(g.highWater, value);
+        }
+
+        void Stats::addTime(const Section section, const Clock::duration elapsed) noexcept
+        {
+            const auto ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+            auto& s = sections[static_cast<size_t>(section)];
+            s.calls.fetch_add(1, std::memory_order_relaxed);
+            s.totalNs.fetch_add(ns, std::memory_order_relaxed);
+            storeMax(s.maxNs, ns);
+        }
+
+        elem::js::Object Stats::snapshot()
+        {
+            using Seconds = std::chrono::duration<double>;
+
+            const auto now = Clock::now();
+            const auto interval = std::max(Seconds(now - previousSnapshotAt).count(), 1e-9);
+            previousSnapshotAt = now;
+
+            elem::js::Object totals, rates;
+            for (size_t i = 0; i < counters.size(); ++i)
+            {
+                const auto total = counters[i].load(std::memory_order_relaxed);
+                const auto* name = toString(static_cast<Counter>(i));
+                totals.insert_or_assign(name, static_cast<elem::js::Number>(total));
+                rates.insert_or_assign(name, static_cast<elem::js::Number>(total - previousCounters[i]) / interval);
+                previousCounters[i] = total;
+            }
+
+            elem::js::Object levels;
+            for (size_t i = 0; i < gauges.size(); ++i)
+            {
+                elem::js::Object g;
+                g.insert_or_assign("value", static_cast<elem::js::Number>(gauges[i].value.load(std::memory_order_relaxed)));
+                g.insert_or_assign("highWater", static_cast<elem::js::Number>(gauges[i].highWater.load(std::memory_order_relaxed)));
+                levels.insert_or_assign(toString(static_cast<Gauge>(i)), g);
+            }
+
+            elem::js::Object timings;
+            for (size_t i = 0; i < sections.size(); ++i)
+            {
+                const auto totalNs = sections[i].totalNs.load(std::memory_order_relaxed);
+
+                elem::js::Object s;
+                s.insert_or_assign("calls", static_cast<elem::js::Number>(sections[i].calls.load(std::memory_order_relaxed)));
+                s.insert_or_assign("totalMs", toMs(totalNs));
+                s.insert_or_assign("maxMs", toMs(sections[i].maxNs.load(std::memory_order_relaxed)));
+                // Milliseconds of message thread time per second, over the last interval
+                s.insert_or_assign("msPerSecond", toMs(totalNs - previousSectionNs[i]) / interval);
+                timings.insert_or_assign(toString(static_cast<Section>(i)), s);
+                previousSectionNs[i] = totalNs;
+            }
+
+            elem::js::Object result;
+            result.insert_or_assign("uptimeSeconds", Seconds(now - createdAt).count());
+            result.insert_or_assign("intervalSeconds", interval);
+            result.insert_or_assign("counters", totals);
+            result.insert_or_assign("rates", rates);
+            result.insert_or_assign("gauges", levels);
+            result.insert_or_assign("sections", timings);
+            return result;
+        }
+    } // namespace telemetry
+} // namespace mh
@@ -0,0 +1,129 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <elem/Value.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace mh
+{
+    namespace telemetry
+    {
+        // Totals that only go up
+        enum class Counter : uint8_t
+        {
+            asyncUpdates = 0,
+            midiInDropped,
+            midiInFiltered,
+            midiInCoalesced,
+            midiOutDropped,
+            chordsDropped,
+            schedulerDropped,
+            engineEvaluations,
+            engineScriptBytes,
+            numCounters
+        };
+
+        // Current levels, with the highest seen since the instance was created
+        enum class Gauge : uint8_t
+        {
+            midiInFifo = 0,
+            midiOutFifo,
+            chordFifo,
+            viewQueued,
+            viewInFlight,
+            engineHeapBytes,
+            engineHeapObjects,
+            numGauges
+        };
+
+        // Timed stretches of message thread work
+        enum class Section : uint8_t
+        {
+            stateDispatch = 0,
+            tableContentDispatch,
+            snapshotDispatch,
+            libraryDispatch,
+            fileProgressDispatch,
+            midiDispatch,
+            chordDispatch,
+            errorDispatch,
+            suggestionDispatch,
+            evaluateExpression,
+            numSections
+        };
+
+        const char* toString(Counter counter);
+        const char* toString(Gauge gauge);
+        const char* toString(Section section);
+
+        //==============================================================================
+        // What one processor instance costs, so a large session can be attributed
+        // instance by instance. Every update is a relaxed atomic, so any thread may
+        // record, the audio thread included. Reading is for the message thread.
+        class Stats
+        {
+        public:
+            using Clock = std::chrono::steady_clock;
+
+            Stats();
+
+            void add(Counter counter, uint64_t amount = 1) noexcept
+            {
+                counters[static_cast<size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+            }
+
+            void set(Gauge gauge, uint64_t value) noexcept;
+            void addTime(Section section, Clock::duration elapsed) noexcept;
+
+            // Times its own lifetime into a section
+            class Scope
+            {
+            public:
+                Scope(Stats& s, const Section sec) noexcept : stats(s), section(sec), start(Clock::now()) {}
+                ~Scope() { stats.addTime(section, Clock::now() - start); }
+
+                Scope(const Scope&) = delete;
+                Scope& operator=(const Scope&) = delete;
+
+            private:
+                Stats& stats;
+                const Section section;
+                const Clock::time_point start;
+            };
+
+            // Totals, per second rates since the previous call, gauges and section
+            // timings, ready to serialise
+            elem::js::Object snapshot();
+
+        private:
+            struct GaugeValue
+            {
+                std::atomic<uint64_t> value{0};
+                std::atomic<uint64_t> highWater{0};
+            };
+
+            struct SectionTime
+            {
+                std::atomic<uint64_t> calls{0};
+                std::atomic<uint64_t> totalNs{0};
+                std::atomic<uint64_t> maxNs{0};
+            };
+
+            std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::numCounters)> counters{};
+            std::array<GaugeValue, static_cast<size_t>(Gauge::numGauges)> gauges;
+            std::array<SectionTime, static_cast<size_t>(Section::numSections)> sections;
+
+            // Message thread, for rates
+            const Clock::time_point createdAt;
+            Clock::time_point previousSnapshotAt;
+            std::array<uint64_t, static_cast<size_t>(Counter::numCounters)> previousCounters{};
+            std::array<uint64_t, static_cast<size_t>(Section::numSections)> previousSectionNs{};
+        };
+    } // namespace telemetry
+} // namespace mh
+
+#endif //TELEMETRY_H
@@ -0,0 +1,193 @@
+#include "ViewDispatchQueue.h"
+
+#include <algorithm>
+
+namespace mh
+{
+    ViewDispatchQueue::ViewDispatchQueue(Evaluate evaluateFn, const size_t maxQueuedScripts, const uint32_t maxScriptsInFlight)
+        : evaluate(std::move(evaluateFn)), maxQueued(maxQueuedScripts), maxInFlight(std::max<uint32_t>(1, maxScriptsInFlight))
+    {
+    }
+
+    ViewDispatchQueue::~ViewDispatchQueue()
+    {
+        stopTimer();
+    }
+
+    void ViewDispatchQueue::setBatchEncoder(const Batch batch, Encode encode, const size_t maxItems)
+    {
+        auto& b = batches[static_cast<size_t>(batch)];
+        b.encode = std::move(encode);
+        b.maxItems = std::max<size_t>(1, maxItems);
+    }
+
+    //==============================================================================
+    void ViewDispatchQueue::replace(const Slot slot, std::string script)
+    {
+        auto& pending = slots[static_cast<size_t>(slot)];
+
+        if (pending.has_value())
+            ++stats.coalesced;
+
+        pending = std::move(script);
+        schedule();
+    }
+
+    void ViewDispatchQueue::append(const Batch batch, std::string item)
+    {
+        auto& b = batches[static_cast<size_t>(batch)];
+        b.items.push_back(std::move(item));
+
+        while (b.items.size() > b.maxItems)
+        {
+            b.items.pop_front();
+            ++stats.dropped;
+        }
+
+        schedule();
+    }
+
+    void ViewDispatchQueue::push(std::string script)
+    {
+        ordered.push_back(std::move(script));
+
+        while (ordered.size() > maxQueued)
+        {
+            ordered.pop_front();
+            ++stats.dropped;
+        }
+
+        schedule();
+    }
+
+    void ViewDispatchQueue::restart(std::string script)
+    {
+        for (auto& slot : slots)
+            slot.reset();
+
+        for (auto& b : batches)
+            b.items.clear();
+
+        ordered.clear();
+
+        // Acks for scripts sent to the old page will never come
+        acknowledgedSequence = sentSequence;
+        push(std::move(script));
+    }
+
+    void ViewDispatchQueue::acknowledge(const uint64_t sequence)
+    {
+        // Acks are cumulative, and late ones from before a timeout or restart are ignored
+        if (sequence <= acknowledgedSequence || sequence > sentSequence)
+            return;
+
+        stats.acknowledged += sequence - acknowledgedSequence;
+        acknowledgedSequence = sequence;
+        flush();
+    }
+
+    //==============================================================================
+    bool ViewDispatchQueue::hasPending() const noexcept
+    {
+        if (!ordered.empty())
+            return true;
+
+        for (const auto& slot : slots)
+            if (slot.has_value())
+                return true;
+
+        for (const auto& b : batches)
+            if (!b.items.empty())
+                return true;
+
+        return false;
+    }
+
+    void ViewDispatchQueue::appendGuarded(std::string& script, const std::string& expr)
+    {
+        // One failing handler must not keep the rest, or the ack, from running
+        script += "try {\n";
+        script += expr;
+        script += "\n} catch (e) { console.error(e); }\n";
+    }
+
+    void ViewDispatchQueue::flush()
+    {
+        if (isBehind() || !hasPending())
+            return;
+
+        std::string script;
+
+        for (const auto& expr : ordered)
+            appendGuarded(script, expr);
+        ordered.clear();
+
+        for (auto& slot : slots)
+        {
+            if (slot.has_value())
+            {
+                appendGuarded(script, *slot);
+                slot.reset();
+            }
+        }
+
+        for (auto& b : batches)
+        {
+            if (b.items.empty() || b.encode == nullptr)
+                continue;
+
+            appendGuarded(script, b.encode({b.items.begin(), b.items.end()}));
+            b.items.clear();
+        }
+
+        ++sentSequence;
+        script += "globalThis.__postNativeMessage__('";
+        script += ackEvent;
+        script += "', ";
+        script += std::to_string(sentSequence);
+        script += ");\n";
+
+        ++stats.sent;
+        stats.bytesSent += script.size();
+        lastSendMs = juce::Time::getMillisecondCounter();
+
+        evaluate(script);
+    }
+
+    void ViewDispatchQueue::schedule()
+    {
+        // Give the rest of this message loop a chance to replace or add to what
+        // was just queued before anything is sent
+        if (!isTimerRunning())
+            startTimer(flushIntervalMs);
+    }
+
+    void ViewDispatchQueue::timerCallback()
+    {
+        if (getInFlight() > 0 && juce::Time::getMillisecondCounter() - lastSendMs > static_cast<juce::uint32>(ackTimeoutMs))
+        {
+            stats.timedOut += getInFlight();
+            acknowledgedSequence = sentSequence;
+        }
+
+        flush();
+
+        if (!hasPending() && getInFlight() == 0)
+            stopTimer();
+    }
+
+    ViewDispatchQueue::Stats ViewDispatchQueue::getStats() const noexcept
+    {
+        auto s = stats;
+        s.inFlight = getInFlight();
+        s.queued = static_cast<uint32_t>(ordered.size());
+
+        for (const auto& slot : slots)
+            s.queued += slot.has_value() ? 1 : 0;
+
+        for (const auto& b : batches)
+            s.queued += static_cast<uint32_t>(b.items.size());
+
+        return s;
+    }
+} // namespace mh
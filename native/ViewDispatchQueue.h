@@ -0,0 +1,132 @@
+#ifndef VIEWDISPATCHQUEUE_H
+#define VIEWDISPATCHQUEUE_H
+
+#include <juce_events/juce_events.h>
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace mh
+{
+    //==============================================================================
+    // Everything the processor sends to an editor's WebView goes through one of
+    // these, owned by the editor. Scripts are held here instead of being handed
+    // straight to evaluateJavascript, where they would pile up without limit
+    // inside the browser engine whenever the view is busy or hidden.
+    //
+    // Three kinds of traffic:
+    //   slots    the latest script replaces an unsent earlier one, for updates
+    //            that carry the whole of some state (parameters, table content)
+    //   batches  items accumulate and go out as one script, keeping the newest
+    //            maxItems (incoming MIDI, log lines)
+    //   ordered  sent in order, oldest dropped when more than maxQueued wait
+    //
+    // Pending scripts are joined into one evaluateJavascript call which ends by
+    // posting a viewAck with its sequence number back to the editor. No more than
+    // maxInFlight calls go unacknowledged; past that the queue keeps coalescing
+    // and isBehind() tells producers to skip optional work. A view that never
+    // answers, for example while a page loads, is given up on after ackTimeoutMs.
+    //
+    // Message thread only.
+    class ViewDispatchQueue : private juce::Timer
+    {
+    public:
+        using Evaluate = std::function<void(const std::string&)>;
+        using Encode = std::function<std::string(const std::vector<std::string>&)>;
+
+        enum class Slot
+        {
+            state,
+            tableContent,
+            libraryContent,
+            fileProgress,
+            chord,
+            stats,
+            suggestions,
+            numSlots
+        };
+
+        enum class Batch
+        {
+            midi,
+            log,
+            numBatches
+        };
+
+        struct Stats
+        {
+            uint64_t sent = 0;          // evaluateJavascript calls
+            uint64_t acknowledged = 0;  // calls the view confirmed
+            uint64_t coalesced = 0;     // scripts replaced before they were sent
+            uint64_t dropped = 0;       // ordered scripts and batch items discarded
+            uint64_t timedOut = 0;      // calls given up on without an ack
+            uint64_t bytesSent = 0;
+            uint32_t inFlight = 0;
+            uint32_t queued = 0;
+        };
+
+        static constexpr int flushIntervalMs = 16;
+        static constexpr int ackTimeoutMs = 2000;
+
+        explicit ViewDispatchQueue(Evaluate evaluate, size_t maxQueued = 64, uint32_t maxInFlight = 2);
+        ~ViewDispatchQueue() override;
+
+        // `encode` turns the accumulated items into one script
+        void setBatchEncoder(Batch batch, Encode encode, size_t maxItems);
+
+        void replace(Slot slot, std::string script);
+        void append(Batch batch, std::string item);
+        void push(std::string script);
+
+        // Discards everything pending and in flight, then queues `script`. For a
+        // freshly loaded page, which supersedes whatever was sent to the old one.
+        void restart(std::string script);
+
+        // Called with the sequence number a flushed script posted back
+        void acknowledge(uint64_t sequence);
+
+        bool isBehind() const noexcept { return getInFlight() >= maxInFlight; }
+        Stats getStats() const noexcept;
+
+        // Sends whatever is pending, unless too much is still unacknowledged
+        void flush();
+
+        static constexpr const char* ackEvent = "viewAck";
+
+    private:
+        struct PendingBatch
+        {
+            Encode encode;
+            size_t maxItems = 256;
+            std::deque<std::string> items;
+        };
+
+        void timerCallback() override;
+        void schedule();
+        bool hasPending() const noexcept;
+        uint32_t getInFlight() const noexcept { return static_cast<uint32_t>(sentSequence - acknowledgedSequence); }
+
+        static void appendGuarded(std::string& script, const std::string& expr);
+
+        Evaluate evaluate;
+        const size_t maxQueued;
+        const uint32_t maxInFlight;
+
+        std::array<std::optional<std::string>, static_cast<size_t>(Slot::numSlots)> slots;
+        std::array<PendingBatch, static_cast<size_t>(Batch::numBatches)> batches;
+        std::deque<std::string> ordered;
+
+        uint64_t sentSequence = 0;
+        uint64_t acknowledgedSequence = 0;
+        juce::uint32 lastSendMs = 0;
+
+        Stats stats;
+    };
+} // namespace mh
+
+#endif //VIEWDISPATCHQUEUE_H
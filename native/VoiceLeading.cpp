@@ -0,0 +1,376 @@
+#include "VoiceLeading.h"
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace mh
+{
+    namespace voicing
+    {
+        namespace
+        {
+            constexpr size_t maxVoices = 8;
+
+            // Paths kept from one chord to the next. Enough that the best path is
+            // practically never dropped, with thousands of voicings per chord.
+            constexpr size_t maxPaths = 64;
+
+            struct Search
+            {
+                const ChordSpec& chord;
+                const Constraints& constraints;
+                const size_t maxCandidates;
+                const int numPitchClasses;
+
+                std::vector<uint8_t>& out;
+                std::array<uint8_t, maxVoices> notes{};
+                std::array<uint8_t, 12> doubling{};
+                int covered = 0;
+
+                bool isChordTone(const int note) const noexcept
+                {
+                    return (chord.pitchClasses >> (note % 12)) & 1;
+                }
+
+                // Ascending, so every voicing is found once and spacing is checked as it goes
+                void place(const size_t voice)
+                {
+                    const size_t numVoices = constraints.numVoices;
+
+                    if (voice == numVoices)
+                    {
+                        out.insert(out.end(), notes.begin(), notes.begin() + static_cast<long>(numVoices));
+                        return;
+                    }
+
+                    // Voices short of every pitch class can't double, as all of them can't sound
+                    const auto mustCover = numVoices >= static_cast<size_t>(numPitchClasses);
+                    const auto maxPerClass = mustCover ? constraints.maxDoubling : 1;
+                    const auto left = static_cast<int>(numVoices - voice);
+
+                    int from = constraints.lowest;
+                    int to = constraints.highest;
+
+                    if (voice > 0)
+                    {
+                        from = notes[voice - 1] + 1;
+                        to = std::min(to, notes[voice - 1] + (voice == 1 ? constraints.maxBassGap : constraints.maxSpacing));
+                    }
+
+                    for (auto note = from; note <= to && out.size() < maxCandidates * numVoices; ++note)
+                    {
+                        if (!isChordTone(note))
+                            continue;
+
+                        const auto pc = note % 12;
+
+                        if (voice == 0 && chord.bass >= 0 && pc != chord.bass)
+                            continue;
+
+                        if (doubling[pc] >= maxPerClass)
+                            continue;
+
+                        const auto newlyCovered = doubling[pc] == 0 ? 1 : 0;
+
+                        // The voices left have to be able to reach the pitch classes not yet sounding
+                        if (mustCover && numPitchClasses - (covered + newlyCovered) > left - 1)
+                            continue;
+
+                        notes[voice] = static_cast<uint8_t>(note);
+                        ++doubling[pc];
+                        covered += newlyCovered;
+
+                        place(voice + 1);
+
+                        --doubling[pc];
+                        covered -= newlyCovered;
+                    }
+                }
+            };
+
+            struct Phrase
+            {
+                size_t first = 0;
+                size_t last = 0; // exclusive
+            };
+
+            // One chord's voicings, and the sum of each one's notes
+            struct Candidates
+            {
+                std::vector<uint8_t> notes;
+                std::vector<int> sums;
+
+                const uint8_t* at(const size_t i, const size_t numVoices) const noexcept { return &notes[i * numVoices]; }
+
+                void index(const size_t numVoices)
+                {
+                    sums.resize(notes.size() / numVoices);
+                    for (size_t i = 0; i < sums.size(); ++i)
+                        sums[i] = std::accumulate(at(i, numVoices), at(i, numVoices) + numVoices, 0);
+                }
+            };
+
+            uint32_t distance(const uint8_t* a, const uint8_t* b, const size_t numVoices) noexcept
+            {
+                uint32_t d = 0;
+                for (size_t v = 0; v < numVoices; ++v)
+                    d += static_cast<uint32_t>(std::abs(a[v] - b[v]));
+                return d;
+            }
+        }
+
+        std::vector<uint8_t> candidates(const ChordSpec& chord, const Constraints& constraints,
+                                        const size_t maxCandidates)
+        {
+            std::vector<uint8_t> out;
+            const auto numPitchClasses = static_cast<int>(std::bitset<12>(chord.pitchClasses & 0x0FFF).count());
+
+            if (numPitchClasses == 0 || constraints.numVoices == 0 || constraints.numVoices > maxVoices)
+                return out;
+
+            Search search{chord, constraints, maxCandidates, numPitchClasses, out};
+            search.place(0);
+            return out;
+        }
+
+        Result solve(const std::vector<ChordSpec>& chords, const Constraints& c, const Parallel& parallel)
+        {
+            Result result;
+
+            Constraints constraints = c;
+            constraints.numVoices = static_cast<uint8_t>(std::clamp<size_t>(constraints.numVoices, 1, maxVoices));
+            constraints.maxDoubling = std::max<uint8_t>(constraints.maxDoubling, 1);
+            constraints.highest = std::min<uint8_t>(constraints.highest, 127);
+
+            const size_t numVoices = constraints.numVoices;
+            const auto centre = (constraints.lowest + constraints.highest) * 0.5f;
+
+            if (chords.empty())
+            {
+                result.ok = true;
+                return result;
+            }
+
+            //==============================================================================
+            // Progressions repeat themselves, so each distinct chord is searched once
+            std::vector<size_t> listOf(chords.size());
+            std::vector<const ChordSpec*> distinct;
+
+            for (size_t i = 0; i < chords.size(); ++i)
+            {
+                const auto same = std::find_if(distinct.begin(), distinct.end(), [&](const ChordSpec* d)
+                {
+                    return d->pitchClasses == chords[i].pitchClasses && d->bass == chords[i].bass;
+                });
+
+                listOf[i] = static_cast<size_t>(same - distinct.begin());
+
+                if (same == distinct.end())
+                    distinct.push_back(&chords[i]);
+            }
+
+            std::vector<Candidates> unique(distinct.size());
+            parallel(distinct.size(), [&](const size_t d)
+            {
+                unique[d].notes = candidates(*distinct[d], constraints);
+                unique[d].index(numVoices);
+            });
+
+            std::vector<const Candidates*> lists(chords.size());
+            for (size_t i = 0; i < chords.size(); ++i)
+            {
+                lists[i] = &unique[listOf[i]];
+
+                if (lists[i]->notes.empty())
+                {
+                    result.error = "No voicing of chord " + std::to_string(i + 1) + " fits the constraints";
+                    return result;
+                }
+
+                result.numCandidates += lists[i]->notes.size() / numVoices;
+            }
+
+            //==============================================================================
+            std::vector<Phrase> phrases;
+            for (size_t i = 0; i < chords.size(); ++i)
+            {
+                if (i == 0 || chords[i].startsPhrase)
+                    phrases.push_back({i, i});
+
+                phrases.back().last = i + 1;
+            }
+
+            result.numPhrases = phrases.size();
+            result.voicings.resize(chords.size());
+            std::vector<uint32_t> movement(phrases.size(), 0);
+
+            parallel(phrases.size(), [&](const size_t p)
+            {
+                const auto [first, last] = phrases[p];
+
+                // Cost of the cheapest path to each candidate, and where it came from
+                std::vector<std::vector<float>> cost(last - first);
+                std::vector<std::vector<uint32_t>> from(last - first);
+                std::vector<uint32_t> live;
+
+                const auto drift = [&](const int sum)
+                {
+                    return 0.5f * std::abs(static_cast<float>(sum) / static_cast<float>(numVoices) - centre);
+                };
+
+                for (auto i = first; i < last; ++i)
+                {
+                    const auto& list = *lists[i];
+                    const auto count = list.sums.size();
+                    auto& costs = cost[i - first];
+                    auto& previous = from[i - first];
+
+                    costs.resize(count);
+                    previous.assign(count, 0);
+
+                    if (i == first)
+                    {
+                        for (size_t j = 0; j < count; ++j)
+                            costs[j] = drift(list.sums[j]);
+                    }
+                    else
+                    {
+                        const auto& prevList = *lists[i - 1];
+                        const auto& prevCosts = cost[i - 1 - first];
+
+                        for (size_t j = 0; j < count; ++j)
+                        {
+                            const auto* notes = list.at(j, numVoices);
+                            auto best = std::numeric_limits<float>::max();
+                            uint32_t bestFrom = 0;
+
+                            // Cheapest first, so once a path costs more on its own than
+                            // the best so far, the rest can't win. The voices can't move
+                            // less in total than their sum changes by, which rules out most
+                            // of the others before the distance is worked out.
+                            for (const auto k : live)
+                            {
+                                if (prevCosts[k] >= best)
+                                    break;
+
+                                if (prevCosts[k] + static_cast<float>(std::abs(prevList.sums[k] - list.sums[j])) >= best)
+                                    continue;
+
+                                const auto total = prevCosts[k] + static_cast<float>(distance(prevList.at(k, numVoices), notes, numVoices));
+                                if (total < best)
+                                {
+                                    best = total;
+                                    bestFrom = k;
+                                }
+                            }
+
+                            costs[j] = best + drift(list.sums[j]);
+                            previous[j] = bestFrom;
+                        }
+                    }
+
+                    // Only the cheapest paths carry on to the next chord
+                    live.resize(count);
+                    std::iota(live.begin(), live.end(), 0u);
+
+                    const auto keep = std::min(count, maxPaths);
+                    std::partial_sort(live.begin(), live.begin() + static_cast<long>(keep), live.end(),
+                                      [&](const uint32_t a, const uint32_t b) { return costs[a] < costs[b]; });
+                    live.resize(keep);
+                }
+
+                // Back from the cheapest ending
+                const auto& lastCosts = cost.back();
+                auto j = static_cast<uint32_t>(std::min_element(lastCosts.begin(), lastCosts.end()) - lastCosts.begin());
+
+                for (auto i = last; i-- > first;)
+                {
+                    const auto* notes = lists[i]->at(j, numVoices);
+                    result.voicings[i].assign(notes, notes + numVoices);
+
+                    if (i > first)
+                    {
+                        const auto k = from[i - first][j];
+                        movement[p] += distance(lists[i - 1]->at(k, numVoices), notes, numVoices);
+                        j = k;
+                    }
+                }
+            });
+
+            result.movement = std::accumulate(movement.begin(), movement.end(), 0u);
+            result.ok = true;
+            return result;
+        }
+
+        //==============================================================================
+        Job::Job(juce::ThreadPool& p, std::vector<ChordSpec> c, const Constraints& k, std::function<void()> n)
+            : juce::ThreadPoolJob("Voicing"), chords(std::move(c)), constraints(k), pool(p), notify(std::move(n))
+        {
+        }
+
+        juce::ThreadPoolJob::JobStatus Job::runJob()
+        {
+            const auto start = std::chrono::steady_clock::now();
+            result = solve(chords, constraints, [this](const size_t n, const std::function<void(size_t)>& fn)
+            {
+                parallelFor(n, fn);
+            });
+            elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            finished.store(true);
+            notify();
+            return jobHasFinished;
+        }
+
+        void Job::parallelFor(const size_t n, const std::function<void(size_t)>& fn)
+        {
+            // Helpers can start after the work is done, so what they share outlives this call
+            struct Shared
+            {
+                std::atomic<size_t> next { 0 };
+                std::atomic<size_t> done { 0 };
+                std::atomic<bool> cancelled { false };
+                size_t n = 0;
+                const std::function<void(size_t)>* fn = nullptr;
+                juce::WaitableEvent allDone;
+            };
+
+            if (n == 0)
+                return;
+
+            const auto shared = std::make_shared<Shared>();
+            shared->n = n;
+            shared->fn = &fn;
+
+            // Once the job is told to exit, the rest of the items are counted without
+            // being solved. The result is thrown away by then.
+            const auto work = [shared](const auto& exiting)
+            {
+                for (auto i = shared->next.fetch_add(1); i < shared->n; i = shared->next.fetch_add(1))
+                {
+                    if (!shared->cancelled.load() && exiting())
+                        shared->cancelled.store(true);
+
+                    if (!shared->cancelled.load())
+                        (*shared->fn)(i);
+
+                    if (shared->done.fetch_add(1) + 1 == shared->n)
+                        shared->allDone.signal();
+                }
+            };
+
+            const auto helpers = std::min(n - 1, static_cast<size_t>(std::max(0, pool.getNumThreads() - 1)));
+
+            for (size_t h = 0; h < helpers; ++h)
+                pool.addJob([work] { work([] { return false; }); });
+
+            work([this] { return shouldExit(); });
+            shared->allDone.wait(-1);
+        }
+    } // namespace voicing
+} // namespace mh
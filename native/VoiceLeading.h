@@ -0,0 +1,96 @@
+#ifndef VOICELEADING_H
+#define VOICELEADING_H
+
+#include <juce_core/juce_core.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace mh
+{
+    namespace voicing
+    {
+        //==============================================================================
+        // Finds voicings for a progression of pitch class sets that move the voices
+        // as little as possible, within a range, spacing and doubling rules.
+        //
+        // Every chord gets the list of voicings that satisfy the rules, then a
+        // dynamic programme over consecutive chords picks the cheapest path, where
+        // the cost is the total distance the voices move plus a light pull towards
+        // the middle of the range, so the progression doesn't drift to one end.
+        // Previous voicings are tried cheapest first, which lets most of the
+        // comparisons be skipped.
+        //
+        // A phrase starts afresh, so phrases are independent. Both the candidate
+        // lists and the phrases are shared out through `Parallel`.
+        struct Constraints
+        {
+            uint8_t numVoices = 4;
+            uint8_t lowest = 40;      // E2
+            uint8_t highest = 84;     // C6
+            uint8_t maxSpacing = 12;  // between neighbouring upper voices
+            uint8_t maxBassGap = 19;  // between the bass and the voice above it
+            uint8_t maxDoubling = 2;  // voices on one pitch class
+        };
+
+        struct ChordSpec
+        {
+            uint16_t pitchClasses = 0;
+            int bass = -1;            // required bass pitch class, -1 for any
+            bool startsPhrase = false;
+        };
+
+        struct Result
+        {
+            bool ok = false;
+            std::string error;
+            std::vector<std::vector<uint8_t>> voicings; // one per chord, low to high
+            uint32_t movement = 0;                      // semitones, all voices, all chords
+            size_t numCandidates = 0;
+            size_t numPhrases = 0;
+        };
+
+        // Calls fn(i) for i in [0, n), on any threads, and returns once all are done
+        using Parallel = std::function<void(size_t n, const std::function<void(size_t)>& fn)>;
+
+        Result solve(const std::vector<ChordSpec>& chords, const Constraints& constraints, const Parallel& parallel);
+
+        // Every voicing of one chord that satisfies `constraints`, flattened, numVoices
+        // notes each. At most `maxCandidates` are kept.
+        std::vector<uint8_t> candidates(const ChordSpec& chord, const Constraints& constraints,
+                                        size_t maxCandidates = 4096);
+
+        //==============================================================================
+        // Solves one request on a pool's worker. The solver's independent parts are
+        // shared out over the same pool, with this job taking its turn too, so it
+        // finishes even while every other worker is busy. `notify` is called from
+        // the worker once the result is ready.
+        class Job final : public juce::ThreadPoolJob
+        {
+        public:
+            Job(juce::ThreadPool& pool, std::vector<ChordSpec> chords, const Constraints& constraints,
+                std::function<void()> notify);
+
+            JobStatus runJob() override;
+
+            const std::vector<ChordSpec> chords;
+            const Constraints constraints;
+            std::atomic<bool> finished { false };
+
+            // Only read by the owner after `finished`
+            Result result;
+            double elapsedMs = 0;
+
+        private:
+            void parallelFor(size_t n, const std::function<void(size_t)>& fn);
+
+            juce::ThreadPool& pool;
+            std::function<void()> notify;
+        };
+    } // namespace voicing
+} // namespace mh
+
+#endif //VOICELEADING_H
@@ -59,6 +59,8 @@ WebViewEditor::WebViewEditor(juce::AudioProcessor *proc, juce::File const &asset
 #endif
 
     webView = std::make_unique<choc::ui::WebView>(opts);
+    dispatchQueue = std::make_unique<mh::ViewDispatchQueue>([this](const std::string &script)
+                                                            { webView->evaluateJavascript(script); });
 
 #if JUCE_MAC
     viewContainer.setView(webView->getViewHandle());
@@ -77,6 +79,11 @@ WebViewEditor::WebViewEditor(juce::AudioProcessor *proc, juce::File const &asset
         if (args.isArray()) {
             const auto eventName = args[0].getString();
 
+            if (eventName == mh::ViewDispatchQueue::ackEvent && args.size() > 1) {
+                dispatchQueue->acknowledge(static_cast<uint64_t>(numberFromChocValue(args[1])));
+                return {};
+            }
+
             // When the webView loads it should send a message telling us that it has established
             // its message-passing hooks and is ready for a server connection and state dispatch
             if (eventName == READY_EVENT) {
@@ -100,6 +107,112 @@ WebViewEditor::WebViewEditor(juce::AudioProcessor *proc, juce::File const &asset
             {
                 resetTableContent();
             }
+
+            if (eventName == LOAD_LIBRARY)
+            {
+                const auto path = args.size() > 1 && args[1].isString() ? std::string(args[1].getString()) : std::string();
+                loadLibrary(path);
+            }
+
+            if (eventName == QUERY_LIBRARY && args.size() > 1)
+            {
+                return handleQueryLibrary(args[1]);
+            }
+
+            if (eventName == EXPORT_MIDI_FILE || eventName == IMPORT_MIDI_FILE)
+            {
+                const auto path = args.size() > 1 && args[1].isString() ? std::string(args[1].getString()) : std::string();
+
+                if (eventName == EXPORT_MIDI_FILE)
+                    exportMIDIFile(path);
+                else
+                    importMIDIFile(path);
+            }
+
+            if (eventName == UNDO_CHORDS)
+            {
+                undoChords();
+            }
+
+            if (eventName == REDO_CHORDS)
+            {
+                redoChords();
+            }
+
+            if (eventName == CHECKOUT_CHORDS && args.size() > 1)
+            {
+                checkoutChords(static_cast<int>(numberFromChocValue(args[1])));
+            }
+
+            if (eventName == START_RECORDING)
+            {
+                const auto path = args.size() > 1 && args[1].isString() ? std::string(args[1].getString()) : std::string();
+                startRecording(path);
+            }
+
+            if (eventName == STOP_RECORDING)
+            {
+                stopRecording();
+            }
+
+            if (eventName == DUMP_STATS)
+            {
+                dumpStats(args.size() > 1 && args[1].isString() ? std::string(args[1].getString()) : std::string());
+            }
+
+            if (eventName == CONFIGURE_MPE && args.size() > 1)
+            {
+                return handleConfigureMPE(args[1]);
+            }
+
+            if (eventName == CONFIGURE_MIDI_INPUT && args.size() > 1 && args[1].isObject())
+            {
+                configureMIDIInput(choc::json::toString(args[1]));
+            }
+
+            if (eventName == CONFIGURE_LOGGING && args.size() > 1 && args[1].isObject())
+            {
+                configureLogging(choc::json::toString(args[1]));
+            }
+
+            if (eventName == PLAY_PROGRESSION)
+            {
+                // Options are many and optional, the processor reads them from JSON
+                playProgression(args.size() > 1 && args[1].isObject() ? choc::json::toString(args[1]) : std::string("{}"));
+            }
+
+            if (eventName == STOP_PROGRESSION)
+            {
+                stopProgression();
+            }
+
+            if (eventName == VOICE_LEAD)
+            {
+                voiceLead(args.size() > 1 && args[1].isObject() ? choc::json::toString(args[1]) : std::string("{}"));
+            }
+
+            if (eventName == SUGGEST_CHORDS)
+            {
+                suggestChords(args.size() > 1 ? static_cast<int>(numberFromChocValue(args[1])) : 0);
+            }
+
+            if (eventName == LOAD_PROGRAM_BANK)
+            {
+                loadProgramBank(args.size() > 1 && args[1].isString() ? std::string(args[1].getString()) : std::string());
+            }
+
+            if (eventName == STORE_PROGRAM && args.size() > 1 && args[1].isObject())
+            {
+                const auto& program = args[1];
+                storeProgram(program.hasObjectMember("index") ? static_cast<int>(numberFromChocValue(program["index"])) : -1,
+                             program.hasObjectMember("name") && program["name"].isString()
+                                 ? std::string(program["name"].getString()) : std::string());
+            }
+
+            if (eventName == SELECT_PROGRAM && args.size() > 1)
+            {
+                selectProgram(static_cast<int>(numberFromChocValue(args[1])));
+            }
         }
 
         return {}; });
@@ -111,6 +224,7 @@ WebViewEditor::WebViewEditor(juce::AudioProcessor *proc, juce::File const &asset
 
 WebViewEditor::~WebViewEditor()
 {
+    dispatchQueue.reset();
     webView.reset();
 }
 choc::ui::WebView *WebViewEditor::getWebViewPtr() const
@@ -118,6 +232,11 @@ choc::ui::WebView *WebViewEditor::getWebViewPtr() const
     return webView.get();
 }
 
+mh::ViewDispatchQueue &WebViewEditor::getDispatchQueue() const
+{
+    return *dispatchQueue;
+}
+
 void WebViewEditor::paint(juce::Graphics &g)
 {
 }
@@ -129,7 +248,7 @@ void WebViewEditor::resized()
 
 void WebViewEditor::executeJavascript(const std::string &script) const
 {
-    webView->evaluateJavascript(script);
+    dispatchQueue->push(script);
 }
 
 
@@ -148,12 +267,85 @@ choc::value::Value WebViewEditor::handleSetParameterValueEvent(const choc::value
 
 choc::value::Value WebViewEditor::handleSetMidiOut(const choc::value::ValueView &e) const
 {
-    if (e.isObject() && e.hasObjectMember("message") && e.hasObjectMember("index"))
+    if (e.isObject() && e.hasObjectMember("message"))
     {
         auto const &message = e["message"].getString();
-        double const v = numberFromChocValue(e["index"]);
 
-        setMidiOut(std::string{message}, static_cast<int>(v));
+        // Optional timing, see NativeMessage.sendMIDI. Without it the event goes out
+        // at the start of the next block, in the order it was sent.
+        mh::MidiScheduler::Timing timing;
+
+        if (e.hasObjectMember("timeBase") && e["timeBase"].isString())
+        {
+            auto const timeBase = e["timeBase"].getString();
+
+            if (timeBase == "samples")
+                timing.base = mh::MidiScheduler::TimeBase::samplesFromNow;
+            else if (timeBase == "beats")
+                timing.base = mh::MidiScheduler::TimeBase::beatsFromNow;
+            else if (timeBase == "ppq")
+                timing.base = mh::MidiScheduler::TimeBase::ppq;
+        }
+
+        if (e.hasObjectMember("time"))
+            timing.time = numberFromChocValue(e["time"]);
+
+        if (e.hasObjectMember("quantize"))
+            timing.quantizeBeats = numberFromChocValue(e["quantize"]);
+
+        // Per-note expression, only heard once MPE output is configured
+        mh::NoteExpression expression;
+
+        if (e.hasObjectMember("bend"))
+            expression.pitchBend = static_cast<float>(numberFromChocValue(e["bend"]));
+
+        if (e.hasObjectMember("pressure"))
+            expression.pressure = static_cast<float>(numberFromChocValue(e["pressure"]));
+
+        setMidiOut(std::string{message}, timing, expression);
+    }
+
+    return {};
+}
+
+choc::value::Value WebViewEditor::handleConfigureMPE(const choc::value::ValueView &e) const
+{
+    if (e.isObject())
+    {
+        const auto member = [&e](const char* name, const double fallback)
+        {
+            return static_cast<int>(e.hasObjectMember(name) ? numberFromChocValue(e[name]) : fallback);
+        };
+
+        configureMPE(member("lowerMembers", 0), member("upperMembers", 0), member("bendRange", 48));
+    }
+
+    return {};
+}
+
+choc::value::Value WebViewEditor::handleQueryLibrary(const choc::value::ValueView &e) const
+{
+    if (e.isObject() && e.hasObjectMember("chords") && e["chords"].isArray())
+    {
+        std::vector<std::vector<uint8_t>> chords;
+        auto const chordsJs = e["chords"];
+
+        for (uint32_t i = 0; i < chordsJs.size(); ++i)
+        {
+            std::vector<uint8_t> notes;
+            auto const chordJs = chordsJs[i];
+
+            if (chordJs.isArray())
+                for (uint32_t n = 0; n < chordJs.size(); ++n)
+                    notes.push_back(static_cast<uint8_t>(numberFromChocValue(chordJs[n])));
+
+            chords.push_back(std::move(notes));
+        }
+
+        int const page = e.hasObjectMember("page") ? static_cast<int>(numberFromChocValue(e["page"])) : 0;
+        int const pageSize = e.hasObjectMember("pageSize") ? static_cast<int>(numberFromChocValue(e["pageSize"])) : 20;
+
+        queryLibrary(chords, page, pageSize);
     }
 
     return {};
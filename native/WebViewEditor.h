@@ -5,6 +5,9 @@
 
 #include <choc_WebView.h>
 
+#include "MidiScheduler.h"
+#include "ViewDispatchQueue.h"
+
 
 //==============================================================================
 // A simple juce::AudioProcessorEditor that holds a choc::WebView and sets the
@@ -17,6 +20,9 @@ public:
     ~WebViewEditor() override;
    //==============================================================================
     choc::ui::WebView* getWebViewPtr() const;
+
+    // Scripts for the view go through here, see ViewDispatchQueue
+    mh::ViewDispatchQueue& getDispatchQueue() const;
     //==============================================================================
     void paint(juce::Graphics &g) override;
     void resized() override;
@@ -24,10 +30,32 @@ public:
     //======= general-purpose polymorphic function wrappers
     //======= bound to the processor from the front end
     std::function<void(const std::string &, float)> setParameterValue = [](const std::string &, float) {};
-    std::function<void(const std::string &, int)> setMidiOut = [](const std::string &, int) {};
+    std::function<void(const std::string &, const mh::MidiScheduler::Timing &, const mh::NoteExpression &)> setMidiOut =
+        [](const std::string &, const mh::MidiScheduler::Timing &, const mh::NoteExpression &) {};
+    std::function<void(int, int, int)> configureMPE = [](int, int, int) {};
+    std::function<void(const std::string &)> configureMIDIInput = [](const std::string &) {};
+    std::function<void(const std::string &)> configureLogging = [](const std::string &) {};
+    std::function<void(const std::string &)> playProgression = [](const std::string &) {};
+    std::function<void()> stopProgression = []() {};
+    std::function<void(const std::string &)> voiceLead = [](const std::string &) {};
+    std::function<void(int)> suggestChords = [](int) {};
+    std::function<void(const std::string &)> loadProgramBank = [](const std::string &) {};
+    std::function<void(int, const std::string &)> storeProgram = [](int, const std::string &) {};
+    std::function<void(int)> selectProgram = [](int) {};
     std::function<void()> reload = []() {};
     std::function<void()> ready = []() {};
     std::function<void()> resetTableContent = []() {};
+    std::function<void(const std::string &)> loadLibrary = [](const std::string &) {};
+    std::function<void(const std::vector<std::vector<uint8_t>> &, int, int)> queryLibrary =
+        [](const std::vector<std::vector<uint8_t>> &, int, int) {};
+    std::function<void(const std::string &)> exportMIDIFile = [](const std::string &) {};
+    std::function<void(const std::string &)> importMIDIFile = [](const std::string &) {};
+    std::function<void()> undoChords = []() {};
+    std::function<void()> redoChords = []() {};
+    std::function<void(int)> checkoutChords = [](int) {};
+    std::function<void(const std::string &)> startRecording = [](const std::string &) {};
+    std::function<void()> stopRecording = []() {};
+    std::function<void(const std::string &)> dumpStats = [](const std::string &) {};
 
     void executeJavascript(const std::string &script) const;
 
@@ -39,11 +67,34 @@ private:
     std::string SERVER_PORT = "serverInfo";
     std::string SEND_MIDI_EVENT = "sendMIDI";
     std::string RESET_TABLE_FROM_VIEW = "resetTableContent";
+    std::string LOAD_LIBRARY = "loadLibrary";
+    std::string QUERY_LIBRARY = "queryLibrary";
+    std::string EXPORT_MIDI_FILE = "exportMIDIFile";
+    std::string IMPORT_MIDI_FILE = "importMIDIFile";
+    std::string UNDO_CHORDS = "undoChords";
+    std::string REDO_CHORDS = "redoChords";
+    std::string CHECKOUT_CHORDS = "checkoutChords";
+    std::string START_RECORDING = "startRecording";
+    std::string STOP_RECORDING = "stopRecording";
+    std::string DUMP_STATS = "dumpStats";
+    std::string CONFIGURE_MPE = "configureMPE";
+    std::string CONFIGURE_MIDI_INPUT = "configureMIDIInput";
+    std::string CONFIGURE_LOGGING = "configureLogging";
+    std::string PLAY_PROGRESSION = "playProgression";
+    std::string STOP_PROGRESSION = "stopProgression";
+    std::string VOICE_LEAD = "voiceLead";
+    std::string SUGGEST_CHORDS = "suggestChords";
+    std::string LOAD_PROGRAM_BANK = "loadProgramBank";
+    std::string STORE_PROGRAM = "storeProgram";
+    std::string SELECT_PROGRAM = "selectProgram";
 
     choc::value::Value handleSetParameterValueEvent(const choc::value::ValueView &e) const;
     choc::value::Value handleSetMidiOut(const choc::value::ValueView& e) const;
+    choc::value::Value handleQueryLibrary(const choc::value::ValueView& e) const;
+    choc::value::Value handleConfigureMPE(const choc::value::ValueView& e) const;
 
     std::unique_ptr<choc::ui::WebView> webView;
+    std::unique_ptr<mh::ViewDispatchQueue> dispatchQueue;
 
 #if JUCE_MAC
     juce::NSViewComponent viewContainer;
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+# Writes the session traces the replay test runs through MindfulMIDIReplay.
+# The format is described in SessionTrace.h. Run from this directory after
+# changing a fixture, and commit the .mhtrace files it writes.
+
+import json
+import struct
+
+SAMPLE_RATE = 48000.0
+BLOCK_SIZE = 512
+
+# Block flags
+PLAYING = 1
+HAS_PPQ = 2
+
+
+def header():
+    return b"MHTR" + struct.pack("<Idi", 1, SAMPLE_RATE, BLOCK_SIZE)
+
+
+def events(messages):
+    out = struct.pack("<H", len(messages))
+    for offset, data in messages:
+        out += struct.pack("<iB", offset, len(data)) + bytes(data)
+    return out
+
+
+def block(micros, inputs, outputs, num_samples=BLOCK_SIZE, ppq=0.0, bpm=120.0, flags=0):
+    return (struct.pack("<BQIBdd", 1, micros, num_samples, flags, ppq, bpm)
+            + events(inputs) + events(outputs))
+
+
+def bridge(micros, name, args):
+    name_bytes = name.encode()
+    json_bytes = json.dumps(args).encode()
+    return (struct.pack("<BQH", 3, micros, len(name_bytes)) + name_bytes
+            + struct.pack("<I", len(json_bytes)) + json_bytes)
+
+
+def rpn(channel, number, value):
+    cc = 0xB0 | channel
+    return [(0, [cc, 101, 0]), (0, [cc, 100, number]), (0, [cc, 6, value]),
+            (0, [cc, 38, 0]), (0, [cc, 101, 127]), (0, [cc, 100, 127])]
+
+
+# A lower MPE zone of two members goes out at the top of the next block: RPN 6
+# on the master for the zone size, the bend range on each member, then the
+# unused upper zone is announced empty. The block after that is quiet.
+def mpe_configure():
+    announce = rpn(0, 6, 2) + rpn(1, 0, 48) + rpn(2, 0, 48) + rpn(15, 6, 0)
+    return (header()
+            + bridge(0, "configureMPE", {"lowerMembers": 2, "upperMembers": 0, "bendRange": 48})
+            + block(1000, [], announce)
+            + block(11667, [], []))
+
+
+# Fifteen lower members take every channel but the lower master, so the upper
+# member asked for is dropped and no upper zone is announced.
+def mpe_full_lower_zone():
+    announce = rpn(0, 6, 15)
+    for channel in range(1, 16):
+        announce += rpn(channel, 0, 48)
+    return (header()
+            + bridge(0, "configureMPE", {"lowerMembers": 15, "upperMembers": 1, "bendRange": 48})
+            + block(1000, [], announce)
+            + block(11667, [], []))
+
+
+# The host wraps its loop between blocks while a note is held. The note-off
+# keyed past the loop end goes out at the top of the wrapped block rather than
+# never. The positions are exact in binary, so the offsets don't round.
+def loop_wrap_held_note():
+    playing = PLAYING | HAS_PPQ
+    block_beats = BLOCK_SIZE / (SAMPLE_RATE / 2.0)
+    return (header()
+            + bridge(0, "sendMIDI", {"message": "90 3C 64", "timeBase": 3, "time": 3.9765625})
+            + bridge(0, "sendMIDI", {"message": "80 3C 00", "timeBase": 3, "time": 4.5})
+            + block(1000, [], [(187, [0x90, 0x3C, 0x64])], ppq=3.96875, flags=playing)
+            + block(11667, [], [(0, [0x80, 0x3C, 0x00])], ppq=0.0, flags=playing)
+            + block(22333, [], [], ppq=block_beats, flags=playing))
+
+
+# The host seeks forward past a held note's end. The note-off is late rather
+# than lost, so it goes out at the top of the first block after the seek.
+def seek_past_held_note():
+    playing = PLAYING | HAS_PPQ
+    return (header()
+            + bridge(0, "sendMIDI", {"message": "90 3C 64", "timeBase": 3, "time": 3.9765625})
+            + bridge(0, "sendMIDI", {"message": "80 3C 00", "timeBase": 3, "time": 4.5})
+            + block(1000, [], [(187, [0x90, 0x3C, 0x64])], ppq=3.96875, flags=playing)
+            + block(11667, [], [(0, [0x80, 0x3C, 0x00])], ppq=8.0, flags=playing))
+
+
+def send(micros, status, note, velocity):
+    return bridge(micros, "sendMIDI", {"message": "%02X %02X %02X" % (status, note, velocity), "timeBase": 0})
+
+
+def mpe_note_on(channel, note, velocity):
+    # Centred pitch bend and no pressure go out ahead of every MPE note-on
+    return [(0, [0xE0 | channel, 0x00, 0x40]), (0, [0xD0 | channel, 0x00]), (0, [0x90 | channel, note, velocity])]
+
+
+# Three notes in a zone of two members: the third steals the oldest note's
+# channel. The stolen note's own note-off no longer has a channel in the zone,
+# so it goes out where it was sent rather than ending the note that replaced it.
+def mpe_channel_stealing():
+    announce = rpn(0, 6, 2) + rpn(1, 0, 48) + rpn(2, 0, 48) + rpn(15, 6, 0)
+    played = (mpe_note_on(1, 0x3C, 0x64) + mpe_note_on(2, 0x40, 0x64)
+              + [(0, [0x81, 0x3C, 0x00])] + mpe_note_on(1, 0x43, 0x64)
+              + [(0, [0x80, 0x3C, 0x00]), (0, [0x82, 0x40, 0x00]), (0, [0x81, 0x43, 0x00])])
+    return (header()
+            + bridge(0, "configureMPE", {"lowerMembers": 2, "upperMembers": 0, "bendRange": 48})
+            + send(0, 0x90, 0x3C, 0x64) + send(0, 0x90, 0x40, 0x64) + send(0, 0x90, 0x43, 0x64)
+            + send(0, 0x80, 0x3C, 0x00) + send(0, 0x80, 0x40, 0x00) + send(0, 0x80, 0x43, 0x00)
+            + block(1000, [], announce + played)
+            + block(11667, [], []))
+
+
+FIXTURES = {
+    "mpe-configure.mhtrace": mpe_configure,
+    "mpe-full-lower-zone.mhtrace": mpe_full_lower_zone,
+    "mpe-channel-stealing.mhtrace": mpe_channel_stealing,
+    "loop-wrap-held-note.mhtrace": loop_wrap_held_note,
+    "seek-past-held-note.mhtrace": seek_past_held_note,
+}
+
+if __name__ == "__main__":
+    for path, make in FIXTURES.items():
+        with open(path, "wb") as f:
+            f.write(make())
@@ -9,10 +9,185 @@ interface ChordNotes {
     noteNumbers: number[];
 }
 
+interface ChordHistory {
+    version: number;
+    numVersions: number;
+    canUndo: boolean;
+    canRedo: boolean;
+}
+
+interface Voicings {
+    ok: boolean;
+    error?: string;
+    chords?: number[][];     // note numbers low to high, one voicing per chord
+    movement?: number;       // semitones moved by all voices over the progression
+    numPhrases?: number;
+    numCandidates?: number;
+    elapsedMs?: number;
+}
+
+interface ProgramList {
+    names: string[];
+    current: number;
+    file: string;           // the bank file, empty without one
+}
+
 export interface TableContent {
     tableContent: {
         noteNumbers: ChordNotes
         chordProgression: ChordNotes[]
+        chordHistory: ChordHistory
+        voicings?: Voicings
+        programs?: ProgramList
+    }
+}
+
+export interface MIDITiming {
+    timeBase?: "now" | "samples" | "beats" | "ppq";
+    time?: number;
+    spacing?: number;
+    quantize?: number;
+    // Per-note expression once MPE is configured, either one value for
+    // every message or an array with one each
+    bend?: number | number[];      // semitones
+    pressure?: number | number[];  // 0..1
+}
+
+export interface PlaybackOptions {
+    from?: number;          // first chord of the slice
+    to?: number;            // one past the last, the end by default
+    durations?: number[];   // beats per chord, cycled, 4 by default
+    voicings?: { inversion?: number; octave?: number }[];  // cycled
+    velocities?: number[];  // cycled, as captured by default
+    gate?: number;          // fraction of each duration the chord is held, 0.95 by default
+    loop?: boolean;         // true by default
+    align?: number;         // start on the next multiple of this many beats, 0 for song position 0
+    channel?: number;       // 1..16
+}
+
+export interface VoiceLeadRequest {
+    chords?: (string | number[] | null)[];  // symbols or pitch class sets, null or "|" between phrases
+    voices?: number;        // 1..8, 4 by default
+    lowest?: number;        // lowest note, 40 by default
+    highest?: number;       // highest note, 84 by default
+    maxSpacing?: number;    // semitones between neighbouring upper voices, 12 by default
+    maxBassGap?: number;    // semitones between the bass and the voice above, 19 by default
+    maxDoubling?: number;   // voices on one pitch class, 2 by default
+}
+
+export interface MPELayout {
+    lowerMembers?: number;  // member channels 2 and up, master on 1
+    upperMembers?: number;  // member channels 15 and down, master on 16
+    bendRange?: number;     // member pitch bend range in semitones, default 48
+}
+
+export type MIDIMessageType =
+    "noteOff" | "noteOn" | "polyPressure" | "controlChange" | "programChange" | "channelPressure" | "pitchBend" |
+    "sysex" | "timecode" | "songPosition" | "songSelect" | "tuneRequest" |
+    "clock" | "start" | "continue" | "stop" | "activeSensing" | "reset";
+
+export interface MIDIInputFilter {
+    drop?: MIDIMessageType[];   // clock and activeSensing by default
+    dropMask?: number;          // the same as a mask, bit (status >> 4) per channel message, 16 + (status & 15) per system one
+    coalesce?: boolean;         // only the latest controller, bend or pressure value per block, true by default
+    maxRate?: number;           // values per second per controller, 0 (the default) for no limit
+}
+
+export type LogLevel = "trace" | "debug" | "info" | "warn" | "error" | "off";
+export type LogCategory = "general" | "midi" | "audio" | "bridge" | "engine" | "state";
+
+export interface LogSettings {
+    level?: LogLevel;                                       // info by default
+    categories?: { [category in LogCategory]?: boolean };   // all on by default
+    sinks?: ("editor" | "stdout" | "file")[];               // editor and file by default; stdout only takes what no editor shows
+    rate?: number;                                          // drains per second, 20 by default
+    batch?: number;                                         // entries per drain, 256 by default
+    maxFileBytes?: number;                                  // before the log file is rotated, 1 MB by default
+    maxFiles?: number;                                      // rotated files kept, 4 by default
+}
+
+interface LibraryMatch {
+    progression: number;
+    position: number;
+    transposition: number;
+    chords: number[][];
+}
+
+export interface LibraryContent {
+    libraryContent: {
+        numProgressions: number
+        totalMatches?: number
+        page?: number
+        pageSize?: number
+        matches?: LibraryMatch[]
     }
 }
 
+interface ChordSuggestion {
+    name: string;           // e.g. "Fmaj7"
+    root: number;           // pitch class
+    quality: string;        // suffix as in the name, "" for major
+    score: number;          // 0..1
+    order: number;          // how many chords of the context predicted it
+    notes: number[];        // close position from the root above middle C
+}
+
+export interface ChordSuggestions {
+    context: string[];      // the chords the suggestions follow, oldest first
+    suggestions: ChordSuggestion[];
+}
+
+export interface FileProgress {
+    operation: "export" | "import"
+    path: string
+    progress: number
+    done: boolean
+    ok?: boolean
+    error?: string
+}
+
+export interface DetectedChord {
+    name: string            // eg. "Am7/G", empty when no chord is sounding
+    root: number | null     // pitch class 0-11
+    quality: string         // "", "m", "dim", "7", "maj7"...
+    inversion: number | null // null when the bass is not a chord tone
+    bass: number
+    notes: number[]
+}
+
+export interface SectionTiming {
+    calls: number
+    totalMs: number
+    maxMs: number
+    msPerSecond: number
+}
+
+export interface InstanceStats {
+    instance: number
+    time: string
+    uptimeSeconds: number
+    intervalSeconds: number
+    counters: Record<string, number>
+    rates: Record<string, number>
+    gauges: Record<string, { value: number, highWater: number }>
+    sections: Record<string, SectionTiming>
+    logDropped: number
+    view: { sent?: number, acknowledged?: number, coalesced?: number, dropped?: number, timedOut?: number, scriptBytes?: number }
+    engine: EngineBudget
+}
+
+export interface ScriptTiming {
+    calls: number
+    totalMs: number
+    maxMs: number
+    meanMs: number
+    interrupted: number
+}
+
+// The embedded engine's time limits, and what each __receive*__ handler costs
+export interface EngineBudget {
+    tripped: boolean
+    perCallMs: number
+    perSecondMs: number
+    scripts: Record<string, ScriptTiming>
+}
@@ -8,7 +8,7 @@
 
 import {IncomingMIDI, UIConsole} from "../state/customState.svelte"
 import {isValidMidiHex} from "../utils/helpers";
-import {TableContent} from "../declarations";
+import {ChordSuggestions, DetectedChord, FileProgress, InstanceStats, LibraryContent, LogSettings, MIDIInputFilter, MIDITiming, MPELayout, PlaybackOptions, TableContent, VoiceLeadRequest} from "../declarations";
 
 export declare var globalThis: any;
 
@@ -54,6 +54,51 @@ export function RegisterMessagesFromHost() {
         UIConsole.extend( theLog( JSON.stringify(parsedData) as string ) )
     }
 
+    globalThis.__receiveLibraryContent__ = (data: any) =>
+    {
+        let parsedData: LibraryContent = JSON.parse(data);
+        const {totalMatches = 0, page = 0} = parsedData.libraryContent;
+        UIConsole.update(`Library: ${totalMatches} matches, page ${page}`);
+    }
+
+    globalThis.__receiveFileProgress__ = (data: any) =>
+    {
+        let parsedData: FileProgress = JSON.parse(data);
+        const {operation, done, ok, error} = parsedData;
+        if (!done) return;
+        UIConsole.update(ok ? `MIDI file ${operation} finished` : `MIDI file ${operation} failed: ${error}`);
+    }
+
+    /*
+     * Per instance telemetry, once a second while the editor is open
+     */
+    globalThis.__receiveStats__ = (data: any) =>
+    {
+        let stats: InstanceStats = JSON.parse(data);
+        const evaluate = stats.sections.evaluateExpression;
+        console.debug(`Instance ${stats.instance}: ${stats.rates.asyncUpdates.toFixed(0)} updates/s, `
+            + `engine ${evaluate.msPerSecond.toFixed(2)} ms/s`, stats);
+    }
+
+    /*
+     * Next chord suggestions, sent when their ranking changes
+     */
+    globalThis.__receiveSuggestions__ = (data: any) =>
+    {
+        let suggestions: ChordSuggestions = JSON.parse(data);
+        const names = suggestions.suggestions.map(s => s.name).join(" ");
+        UIConsole.update(names ? `Next: ${names}` : "Next: -");
+    }
+
+    /*
+     * Chord changes recognised natively from incoming MIDI
+     */
+    globalThis.__receiveChord__ = (data: any) =>
+    {
+        let chord: DetectedChord = JSON.parse(data);
+        UIConsole.update(chord.name ? `Chord: ${chord.name}` : "Chord: -");
+    }
+
     /* 
      * Handles incoming MIDI data
      */
@@ -106,6 +151,201 @@ export const NativeMessage = {
         }
     },
 
+    /**
+     * Open a chord progression library file, or the default
+     * library in the user data folder when no path is given.
+     */
+    loadLibrary: function (path: string = "") {
+        if (typeof globalThis.__postNativeMessage__ === "function") {
+            globalThis.__postNativeMessage__("loadLibrary", path)
+        }
+    },
+
+    /**
+     * Find library progressions containing this chord sequence in
+     * any key. Results arrive a page at a time via __receiveLibraryContent__
+     * @param chords eg: [ [60, 64, 67], [65, 69, 72] ]
+     */
+    queryLibrary: function (chords: number[][], page: number = 0, pageSize: number = 20) {
+        if (typeof globalThis.__postNativeMessage__ === "function") {
+            globalThis.__postNativeMessage__("queryLibrary", {chords, page, pageSize})
+        }
+    },
+
+    /**
+     * Write the chord progression to a Standard MIDI File, or replace it
+     * with the chords found in one. Relative paths and the default
+     * resolve to the user data folder. Progress arrives via
+     * __receiveFileProgress__
+     */
+    exportMIDIFile: function (path: string = "") {
+        if (typeof globalThis.__postNativeMessage__ === "function") {
+            globalThis.__postNativeMessage__("exportMIDIFile", path)
+        }
+    },
+
+    importMIDIFile: function (path: string = "") {
+        if (typeof globalThis.__postNativeMessage__ === "function") {
+            globalThis.__postNativeMessage__("importMIDIFile", path)
+        }
+    },
+
+    /**
+     * Record everything that drives the plugin (MIDI blocks, parameters and
+     * these messages) to a trace in the user data sessions folder. Traces are
+     * replayed outside the plugin, with the MindfulMIDIReplay harness
+     */
+    startRecording: function (path: string = "") {
+        if (typeof globalThis.__postNativeMessage__ === "function") {
+            globalThis.__postNativeMessage__("startRecording", path)
+        }
+    },
+
+    stopRecording: function () {
+        if (typeof globalThis.__postNativeMessage__ === "function") {
+            globalThis.__postNativeMessage__("stopRecording")
+        }
+    },
+
+    /**
+     * Append this instance's stats to telemetry/<path>.jsonl once a second.
+     * An empty path stops the dump.
+     */
+    dumpStats: function (path: string = "") {
+        if (typeof globalThis.__postNativeMessage__ === "function") {
+            globalThis.__postNativeMessage__("dumpStats", path)
+        }
+    },
+
+    /**
+     * Send notes as MPE, each on a member channel of its own so sendMIDI
+     * can bend and press them separately. Channel assignment is native.
+     * Zero members in both zones turns MPE off again.
+     */
+    configureMPE: function (layout: MPELayout = {}) {
+        if (typeof globalThis.__postNativeMessage__ === "function") {
+            const { lowerMembers = 15, upperMembers = 0, bendRange = 48 } = layout;
+            globalThis.__postNativeMessage__("configureMPE", { lowerMembers, upperMembers, bendRange })
+        }
+    },
+
+    /**
+     * Thin out incoming MIDI before it reaches the scripts: drop message
+     * types, keep only the latest controller values, limit their rate.
+     * Settings left out stay as they are. Switch, RPN/NRPN and channel mode
+     * controllers always keep every value, and sysex is never passed on.
+     */
+    configureMIDIInput: function (filter: MIDIInputFilter) {
+        if (typeof globalThis.__postNativeMessage__ === "function") {
+            globalThis.__postNativeMessage__("configureMIDIInput", filter)
+        }
+    },
+
+    /**
+     * Change what the native logger keeps and where it goes. The file sink
+     * writes rotating logs to logs/ in the user data directory. Settings
+     * left out stay as they are, and all of them are saved with the plugin.
+     */
+    configureLogging: function (settings: LogSettings) {
+        if (typeof globalThis.__postNativeMessage__ === "function") {
+            globalThis.__postNativeMessage__("configureLogging", settings)
+        }
+    },
+
+    /**
+     * Play the captured progression natively, following the host transport,
+     * tempo and loop. Edits made while it plays are picked up as it goes.
+     * Nothing plays while the host transport is stopped.
+     */
+    playProgression: function (options: PlaybackOptions = {}) {
+        if (typeof globalThis.__postNativeMessage__ === "function") {
+            globalThis.__postNativeMessage__("playProgression", options)
+        }
+    },
+
+    stopProgression: function () {
+        if (typeof globalThis.__postNativeMessage__ === "function") {
+            globalThis.__postNativeMessage__("stopProgression")
+        }
+    },
+
+    /**
+     * Voice a progression so the voices move as little as possible. Chords
+     * are symbols ("Dm7", "G/B") or pitch class sets, null or "|" between
+     * phrases. Leave them out to voice the captured progression. The result
+     * arrives in tableContent.voicings.
+     */
+    voiceLead: function (request: VoiceLeadRequest = {}) {
+        if (typeof globalThis.__postNativeMessage__ === "function") {
+            globalThis.__postNativeMessage__("voiceLead", request)
+        }
+    },
+
+    /**
+     * Ask for the current next chord suggestions, and how many to rank from
+     * now on (5 by default, 0 keeps the current count). After this they
+     * arrive via __receiveSuggestions__ whenever the ranking changes.
+     */
+    suggestChords: function (count: number = 0) {
+        if (typeof globalThis.__postNativeMessage__ === "function") {
+            globalThis.__postNativeMessage__("suggestChords", count)
+        }
+    },
+
+    /**
+     * Open a program bank, the default one without a path. The programs
+     * are listed in tableContent.programs.
+     */
+    loadProgramBank: function (path: string = "") {
+        if (typeof globalThis.__postNativeMessage__ === "function") {
+            globalThis.__postNativeMessage__("loadProgramBank", path)
+        }
+    },
+
+    /**
+     * Store the parameters, chord progression and playback, MPE and MIDI
+     * input settings as a program, over the one at `index` or, without
+     * one, after the last. Stored to the default bank when none is open.
+     */
+    storeProgram: function (name: string = "", index: number = -1) {
+        if (typeof globalThis.__postNativeMessage__ === "function") {
+            globalThis.__postNativeMessage__("storeProgram", { index, name })
+        }
+    },
+
+    /**
+     * Switch to a program, as the host does. It is decoded in the background
+     * the first time, and applied once it is ready.
+     */
+    selectProgram: function (index: number) {
+        if (typeof globalThis.__postNativeMessage__ === "function") {
+            globalThis.__postNativeMessage__("selectProgram", index)
+        }
+    },
+
+    /**
+     * Step back and forth through the chord progression history.
+     * Every edit is kept, so undoing then sending new chords starts
+     * a branch; checkoutChords jumps to any version by number.
+     */
+    undoChords: function () {
+        if (typeof globalThis.__postNativeMessage__ === "function") {
+            globalThis.__postNativeMessage__("undoChords")
+        }
+    },
+
+    redoChords: function () {
+        if (typeof globalThis.__postNativeMessage__ === "function") {
+            globalThis.__postNativeMessage__("redoChords")
+        }
+    },
+
+    checkoutChords: function (version: number) {
+        if (typeof globalThis.__postNativeMessage__ === "function") {
+            globalThis.__postNativeMessage__("checkoutChords", version)
+        }
+    },
+
     /** 
      * Update a paramID to a new value in the host
      */
@@ -120,17 +360,30 @@ export const NativeMessage = {
     /** 
      * Send MIDI three byte messages from the plugin
      * @param messages eg: [ "90 3C 64", "80 4b 7f" ... ]
-     * Posts all the messages passed by the array and an index
-     * to keep track of an order of events
+     * @param timing optional scheduling for the whole batch, eg:
+     *   { timeBase: "samples", spacing: 441 }   strum, 10ms apart at 44.1kHz
+     *   { timeBase: "beats", time: 1 }          one beat from now
+     *   { quantize: 4 }                         on the next bar line ( 4/4 )
+     *   { bend: [0, -0.5, 0.25] }               per-note bend, with MPE configured
+     * Message i is scheduled at time + i * spacing. Without timing every
+     * message goes out at the start of the next block, in array order.
      */
-    sendMIDI: function ( messages: Array<string> ) {
+    sendMIDI: function ( messages: Array<string>, timing: MIDITiming = {} ) {
         if (typeof globalThis.__postNativeMessage__ === "function") {
+            const { timeBase = "now", time = 0, spacing = 0, quantize = 0, bend = 0, pressure = 0 } = timing;
+            const perNote = (value: number | number[], i: number) =>
+                Array.isArray(value) ? (value[i] ?? 0) : value;
             let index = 0;
             for (let message of messages) {
                 if (isValidMidiHex(message)) {
                     globalThis.__postNativeMessage__("sendMIDI", {
                         message,
-                        index
+                        index,
+                        timeBase,
+                        time: time + index * spacing,
+                        quantize,
+                        bend: perNote(bend, index),
+                        pressure: perNote(pressure, index)
                     });
                     index++;
                 }